@@ -1,276 +1,10089 @@
 /*
- * This program simulates a print queue using three different
+ * This program simulates a print queue using three main
  * scheduling algorithms:
  * 1. First-Come, First-Served (FCFS)
  * 2. Shortest Job First (SJF) (non-preemptive)
  * 3. Priority Scheduling (non-preemptive)
+ * plus preemptive variants of the last two, Shortest Remaining Time
+ * First (SRTF) and preemptive Priority, which interrupt a job between
+ * pages at a configurable context-switch cost, and an aging Priority
+ * policy whose waiting jobs gain a level every aging interval so that
+ * low-priority work cannot starve. Two queue-based policies trade
+ * throughput for fairness: a multi-level feedback queue (MLFQ) that
+ * demotes jobs after each page quantum, and deficit round robin (DRR)
+ * sharing the printers between priority classes by weight. Jain's
+ * fairness index of the jobs' slowdowns is reported alongside.
  *
- * It allows a user to add print jobs (with page count and priority)
- * and then run simulations to compare the performance metrics.
+ * It allows a user to add print jobs (with page count, priority and
+ * arrival time) and then run simulations to compare the performance
+ * metrics. Simulations are driven by a discrete-event engine, so jobs
+ * that arrive later only compete for the printer once they are there.
+ *
+ * Jobs can also be loaded in bulk from a CSV trace file, or replayed
+ * from a memory-mapped binary trace (see --help), in which case the
+ * chosen policies run non-interactively. A sweep mode (--sweep) runs
+ * replicated synthetic workloads across loads, fleet sizes and job-size
+ * distributions and reports confidence intervals, and --generate
+ * synthesizes large workloads to simulate or save as binary traces.
+ * --bench times the scheduler's hot paths and reports them as JSON.
+ * Client threads may submit jobs concurrently through a lock-free ring
+ * (submitJob) that the scheduler thread drains; --submit-bench measures
+ * its throughput. With --serve the spooler runs as a daemon, taking
+ * batches of jobs and queries from clients over a Unix or TCP socket.
+ * A write-ahead journal with group commit and periodic snapshots
+ * (--journal) lets the live queue survive a crash. Per-thread hot-path
+ * counters and a ring-buffer event trace (--perf-counters, --perf-trace)
+ * show what the spooler is doing under load.
+ *
+ * Build: cc -std=c11 -O2 -pthread spool.c -o spool -lm
+ * (add -march=native to enable the SSE4.2/AVX2/NEON metrics kernel)
  */
 
+#define _POSIX_C_SOURCE 200809L // For clock_gettime, posix_madvise
+
+#include <errno.h>    // For EAGAIN and EINTR on non-blocking sockets
+#include <fcntl.h>    // For open, and O_NONBLOCK on sockets
+#include <limits.h>   // For INT_MAX
+#include <math.h>     // For log, exp, sqrt in workload generation
+#include <netdb.h>    // For getaddrinfo on the daemon's TCP endpoint
+#include <netinet/in.h>
+#include <netinet/tcp.h> // For TCP_NODELAY
+#include <pthread.h>  // For the worker thread pool
+#include <signal.h>   // For stopping the daemon on SIGINT and SIGTERM
+#include <stdarg.h>   // For formatting daemon replies
+#include <stdatomic.h> // For the pool's task counters
+#include <stdint.h>   // For fixed-width binary trace fields
 #include <stdio.h>
-#include <stdlib.h> // For qsort
-#include <string.h> // For memcpy
+#include <stdlib.h>   // For malloc, realloc
+#include <string.h>   // For memcpy, memchr
+#include <sys/epoll.h> // For the daemon's event loop
+#include <sys/mman.h> // For mmap
+#include <sys/resource.h> // For getrusage in --bench
+#include <sys/socket.h>
+#include <sys/stat.h> // For fstat
+#include <sys/un.h>   // For Unix domain sockets
+#include <sys/wait.h> // For reaping the daemon's DUMP children
+#include <time.h>     // For clock_gettime
+#include <sched.h>    // For sched_yield
+#include <unistd.h>   // For close
+
+// Vector extensions for the metrics kernel, when the target has them
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define METRICS_SIMD_AVX2
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h> // SSE4.2 adds the 64-bit compare used for max wait
+#define METRICS_SIMD_SSE42
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define METRICS_SIMD_NEON
+#endif
+
+// Inlines a policy-generic function wherever the policy is a constant,
+// so its switch over the policy folds away (GCC and Clang)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+#define INITIAL_JOB_CAPACITY 64 // First allocation of the growable job store
+#define TRACE_READ_CHUNK (1 << 20) // Bytes read from a trace file at a time
+#define MAX_PRINTERS 256 // Largest printer fleet that can be simulated
+#define MAX_SWEEP_VALUES 16 // Values per axis of a --sweep grid
+#define MAX_BENCH_RUNS 100 // Timed runs per --bench case
+#define GENERATOR_CHUNK (1 << 20) // Jobs generated per task by --generate
+#define BURST_MEAN_JOBS 16.0 // Mean jobs per burst of bursty arrivals
+#define BURST_GAP_SCALE 0.1 // In-burst gap as a fraction of the mean gap
+#define PARETO_SHAPE 1.5 // Tail index of Pareto page counts (finite mean)
+#define RADIX_BITS 11 // Key bits per radix sort pass
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define INTEGER_SORT_MIN 256 // Below this many jobs a comparison sort is just as fast
+#define INSERTION_SORT_MAX 16 // Ranges this small are left for the final insertion pass
+#define COUNTING_SORT_MAX_RANGE (1 << 16) // Widest priority range counted directly
+#define METRICS_TILE 2048 // Jobs staged into columns per metrics tile
+#define OUTPUT_BUFFER_SIZE (1 << 20) // Bytes of per-job rows written at a time
+#define HISTOGRAM_EXACT_BITS 8 // Latencies below 2^8 get a bucket each
+#define HISTOGRAM_SUB_BUCKETS (1 << (HISTOGRAM_EXACT_BITS - 1)) // Per power of two above
+#define HISTOGRAM_BUCKETS ((1 << HISTOGRAM_EXACT_BITS) + \
+                           (63 - HISTOGRAM_EXACT_BITS) * HISTOGRAM_SUB_BUCKETS)
+#define PRIORITY_CLASSES 3 // Faculty, Student and Guest, as addJob() asks
+#define RUNNING_KEY_LIMIT (1 << 20) // Largest page count tracked incrementally
+#define MAX_MLFQ_LEVELS 8 // Feedback levels; also bounds the DRR classes
+#define CACHE_LINE_SIZE 64 // Keeps producer- and consumer-owned fields apart
+#define SUBMIT_RING_CAPACITY (1 << 16) // Jobs in flight between producers and scheduler
+#define DAEMON_MAX_EVENTS 256 // Socket events taken per epoll_wait
+#define DAEMON_READ_CHUNK (64 << 10) // Bytes read from a client per event
+#define DAEMON_MAX_LINE (16 << 20) // Longest request line, which may be a whole batch
+#define BINARY_TRACE_MAGIC "SPLTRACE"
+#define BINARY_TRACE_VERSION 1
+#define BINARY_TRACE_RECORD_SIZE 16
+#define JOURNAL_MAGIC "SPLJRNAL"
+#define SNAPSHOT_MAGIC "SPLSNAPS"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 24   // Magic, version, record size, generation
+#define JOURNAL_RECORD_SIZE 24   // CRC-32C, record type, then a trace record
+#define SNAPSHOT_HEADER_SIZE 40  // Magic, version, record size, generation,
+                                 // record count, next job id, CRC-32C
+#define JOURNAL_BUFFER_SIZE (1 << 20) // Bytes of records gathered per write
+#define PACKED_ARRIVAL_BITS 31  // Packed job layout, from bit 0: arrival time,
+#define PACKED_PAGE_BITS 16     // page count, priority, and how far the job
+#define PACKED_PRIORITY_BITS 3  // id is past base_id + the job's index
+#define PACKED_ID_BITS 14
+#define PACKED_PAGE_SHIFT PACKED_ARRIVAL_BITS
+#define PACKED_PRIORITY_SHIFT (PACKED_PAGE_SHIFT + PACKED_PAGE_BITS)
+#define PACKED_ID_SHIFT (PACKED_PRIORITY_SHIFT + PACKED_PRIORITY_BITS)
+#define ARENA_CHUNK_SIZE (1 << 20) // Smallest chunk a run arena takes from malloc
+#define ARENA_RETAIN_MAX (64 << 20) // Most a run arena keeps between runs
+#define ARENA_HEADER_SIZE 64        // Chunk header, padded so blocks stay aligned
+#define DAEMON_FREE_CONNS 64        // Closed connections kept for reuse
+#define MAX_COUNTER_THREADS 256 // Threads with counters of their own; later ones share the last
+#define TRACE_RING_RECORDS (1 << 16) // Newest trace records kept per thread (a power of two)
+#define PARALLEL_MIN_JOBS (1 << 18) // Sorts and metrics scans this large split across the pool
+#define SCAN_BLOCK (1 << 16) // Jobs per block of a metrics scan (a multiple of METRICS_TILE)
+#define QUEUE_PAGE_DEFAULT 20 // Jobs per QUEUE reply unless the client asks
+#define QUEUE_PAGE_MAX 10000  // Most jobs one QUEUE reply may list
+#define DISPLAY_PAGE_JOBS 4096 // Rows displayQueue() copies and writes at a time
+
+// Structure to represent a single print job
+typedef struct {
+    int job_id;
+    int page_count; // Analogous to "Burst Time"
+    int priority;   // Lower number = higher priority
+    int arrival_time; // Time the job reaches the spooler
+} PrintJob;
+
+// Scheduling policies, shared by the online heaps and the simulator
+typedef enum {
+    POLICY_FCFS,      // Ordered by arrival_time, then job_id
+    POLICY_SJF,       // Ordered by page_count, then job_id
+    POLICY_PRIORITY,  // Ordered by priority, then job_id
+    POLICY_SRTF,      // Preemptive, ordered by remaining pages, then job_id
+    POLICY_PREEMPTIVE_PRIORITY, // Preemptive, ordered like POLICY_PRIORITY
+    POLICY_AGING,     // Priority that improves while waiting (see agingKey)
+    POLICY_MLFQ,      // Multi-level feedback queue, demoting after each quantum
+    POLICY_DRR,       // Deficit round robin across the priority classes
+    POLICY_COUNT
+} SchedPolicy;
+
+// FCFS, SJF and Priority also keep live heaps for online dispatch
+#define ONLINE_POLICY_COUNT 3
+
+// Indexed binary min-heap over positions in job_queue
+typedef struct {
+    SchedPolicy policy;
+    int* slots;   // slots[k] = job_queue index of the k-th heap entry
+    int* pos;     // pos[i] = heap position of job_queue[i]
+    int size;     // Number of entries in the heap
+    int capacity; // Number of entries allocated in slots and pos
+} JobHeap;
+
+// Open-addressed map from job ids to ints, probed linearly. Job ids are
+// positive, so an id of 0 marks an empty slot.
+typedef struct {
+    int* ids;
+    int* values;
+    size_t mask; // Slots - 1; the slot count is a power of two
+    size_t used;
+} IdMap;
+
+// Fenwick tree over keys 1..size, counting jobs and summing their pages
+typedef struct {
+    long long* count;
+    long long* pages;
+    int size;          // A power of two, or 0 before first use
+} PageFenwick;
+
+// A node of an OrderTree: one job, by its sort key
+typedef struct {
+    int key[3];      // The policy's field, job_id, page_count
+    int left, right; // Children, 0 for none
+    int count;       // Jobs in this subtree
+    long long pages; // Their pages
+} OrderNode;
+
+// The live jobs in one online policy's dispatch order: a treap, so that
+// a job can be added or removed anywhere in the order, and the jobs and
+// pages ahead of it counted, in expected O(log n)
+typedef struct {
+    OrderNode* nodes; // nodes[0] stands for the empty tree
+    int root;
+    int used;         // Slots handed out, nodes[0] included
+    int capacity;
+    int free_list;    // Freed slots, chained through `left`
+} OrderTree;
+
+// Totals for one printer draining the live queue now, in each online
+// policy's order, kept up to date as jobs come and go. A job's wait is
+// then the pages queued ahead of it.
+typedef struct {
+    long long total_wait[ONLINE_POLICY_COUNT];
+    long long total_pages;
+    int jobs;
+    PageFenwick by_pages;    // For SJF
+    OrderTree by_arrival;    // For FCFS
+    OrderTree by_priority;   // For Priority
+} RunningMetrics;
+
+// Live queue counters, published under a sequence lock so that any
+// thread can take a consistent reading (readQueueCounters()) while the
+// scheduler thread, their only writer, never waits. `sequence` is odd
+// while an update is under way and advances by two per update, so half
+// of it is the queue's epoch.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_ullong sequence;
+    atomic_int depth;    // Jobs queued
+    atomic_llong pages;  // Their pages
+    atomic_int class_depth[PRIORITY_CLASSES + 1]; // Entry 0: other priorities
+    atomic_llong class_pages[PRIORITY_CLASSES + 1];
+    atomic_llong added;   // Jobs ever queued
+    atomic_llong removed; // Jobs ever dispatched or cancelled
+} QueueCounters;
+
+// One consistent reading of QueueCounters, or a change to apply to them
+typedef struct {
+    unsigned long long epoch;
+    int depth;
+    long long pages;
+    int class_depth[PRIORITY_CLASSES + 1];
+    long long class_pages[PRIORITY_CLASSES + 1];
+    long long added;
+    long long removed;
+} QueueView;
+
+// A run of job_queue slots whose queue positions (the QUEUE cursors)
+// are consecutive. Compaction starts a new run wherever it squeezed jobs
+// out, so the jobs that stay keep their positions.
+typedef struct {
+    int slot;           // First slot of the run
+    long long position; // Queue position of that slot
+} QueueRun;
+
+// Kinds of event driving the discrete-event simulation
+typedef enum {
+    EVENT_COMPLETION, // The printer finished its current job
+    EVENT_ARRIVAL     // A job reached the spooler
+} EventType;
+
+// A single timestamped event in the simulation
+typedef struct {
+    long long time;
+    EventType type;
+    int job;     // Arrival: index in the arrival-ordered array.
+                 // Completion: stamp of the printer slice that ends.
+    int printer; // Completion: the printer that finishes
+} SimEvent;
+
+// Time-ordered min-heap of pending events, kept in the run arena
+typedef struct {
+    SimEvent* items;
+    int size;
+    int capacity;
+} EventQueue;
+
+// A job inside the simulator, with its progress so far
+typedef struct {
+    PrintJob job;
+    int remaining; // Pages still to print
+} SimJob;
+
+// Min-heap of jobs that have arrived but not finished. Its order is the
+// policy the scheduler was specialised for, passed to each operation.
+typedef struct {
+    SimJob* items;
+    int size;
+    uint64_t* keys; // Packed jobs: packedReadyKey() entries instead of items
+} ReadyQueue;
+
+// FIFO queues threaded through one array of simulated jobs: the MLFQ
+// levels, or the DRR priority classes
+typedef struct {
+    SimJob* jobs;       // jobs[i] = progress of the i-th arrival
+    int* next;          // Next entry of the same queue, -1 at its tail
+    int head[MAX_MLFQ_LEVELS]; // -1 while the queue is empty
+    int tail[MAX_MLFQ_LEVELS];
+    unsigned nonempty;  // Bit q set while queue q holds jobs
+    long long deficit[MAX_MLFQ_LEVELS]; // DRR: pages class q may still send
+    int turn;           // DRR: the class being served
+    int credited;       // DRR: 1 once `turn` has had this visit's quantum
+} SliceQueues;
+
+// Min-heap of printers ordered by the time each one is next free
+typedef struct {
+    int* heap;          // Printer numbers, earliest free first
+    long long* free_at; // free_at[p] = time printer p is next free
+    int size;
+} PrinterPool;
+
+// One shard of a sharded spool (--shards): its own queue and printers.
+// An unsharded run is a single shard holding every printer.
+typedef struct {
+    ReadyQueue ready; // Its waiting jobs, best first under the policy
+    PrinterPool idle; // Its idle printers, by number within the shard
+    int home;         // Jobs submitted to it
+} Shard;
+
+// Per-printer and aggregate outcomes of one simulation run
+typedef struct {
+    int printers;                      // Number of printers simulated
+    long long makespan;                // Completion time of the last job
+    long long busy_time[MAX_PRINTERS]; // Time each printer was occupied
+    int jobs_printed[MAX_PRINTERS];    // Jobs each printer completed
+    int preemptions;
+    long long switch_overhead;         // Total time spent switching jobs
+    int jobs_stolen;                   // Jobs taken from another shard's queue
+} SimStats;
+
+// How coalescing (--coalesce) grouped the jobs of one run into printer runs
+typedef struct {
+    int runs;         // Printer runs: batches plus jobs printed on their own
+    int batches;      // Runs of two or more jobs
+    int batched_jobs; // Jobs printed in those batches
+} CoalesceStats;
+
+// Summary metrics of one simulation run
+typedef struct {
+    double avg_wait_time;
+    double avg_turnaround_time;
+    long long max_wait_time;
+    long long makespan;    // Completion time of the last job
+    double utilization;    // Percentage of fleet time spent printing
+    int preemptions;
+} SimResult;
+
+// A range jobs[lo..hi) still to be sorted, with its recursion budget
+typedef struct {
+    int lo;
+    int hi;
+    int depth;
+} SortRange;
+
+// Simulator of one policy, specialised at compile time (see
+// SPECIALIZE_SCHEDULER). The contract is scheduleJobs()'s, less the
+// policy argument.
+typedef int (*ScheduleFn)(const PrintJob jobs[], int count, PrintJob order[],
+                          long long completion[], SimStats* stats);
+
+// Jobs packed into one 64-bit word each, half the size of a PrintJob,
+// for replaying huge backlogs (see packJobs). Always in FCFS order, with
+// ids rising, so index order is also job_id order.
+typedef struct {
+    uint64_t* words;
+    int count;
+    int base_id;  // Job i's id is base_id + i + the id delta in words[i]
+} PackedJobs;
+
+// The arrival-ordered jobs one run of the event loop dispatches, in the
+// wide or the packed layout
+typedef struct {
+    PrintJob* order;          // Wide: the arrivals, overwritten in dispatch order
+    const PackedJobs* packed; // Packed: the jobs, in arrival order
+    int* order_index;         // Packed: output, their indexes in dispatch order
+    int count;
+} LoopJobs;
+
+// Simulator for packed jobs: like ScheduleFn, but the dispatch order is
+// written as indexes into `jobs` rather than as copies of the jobs
+typedef int (*PackedScheduleFn)(const PackedJobs* jobs, int order[],
+                                long long completion[], SimStats* stats);
+
+// Registry entry describing one scheduling policy. Adding a policy
+// takes an enum value, its ordering in readyBefore() and a row in
+// policy_ops; the menu, --policy and every report pick it up from there.
+typedef struct {
+    const char* key;     // --policy name and CSV tag
+    const char* name;    // Report title
+    const char* menu;    // Menu entry
+    int preemptive;      // 1 if it may interrupt a printing job
+    int back_to_back;    // 1 if on one printer jobs print whole in `order`,
+                         // so no completion times are needed
+    ScheduleFn schedule;
+    PackedScheduleFn schedule_packed; // Or NULL if it needs the wide layout
+} PolicyOps;
+
+// One tile of a job sequence, split into the columns the metrics pass
+// reads, so the vector loop streams packed 32-bit keys
+typedef struct {
+    int page_counts[METRICS_TILE];
+    int arrival_times[METRICS_TILE];
+} JobColumnTile;
+
+// Log-linear latency histogram: exact below 2^HISTOGRAM_EXACT_BITS,
+// then HISTOGRAM_SUB_BUCKETS buckets per power of two, so any recorded
+// value is known to within 1/128 of itself. The size is fixed whatever
+// the number or range of values.
+typedef struct {
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    long long total;   // Values recorded
+    long long max;     // Largest value recorded, exactly
+} LatencyHistogram;
+
+// Wait and turnaround distributions of a run. Entry 0 holds jobs with a
+// priority outside 1..PRIORITY_CLASSES, entry c holds priority c.
+typedef struct {
+    LatencyHistogram wait[PRIORITY_CLASSES + 1];
+    LatencyHistogram turnaround[PRIORITY_CLASSES + 1];
+    double slowdown_sum;     // Sum over jobs of turnaround / pages
+    double slowdown_squares; // Sum of their squares, for Jain's index
+} LatencyStats;
+
+// Running totals of jobs printed back to back on one printer
+typedef struct {
+    long long clock;       // Completion time of the last job so far
+    double total_wait;
+    double total_pages;
+    long long max_wait;
+} BackToBackTotals;
+
+// A unit of work for the thread pool
+typedef void (*TaskFn)(void* arg);
+
+typedef struct {
+    TaskFn fn;
+    void* arg;
+} PoolTask;
+
+// xoshiro256** pseudo-random generator state
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// Double-ended task queue owned by one worker. The owner takes tasks
+// from the back; idle workers steal from the front.
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask* items; // Ring buffer of tasks
+    int head;        // Index of the front task
+    int size;
+    int capacity;
+} WorkDeque;
+
+struct ThreadPool;
+
+// One worker thread with its own task deque and random stream
+typedef struct {
+    struct ThreadPool* pool;
+    int index;
+    pthread_t thread;
+    WorkDeque deque;
+    Rng rng; // Used for victim selection and by tasks via workerRng()
+} PoolWorker;
+
+// Work-stealing pool of worker threads
+typedef struct ThreadPool {
+    PoolWorker* workers;
+    int worker_slots;          // Deques allocated, fixed before threads start
+    int thread_count;          // Threads actually started
+    pthread_mutex_t lock;      // Only guards sleeping and waking
+    pthread_cond_t work_ready; // Signalled when a task is queued
+    pthread_cond_t work_done;  // Signalled when the last task finishes
+    atomic_int queued;         // Tasks sitting in some deque
+    atomic_int unfinished;     // Tasks queued or still running
+    atomic_int next_worker;    // Round-robin target for outside submissions
+    int stopping;
+} ThreadPool;
+
+// Job-size distributions for synthetic workloads
+typedef enum {
+    SIZE_UNIFORM,     // Uniform on 1 .. 2 * mean - 1
+    SIZE_EXPONENTIAL, // Geometric (discretised exponential)
+    SIZE_LOGNORMAL,   // Heavy-ish tail, sigma = 1
+    SIZE_PARETO,      // Heavy tail, shape PARETO_SHAPE
+    SIZE_DIST_COUNT
+} SizeDist;
+
+// Arrival processes for synthetic workloads
+typedef enum {
+    ARRIVAL_POISSON, // Exponential gaps
+    ARRIVAL_BURSTY,  // On-off: tight bursts separated by idle periods
+    ARRIVAL_MODEL_COUNT
+} ArrivalModel;
+
+// Parameters of one synthetic workload
+typedef struct {
+    double load;       // Offered load per printer (utilization target)
+    int printers;      // Printers in the simulated fleet
+    SizeDist sizes;    // Page-count distribution
+    double mean_pages; // Mean page count
+    ArrivalModel arrivals;
+    int class_weights[3]; // Relative shares of priorities 1, 2 and 3
+    int jobs;          // Jobs per workload
+} WorkloadSpec;
+
+// Parameter grid for --sweep
+typedef struct {
+    double loads[MAX_SWEEP_VALUES];
+    int load_count;
+    int fleets[MAX_SWEEP_VALUES];
+    int fleet_count;
+    SizeDist sizes[SIZE_DIST_COUNT];
+    int size_count;
+    double mean_pages;
+    ArrivalModel arrivals;
+    int class_weights[3];
+    int jobs;          // Jobs per generated workload
+    int replicates;    // Independent workloads per grid point
+    uint64_t seed;
+} SweepConfig;
+
+// One chunk of a parallel --generate run
+typedef struct {
+    const WorkloadSpec* spec;
+    PrintJob* jobs;    // This chunk's slice of the output
+    int count;
+    int first_id;
+    uint64_t seed;
+    double span;       // Clock after the chunk's last arrival, -1 on overflow
+} GenerateTask;
+
+// One replicate at one grid point: a workload run under every policy
+typedef struct {
+    WorkloadSpec spec;
+    uint64_t seed;
+    int policy;        // SchedPolicy to run, or -1 for all
+    int ok;
+    double avg_wait[POLICY_COUNT];
+    double avg_turnaround[POLICY_COUNT];
+} SweepTask;
+
+// On-disk header of a binary trace. Every field of the header and of
+// the records that follow it is stored little-endian. Each record is
+// four 32-bit signed integers: job_id, page_count, priority,
+// arrival_time, which is exactly the in-memory PrintJob layout on
+// little-endian hosts.
+typedef struct {
+    char magic[8];         // BINARY_TRACE_MAGIC, not NUL-terminated
+    uint32_t version;      // BINARY_TRACE_VERSION
+    uint32_t record_size;  // Bytes per job record
+    uint64_t record_count; // Number of job records after the header
+    uint64_t reserved;     // Must be 0
+} BinaryTraceHeader;
+
+// A binary trace opened for replay
+typedef struct {
+    void* base;            // Start of the mapping, or of a decoded copy
+    size_t length;         // Bytes mapped (0 if `base` is a heap copy)
+    const PrintJob* jobs;  // The trace's job records
+    int count;
+} MappedTrace;
+
+// How much a simulation run reports
+typedef enum {
+    OUTPUT_OFF,     // Nothing; the metrics are still computed
+    OUTPUT_SUMMARY, // Averages and fleet statistics only
+    OUTPUT_TABLE,   // A row per job, then the summary (the default)
+    OUTPUT_CSV,     // The summary, plus a CSV row per job
+    OUTPUT_MODE_COUNT
+} OutputMode;
+
+// Rows collected in memory and written with one fwrite per buffer
+typedef struct {
+    char* data;
+    size_t used;
+    FILE* file;
+    int failed;     // 1 once a write has failed
+} OutputBuffer;
+
+// One slot of the submission ring. `sequence` says whose turn it is:
+// equal to the slot's position when free for a producer, position + 1
+// once the job is published for the scheduler.
+typedef struct {
+    atomic_size_t sequence;
+    PrintJob job;
+} SubmitCell;
+
+// Bounded multi-producer, single-consumer ring of submitted jobs
+// (Vyukov's sequenced cells). Producers claim a slot with one CAS on
+// `tail` and publish it through its sequence; only the scheduler thread
+// moves `head`. No lock is taken on either side.
+typedef struct {
+    SubmitCell* cells;
+    size_t mask;                                 // Capacity - 1, a power of two
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; // Next slot a producer claims
+    _Alignas(CACHE_LINE_SIZE) size_t head;        // Next slot the scheduler reads
+} SubmitRing;
+
+// One producer thread of --submit-bench
+typedef struct {
+    pthread_t thread;
+    int jobs;      // Jobs this producer submits
+    uint64_t seed;
+    int started;   // 1 if the thread was created
+    int views;     // Queue counter readings it took mid-run
+    int torn;      // Readings whose class counts did not add up (never, if
+                   // the sequence lock holds)
+    int deepest;   // Deepest queue it saw
+} SubmitProducer;
+
+// Job counts and repetitions for --bench
+typedef struct {
+    int jobs[MAX_SWEEP_VALUES];
+    int job_count;
+    int runs;   // Timed runs per case; the median is reported
+    int warmup; // Untimed runs first
+} BenchConfig;
+
+// What one --bench case works on
+typedef struct {
+    const PrintJob* jobs;   // The generated workload, in arrival order
+    int count;
+    PrintJob* work;         // Room for `count` jobs a case may reorder
+    LatencyStats* latency;
+    SchedPolicy policy;     // For the simulation cases
+    PackedJobs packed;      // `jobs` packed, or no words if they do not fit
+    int* packed_order;      // Room for `count` indexes
+    char csv_path[512];     // The workload as a CSV and a binary trace,
+    char binary_path[512];  // for the ingestion cases
+} BenchContext;
+
+// One --bench case: `prepare` sets up each run untimed, `run` is timed
+typedef struct {
+    const char* name;
+    void (*prepare)(BenchContext* context); // Or NULL
+    int (*run)(BenchContext* context);      // 1 on success
+    int per_policy;                         // 1 to run once per policy, 2 once
+                                            // per policy with a packed simulator
+} BenchCase;
+
+// One client of the spooler daemon. Requests are read into `in` until
+// a full line is there; replies queue in `out` until the socket takes them.
+typedef struct DaemonConn {
+    int fd;
+    char* in;
+    size_t in_length, in_capacity;
+    char* out;
+    size_t out_length, out_sent, out_capacity;
+    int writing;  // 1 while EPOLLOUT is registered for the rest of `out`
+    int closing;  // 1 to hang up once `out` is flushed
+    int flush_queued; // 1 while on daemon_flush_list
+    struct DaemonConn* flush_next;
+    struct DaemonConn* prev; // Open connections, for shutdown
+    struct DaemonConn* next;
+} DaemonConn;
+
+// Live counters reported by the daemon's STATS command
+typedef struct {
+    long long connections;     // Accepted since start
+    int open_connections;
+    long long requests;
+    long long jobs_submitted;
+    long long rejected_batches; // SUBMITs refused whole as malformed or too large
+    long long jobs_dispatched;
+    long long jobs_cancelled;
+    long long dumps;           // DUMPs handed to a child process
+    double handle_time;        // Seconds spent handling requests, I/O excluded
+    double handle_max;         // Longest single request
+} DaemonStats;
+
+// Settings taken from the command line
+typedef struct {
+    const char* trace_path; // CSV or binary trace to load, or NULL
+    const char* convert_in; // CSV trace to convert to binary, or NULL
+    const char* convert_out;
+    int policy;             // SchedPolicy to run on the trace, or -1 for all
+    int interactive;        // Open the menu after the trace run
+    int compare;            // Compare all policies side by side
+    int packed;             // Simulate the trace as packed jobs where they fit
+    int sweep;              // Run a parameter sweep instead
+    SweepConfig sweep_config; // Also holds the workload settings for --generate
+    int generate_jobs;      // Jobs to synthesize with --generate, or 0
+    int submit_bench_jobs;  // Jobs to push through --submit-bench, or 0
+    int bench;              // Run the benchmark harness instead
+    BenchConfig bench_config;
+    const char* serve_endpoint; // Socket the daemon listens on, or NULL
+    const char* journal_path; // Journal to recover from and append to, or NULL
+    const char* write_trace_path; // Binary trace to write generated jobs to
+    const char* output_path; // File for per-job rows, or NULL for stdout
+    int show_help;
+} SpoolOptions;
+
+// How often the journal is forced to disk (--journal-sync)
+typedef enum {
+    JOURNAL_SYNC_BATCH,    // fdatasync at every group commit
+    JOURNAL_SYNC_INTERVAL, // At most once per journal_sync_interval_ms
+    JOURNAL_SYNC_NEVER,    // Left to the kernel: survives the process
+                           // crashing, not the machine
+    JOURNAL_SYNC_COUNT
+} JournalSync;
+
+// Kinds of journal record
+typedef enum {
+    JOURNAL_SUBMIT = 1,   // A job entered the live queue
+    JOURNAL_DISPATCH = 2, // A job left it for a printer
+    JOURNAL_CANCEL = 3,   // A job left it unprinted
+    JOURNAL_PRIORITY = 4  // A queued job, with its new priority
+} JournalRecordType;
+
+// Append-only journal of the live queue's changes since the last
+// snapshot (--journal). On disk: a header, then fixed-size records, each
+// checksummed so a torn tail is detected. Every field is little-endian.
+// Records are buffered in memory and written in groups by journalCommit.
+typedef struct {
+    int fd;                   // -1 while journaling is off
+    const char* path;
+    char* snapshot_path;      // path + ".snap"
+    char* snapshot_temp_path; // Written first, then renamed over it
+    unsigned char* buffer;    // Records not yet written
+    size_t length;
+    uint64_t generation;      // Bumped by each snapshot
+    long long records;        // Records since the last snapshot
+    int unsynced;             // 1 if written records await fdatasync
+    double last_sync;
+    long long commits;        // Group commits that wrote something
+    long long syncs;
+} Journal;
+
+// One malloc'd block of a run arena; its blocks follow the header
+typedef struct ArenaChunk {
+    struct ArenaChunk* next; // The previous (full) chunk
+    size_t size;             // Bytes for blocks
+    size_t used;
+} ArenaChunk;
+
+// Bump allocator for a simulation run's scratch: the ready heaps, event
+// queues, printer pools and per-printer state the engines build. Blocks
+// are never freed one by one; runPolicy() resets the whole arena after
+// each run, so a run costs no malloc once the arena has grown to fit.
+typedef struct {
+    ArenaChunk* chunks;  // Newest first; blocks come from the newest
+    size_t reserve;      // Size of the next first chunk, after a reset
+} Arena;
+
+// Events of the --perf-trace timeline (indexes trace_event_names)
+typedef enum {
+    TRACE_SORT,           // Span: a policy's dispatch-order sort
+    TRACE_SIMULATE,       // Span: one policy run
+    TRACE_METRICS,        // Span: summarizing a run
+    TRACE_DRAIN,          // Span: taking in ring submissions
+    TRACE_JOURNAL_COMMIT, // Span: a group commit that wrote something
+    TRACE_DAEMON_WAKEUP,  // Span: handling one batch of socket events
+    TRACE_DISPATCH,       // Instant: a job left the live queue
+    TRACE_QUEUE_DEPTH,    // Counter: jobs in the live queue
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+// One fixed-size trace record, as kept in a thread's ring
+typedef struct {
+    uint64_t start_ns;    // Since trace_epoch_ns
+    uint64_t duration_ns; // 0 for instants and counters
+    int64_t arg;          // Jobs involved, or the counter's value
+    uint16_t event;       // TraceEvent
+    uint16_t detail;      // The SchedPolicy, for sorts and runs
+    uint32_t unused;
+} TraceRecord;
+
+// One thread's hot-path counters, a cache line to itself so that
+// threads counting at once never share one. Only the owning thread
+// writes them (except in the shared overflow slot); the atomics let the
+// totals be read from any thread.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_llong submitted; // Jobs accepted
+    atomic_llong rejected;    // Submissions refused: invalid, ring full,
+                              // or a whole daemon batch
+    atomic_llong dispatched;
+    atomic_llong sort_ns;     // Time in sortForPolicy and sortJobsByArrival
+    atomic_llong metrics_ns;  // Time in summarizeRun
+    atomic_int depth_high;    // Deepest the live queue has been
+    int shared;               // 1 for the slot shared by overflow threads
+    TraceRecord* trace;       // Ring of TRACE_RING_RECORDS, or NULL
+    atomic_ullong traced;     // Records ever written to `trace`
+} HotCounters;
+
+// Sums of every thread's HotCounters
+typedef struct {
+    long long submitted, rejected, dispatched, sort_ns, metrics_ns;
+    int depth_high;
+    int threads;
+} HotTotals;
+
+// One worker's slice of a parallel integer sort
+typedef struct {
+    const PrintJob* src; // This pass's input
+    PrintJob* dst;       // And its output
+    int lo;              // The slice, src[lo..hi); the same in every pass
+    int hi;
+    SchedPolicy policy;  // POLICY_SJF sorts by page_count, others by priority
+    int key_min;         // The slice's smallest and largest key
+    int key_max;
+    int ascending;       // 1 if job_ids rise through the slice
+    uint32_t base;       // Subtracted from every key: the input's smallest
+    int shift;           // Lowest bit of this pass's digit
+    int* counts;         // RADIX_BUCKETS digit counts, then scatter offsets
+} SortTask;
+
+// One SCAN_BLOCK-job block of a metrics scan. Blocks are folded into a
+// run's totals in order, so the sums come out the same whether one
+// thread or many computed them.
+typedef struct {
+    long long clock_in;       // Printer clock before the block, when jobs
+    long long clock_out;      // print back to back; and after it
+    long long pages;
+    long long wait_sum;
+    long long turnaround_sum;
+    long long max_wait;
+    double slowdown_sum;
+    double slowdown_squares;
+    int rescan;               // 1 if the block must be run from clock_in
+} MetricsBlock;
+
+// One worker's run of blocks in a parallel metrics scan
+typedef struct {
+    const PrintJob* queue;
+    const long long* completion; // NULL when jobs print back to back
+    int count;
+    int first_block;
+    int end_block;
+    MetricsBlock* blocks;        // Shared; each task writes only its own
+    LatencyStats* latency;       // This worker's histograms, or NULL
+    int summarize;               // 1 for summarizeRun()'s per-job pass
+} MetricsTask;
+
+// --- Global Variables ---
+PrintJob* job_queue = NULL;   // This is our main job queue (grows on demand)
+int job_count = 0;            // Number of jobs currently in the queue
+int job_store_size = 0;       // Slots of job_queue in use, including dispatched ones
+int job_capacity = 0;         // Number of slots allocated in job_queue
+atomic_int next_job_id = 1;   // To assign unique IDs, from any thread
+
+PrintJob* scratch_queue = NULL; // Reusable buffer for sorted copies of the queue
+int scratch_capacity = 0;       // Number of slots allocated in scratch_queue
+
+// One heap per policy so the next job can be dispatched in O(log n)
+JobHeap sched_heaps[ONLINE_POLICY_COUNT] = {
+    { .policy = POLICY_FCFS }, { .policy = POLICY_SJF }, { .policy = POLICY_PRIORITY }
+};
+int heaps_ready = 0; // 1 once sched_heaps mirror the live queue
+IdMap job_index;     // job_id -> job_queue slot of each live job
+int index_ready = 0; // 1 once job_index mirrors the live queue
+int index_shadowed = 0; // 1 if a live id repeats (traces may), so only
+                        // its first job is indexed
+QueueCounters queue_counters; // Depth and pages of the live queue, for any thread
+QueueView queue_pending;      // Changes to them not yet published
+int queue_pending_changes = 0;
+int queue_deferred = 0;       // 1 while a batch gathers its changes first
+int queue_head = 0;           // No live job sits in job_queue before this slot
+QueueRun* queue_runs = NULL;  // Queue positions of job_queue's slots, where
+int queue_run_count = 0;      // compaction left gaps in them
+int queue_run_capacity = 0;
+long long queue_position_base = 1; // Without runs, slot s has position base + s
+QueueRun* queue_runs_spare = NULL; // Rebuilt into by compaction, then swapped
+int queue_runs_spare_capacity = 0;
+
+RunningMetrics running_metrics; // Backlog totals, valid while running_ready
+SubmitRing submit_ring;      // Jobs submitted by other threads, not yet stored
+int running_ready = 0;          // 1 once running_metrics matches the live queue
+
+// Spooler daemon (--serve)
+DaemonStats daemon_stats;
+DaemonConn* daemon_conns = NULL;        // Open connections
+PrintJob* daemon_batch = NULL;          // Jobs of the SUBMIT being parsed
+int daemon_batch_capacity = 0;
+volatile sig_atomic_t daemon_stop = 0;  // Set by SIGINT, SIGTERM or SHUTDOWN
+DaemonConn* daemon_flush_list = NULL;   // Connections with replies to send
+DaemonConn* daemon_free_conns = NULL;   // Closed connections kept for reuse
+int daemon_free_count = 0;
+const char* dump_dir = NULL;            // Directory DUMP writes into (--dump-dir),
+                                        // or NULL to refuse DUMP
+
+// Write-ahead journal of the live queue (--journal)
+Journal journal = { .fd = -1 };
+JournalSync journal_sync = JOURNAL_SYNC_BATCH;
+const char* journal_sync_names[JOURNAL_SYNC_COUNT] = { "batch", "interval", "never" };
+int journal_sync_interval_ms = 10;  // For JOURNAL_SYNC_INTERVAL (--journal-interval)
+long long snapshot_every = 1 << 20; // Records between snapshots (--snapshot-every)
+
+// Hot-path counters, one slot per thread, and the optional trace
+HotCounters hot_counters[MAX_COUNTER_THREADS];
+atomic_int hot_counter_threads = 0; // Slots handed out
+_Thread_local HotCounters* thread_counters = NULL; // This thread's slot, once claimed
+int trace_enabled = 0;            // 1 to record trace events (--perf-trace)
+uint64_t trace_epoch_ns = 0;      // Trace timestamps count from here
+const char* perf_trace_path = NULL; // Chrome trace written at exit, or NULL
+int perf_counters_report = 0;     // 1 to print the counters at exit (--perf-counters)
+const char* trace_event_names[TRACE_EVENT_COUNT] = {
+    "sort", "simulate", "metrics", "drain", "journal_commit", "daemon_wakeup",
+    "dispatch", "queue_depth"
+};
+
+// Names of the priority classes, indexed by priority (0 = any other)
+const char* priority_class_names[PRIORITY_CLASSES + 1] = {
+    "Other", "Faculty", "Student", "Guest"
+};
+
+// Names of the synthetic page-count distributions, indexed by SizeDist
+const char* size_dist_names[SIZE_DIST_COUNT] = {
+    "uniform", "exponential", "lognormal", "pareto"
+};
+
+// Names of the synthetic arrival processes, indexed by ArrivalModel
+const char* arrival_model_names[ARRIVAL_MODEL_COUNT] = { "poisson", "bursty" };
+
+// Time a printer loses every time a running job is preempted
+int context_switch_cost = 0;
+
+// Time a printer spends setting up before every run it prints (--setup-cost)
+int setup_cost = 0;
+
+// Jobs of at most coalesce_pages pages (0 = off) from one class are held
+// for up to coalesce_window time units and printed as one run, paying
+// the setup once (--coalesce)
+int coalesce_pages = 0;
+int coalesce_window = 0;
+
+// Number of printers sharing the spool
+int printer_count = 1;
+
+// Shards the printers are split into, each with its own queue
+// (--shards), and whether an idle shard takes work from a busy one,
+// after a delay of steal_cost (--no-steal, --steal-cost)
+int shard_count = 1;
+int shard_stealing = 1;
+int steal_cost = 0;
+
+// Waiting time that earns an aging job one priority level (--aging-interval)
+int aging_interval = 100;
+
+// Page quantum of each MLFQ level, top level first (--mlfq-quanta)
+int mlfq_quanta[MAX_MLFQ_LEVELS] = { 8, 32, 128 };
+int mlfq_levels = 3;
+
+// Pages each DRR class is credited per round for each unit of weight
+// (--drr-quantum), and the weights (--drr-weights). Entry 0 is for jobs
+// outside the known classes.
+int drr_quantum = 20;
+int drr_weights[PRIORITY_CLASSES + 1] = { 1, 4, 2, 1 };
+
+// What each simulation run prints (--output), and where per-job rows go
+OutputMode output_mode = OUTPUT_TABLE;
+const char* output_mode_names[OUTPUT_MODE_COUNT] = { "off", "summary", "table", "csv" };
+FILE* output_file = NULL; // NULL means stdout
+int csv_header_written = 0;
+
+// Worker threads used for parallel runs (--threads, 0 = one per core)
+int worker_thread_count = 0;
+ThreadPool worker_pool;
+int worker_pool_started = 0;
+
+// --- Function Declarations ---
+void runMenu();
+static void clearInputLine();
+static int readMenuNumber(const char* prompt, int* value);
+int parseOptions(int argc, char* argv[], SpoolOptions* options);
+void printUsage(const char* program);
+void runSelectedPolicies(const PrintJob jobs[], int count, int policy);
+void releaseJobStore();
+double nowSeconds();
+Arena* runArena();
+void* arenaAlloc(Arena* arena, size_t size);
+void* arenaCalloc(Arena* arena, size_t count, size_t size);
+void* arenaGrow(Arena* arena, void* block, size_t old_size, size_t new_size);
+void arenaReset(Arena* arena);
+void arenaRelease(Arena* arena);
+uint64_t nowNanos();
+HotCounters* claimHotCounters();
+void traceWrite(HotCounters* counters, TraceEvent event, int detail, long long arg,
+                uint64_t start_ns, uint64_t duration_ns);
+void sumHotCounters(HotTotals* totals);
+int writeChromeTrace(const char* path);
+void reportPerf();
+int parseTraceLine(const char* line, const char* end, PrintJob* job);
+int loadTraceFile(const char* path);
+int appendJobs(const PrintJob jobs[], int count);
+int isBinaryTrace(const char* path);
+int mapBinaryTrace(const char* path, MappedTrace* trace);
+void unmapBinaryTrace(MappedTrace* trace);
+int writeBinaryTrace(const char* path, const PrintJob jobs[], int count);
+int convertTraceFile(const char* in_path, const char* out_path);
+int openJournal(const char* path);
+void journalRecord(JournalRecordType type, const PrintJob* job);
+int journalCommit();
+int writeSnapshot();
+void closeJournal();
+void addJob();
+int storeJob(const PrintJob* job);
+int initSubmitRing(SubmitRing* ring, int capacity);
+void freeSubmitRing(SubmitRing* ring);
+int submitJob(int page_count, int priority, int arrival_time);
+int drainSubmissions();
+int runSubmitBench(int jobs);
+void runMenuPolicy(SchedPolicy policy);
+void displayQueue();
+void dispatchNextJob();
+int dispatchJob(SchedPolicy policy, PrintJob* job);
+int cancelJob(int job_id, PrintJob* job);
+int reprioritizeJob(int job_id, int priority, PrintJob* job);
+void cancelQueuedJob();
+void reprioritizeQueuedJob();
+int runDaemon(const char* endpoint);
+int openListenSocket(const char* endpoint, int* is_unix);
+void handleRequest(DaemonConn* conn, char* line, size_t length);
+int reserveJobs(PrintJob** buffer, int* capacity, int needed);
+PrintJob* getScratchQueue(int count);
+int reserveSchedulingHeaps(int capacity);
+int ensureSchedulingHeaps();
+void heapPush(JobHeap* heap, int index);
+void heapRemove(JobHeap* heap, int index);
+void compactJobQueue();
+static void compactQueueRuns();
+void invalidateQueueIndexes();
+static size_t idSlot(const IdMap* map, int id);
+int idMapInit(IdMap* map, size_t entries);
+void idMapFree(IdMap* map);
+int ensureJobIndex();
+int findJob(int job_id);
+void readQueueCounters(QueueView* view);
+int snapshotQueue(long long from, PrintJob page[], int limit, long long* next,
+                  QueueView* view);
+static inline char* formatLongLong(char* p, long long value);
+static inline char* formatPadded(char* p, long long value, int width);
+int ensureRunningMetrics();
+void runningMetricsAdd(const PrintJob* job);
+void runningMetricsRemove(const PrintJob* job);
+void runningMetricsReprioritize(const PrintJob* job, int priority);
+int runningAverages(SchedPolicy policy, double* avg_wait, double* avg_turnaround);
+void freeRunningMetrics();
+void initSimStats(SimStats* stats, int printers);
+int assignPrinters(const PrintJob order[], int count, long long completion[],
+                   SimStats* stats);
+int shardsInEffect(SchedPolicy policy, int printers);
+static inline int shardOf(int job_id, int shards);
+static inline uint64_t splitmix64(uint64_t* state);
+static Shard* deepestShard(Shard shard[], int shards);
+int scheduleSharded(const PrintJob jobs[], int count, SchedPolicy policy, int shards,
+                    int steal, PrintJob order[], long long completion[], SimStats* stats);
+static void reportSharding(const PrintJob jobs[], int count, SchedPolicy policy,
+                           const SimStats* stats, const SimResult* result,
+                           const LatencyStats* latency);
+void printPrinterReport(const SimStats* stats, int count);
+int runPolicy(const PrintJob jobs[], int count, SchedPolicy policy,
+              PrintJob order[], long long** completion, SimStats* stats);
+int runCoalescedPolicy(const PrintJob jobs[], int count, SchedPolicy policy,
+                       int max_pages, PrintJob order[], long long** completion,
+                       SimStats* stats, CoalesceStats* made);
+static void reportCoalescing(const PrintJob jobs[], int count, SchedPolicy policy,
+                             const CoalesceStats* made, const SimStats* stats,
+                             const SimResult* result);
+void summarizeRun(const PrintJob queue[], const long long completion[], int count,
+                  const SimStats* stats, SimResult* result, LatencyStats* latency);
+long long histogramPercentile(const LatencyHistogram* const parts[], int n, double q);
+void printLatencyReport(const LatencyStats* latency);
+void backToBackTotals(const PrintJob queue[], int count, BackToBackTotals* totals);
+MetricsBlock* scanMetricsParallel(ThreadPool* pool, const PrintJob queue[],
+                                  const long long completion[], int count,
+                                  int summarize, LatencyStats* latency);
+ThreadPool* parallelPool(int count);
+void runParallelTasks(ThreadPool* pool, TaskFn fn, void* tasks, size_t size, int n);
+int parallelIntegerSort(ThreadPool* pool, PrintJob jobs[], int count, SchedPolicy policy);
+void compareAllPolicies(const PrintJob jobs[], int count);
+void runTraceJobs(const PrintJob jobs[], int count, const SpoolOptions* options);
+int threadPoolInit(ThreadPool* pool, int threads);
+int threadPoolSubmit(ThreadPool* pool, TaskFn fn, void* arg);
+void threadPoolWait(ThreadPool* pool);
+void threadPoolDestroy(ThreadPool* pool);
+ThreadPool* getWorkerPool();
+void shutdownWorkerPool();
+Rng* workerRng();
+void rngSeed(Rng* rng, uint64_t seed);
+uint64_t rngNext(Rng* rng);
+int drawPageCount(Rng* rng, SizeDist dist, double mean);
+double generateJobBlock(Rng* rng, const WorkloadSpec* spec, PrintJob jobs[],
+                        int count, int first_id);
+int generateWorkload(Rng* rng, const WorkloadSpec* spec, PrintJob jobs[]);
+int generateJobs(const WorkloadSpec* spec, uint64_t seed, PrintJob jobs[], int first_id);
+int generateIntoJobStore(const WorkloadSpec* spec, uint64_t seed);
+int runGenerator(const SpoolOptions* options);
+int runSweep(const SweepConfig* config, int policy);
+int parseSweepList(const char* text, SweepConfig* config, char axis);
+int parseQuanta(const char* text);
+int parseJobCounts(const char* text, BenchConfig* config);
+int runBench(const SweepConfig* sweep, const BenchConfig* config);
+void sortJobsByArrival(PrintJob jobs[], int count);
+void sortJobsByPages(PrintJob jobs[], int count);
+void sortJobsByPriority(PrintJob jobs[], int count);
+int countingSortByPriority(PrintJob jobs[], int count);
+int radixSortByPages(PrintJob jobs[], int count);
+void sortForPolicy(PrintJob jobs[], int count, SchedPolicy policy);
+static void summarizeBlock(const PrintJob queue[], const long long completion[], int lo,
+                           int hi, MetricsBlock* block, LatencyStats* latency);
+void simulatePolicy(const PrintJob jobs[], int count, SchedPolicy policy);
+static int scheduleFCFS(const PrintJob jobs[], int count, PrintJob order[],
+                        long long completion[], SimStats* stats);
+static int scheduleSJF(const PrintJob jobs[], int count, PrintJob order[],
+                       long long completion[], SimStats* stats);
+static int schedulePriority(const PrintJob jobs[], int count, PrintJob order[],
+                            long long completion[], SimStats* stats);
+static int scheduleSRTF(const PrintJob jobs[], int count, PrintJob order[],
+                        long long completion[], SimStats* stats);
+static int schedulePreemptivePriority(const PrintJob jobs[], int count, PrintJob order[],
+                                      long long completion[], SimStats* stats);
+static int scheduleAging(const PrintJob jobs[], int count, PrintJob order[],
+                         long long completion[], SimStats* stats);
+static int scheduleMLFQ(const PrintJob jobs[], int count, PrintJob order[],
+                        long long completion[], SimStats* stats);
+static int scheduleDRR(const PrintJob jobs[], int count, PrintJob order[],
+                       long long completion[], SimStats* stats);
+static int schedulePackedFCFS(const PackedJobs* jobs, int order[],
+                              long long completion[], SimStats* stats);
+static int schedulePackedSJF(const PackedJobs* jobs, int order[],
+                             long long completion[], SimStats* stats);
+static int schedulePackedPriority(const PackedJobs* jobs, int order[],
+                                  long long completion[], SimStats* stats);
+static int schedulePackedAging(const PackedJobs* jobs, int order[],
+                               long long completion[], SimStats* stats);
+static inline int packedArrival(uint64_t word);
+static inline int packedPages(uint64_t word);
+static inline int packedJobId(const PackedJobs* packed, int i);
+static ALWAYS_INLINE uint64_t packedReadyKey(SchedPolicy policy, uint64_t word, int index);
+static inline void packedReadyPush(uint64_t heap[], int* size, uint64_t entry);
+static inline uint64_t packedReadyPop(uint64_t heap[], int* size);
+int jobsPackable(const PrintJob jobs[], int count);
+int packJobs(const PrintJob jobs[], int count, PackedJobs* packed);
+void freePackedJobs(PackedJobs* packed);
+int packedPolicyFits(const PackedJobs* packed, SchedPolicy policy);
+int runPackedPolicy(const PackedJobs* packed, SchedPolicy policy, int order[],
+                    long long** completion, SimStats* stats);
+void summarizePacked(const PackedJobs* packed, const int order[],
+                     const long long completion[], const SimStats* stats,
+                     SimResult* result, LatencyStats* latency);
+void simulatePacked(const PackedJobs* packed, SchedPolicy policy);
+void runPackedPolicies(const PrintJob jobs[], int count, int policy);
+double jainFairness(const LatencyStats* latency);
+void reportRun(const PrintJob queue[], const long long completion[], int count,
+               SchedPolicy policy, const SimStats* stats, const SimResult* result,
+               const LatencyStats* latency);
+int writeJobRows(const PrintJob queue[], const long long completion[], int count,
+                 SchedPolicy policy);
+
+// --- Policy Registry ---
+
+// Indexed by SchedPolicy
+const PolicyOps policy_ops[POLICY_COUNT] = {
+    { "fcfs", "First-Come, First-Served (FCFS)", "Run FCFS Simulation",
+      0, 1, scheduleFCFS, schedulePackedFCFS },
+    { "sjf", "Shortest Job First (SJF)", "Run SJF Simulation",
+      0, 1, scheduleSJF, schedulePackedSJF },
+    { "priority", "Priority Scheduling", "Run Priority Simulation",
+      0, 1, schedulePriority, schedulePackedPriority },
+    { "srtf", "Shortest Remaining Time First (SRTF)",
+      "Run SRTF Simulation (Preemptive)", 1, 0, scheduleSRTF, NULL },
+    { "ppriority", "Preemptive Priority Scheduling",
+      "Run Preemptive Priority Simulation", 1, 0, schedulePreemptivePriority, NULL },
+    { "aging", "Aging Priority Scheduling", "Run Aging Priority Simulation",
+      0, 1, scheduleAging, schedulePackedAging },
+    { "mlfq", "Multi-Level Feedback Queue (MLFQ)", "Run MLFQ Simulation",
+      1, 0, scheduleMLFQ, NULL },
+    { "drr", "Deficit Round Robin (DRR)", "Run Deficit Round Robin Simulation",
+      0, 0, scheduleDRR, NULL }
+};
+
+// --- Main Function ---
+int main(int argc, char* argv[]) {
+    SpoolOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.show_help) {
+        printUsage(argv[0]);
+        return 0;
+    }
+    // This thread takes counter slot 0, the trace's "scheduler" track
+    trace_enabled = (perf_trace_path != NULL);
+    trace_epoch_ns = nowNanos();
+    claimHotCounters();
+    if (perf_trace_path != NULL || perf_counters_report) {
+        atexit(reportPerf);
+    }
+    if (options.output_path != NULL) {
+        output_file = fopen(options.output_path, "w");
+        if (output_file == NULL) {
+            fprintf(stderr, "Error: Cannot create '%s'.\n", options.output_path);
+            return 1;
+        }
+    }
+
+    if (options.bench) {
+        int status = runBench(&options.sweep_config, &options.bench_config);
+        shutdownWorkerPool();
+        releaseJobStore();
+        return status;
+    }
+
+    if (options.sweep) {
+        int status = runSweep(&options.sweep_config, options.policy);
+        shutdownWorkerPool();
+        releaseJobStore();
+        return status;
+    }
+
+    if (options.journal_path != NULL) {
+        // Trace and generated jobs already live in a file of their own
+        if (options.trace_path != NULL || options.generate_jobs > 0 ||
+            options.convert_in != NULL) {
+            fprintf(stderr, "Error: --journal cannot be combined with --trace, "
+                    "--generate or --convert.\n");
+            return 1;
+        }
+        if (!openJournal(options.journal_path)) {
+            closeJournal();
+            releaseJobStore();
+            return 1;
+        }
+    }
+
+    if (options.submit_bench_jobs > 0) {
+        int status = runSubmitBench(options.submit_bench_jobs);
+        if (status == 0 && options.interactive) {
+            runMenu();
+        }
+        releaseJobStore();
+        return status;
+    }
+
+    if (options.serve_endpoint != NULL) {
+        int status = runDaemon(options.serve_endpoint);
+        shutdownWorkerPool();
+        releaseJobStore();
+        return status;
+    }
+
+    if (options.generate_jobs > 0) {
+        int status = runGenerator(&options);
+        if (status == 0 && options.interactive) {
+            runMenu();
+        }
+        shutdownWorkerPool();
+        releaseJobStore();
+        return status;
+    }
+
+    if (options.convert_in != NULL) {
+        int status = convertTraceFile(options.convert_in, options.convert_out);
+        releaseJobStore();
+        return status;
+    }
+
+    int status = 0;
+    if (options.trace_path != NULL && isBinaryTrace(options.trace_path)) {
+        // Binary traces are replayed straight from the mapping; they are
+        // only copied into job_queue if the menu needs to edit them.
+        MappedTrace trace;
+        double started = nowSeconds();
+        if (!mapBinaryTrace(options.trace_path, &trace)) {
+            status = 1;
+        } else {
+            printf("Mapped %d jobs from %s in %.3f s.\n",
+                   trace.count, options.trace_path, nowSeconds() - started);
+            runTraceJobs(trace.jobs, trace.count, &options);
+            if (options.interactive && !appendJobs(trace.jobs, trace.count)) {
+                fprintf(stderr, "Error: Out of memory while loading trace.\n");
+                status = 1;
+            }
+            unmapBinaryTrace(&trace);
+        }
+    } else if (options.trace_path != NULL) {
+        double started = nowSeconds();
+        int loaded = loadTraceFile(options.trace_path);
+        if (loaded < 0) {
+            status = 1;
+        } else {
+            printf("Loaded %d jobs from %s in %.3f s.\n",
+                   loaded, options.trace_path, nowSeconds() - started);
+            runTraceJobs(job_queue, job_count, &options);
+        }
+    }
+
+    if (status == 0 && (options.trace_path == NULL || options.interactive)) {
+        runMenu();
+    }
+
+    shutdownWorkerPool();
+    releaseJobStore();
+    return status;
+}
+
+/**
+ * @brief The interactive menu loop. Returns when the user exits or
+ * standard input ends.
+ *
+ * Options 1-6 keep their original numbers, so scripted input written
+ * for the first menu still works; later entries are appended after Exit.
+ */
+void runMenu() {
+    enum {
+        MENU_FIRST_POLICY = 3, // FCFS, SJF and Priority, in registry order
+        MENU_EXIT = 6,
+        MENU_MORE_POLICIES,    // The policies after them, in registry order
+        MENU_COMPARE = MENU_MORE_POLICIES + POLICY_COUNT - (MENU_EXIT - MENU_FIRST_POLICY),
+        MENU_DISPATCH,
+        MENU_CANCEL,
+        MENU_REPRIORITIZE
+    };
+    const int first_policies = MENU_EXIT - MENU_FIRST_POLICY;
+    int choice = 0;
+
+    while (1) {
+        printf("\n--- Print Job Spooler Simulation ---\n");
+        printf("1. Add Print Job\n");
+        printf("2. Display Current Queue (Unsorted)\n");
+        for (int k = 0; k < first_policies; k++) {
+            printf("%d. %s\n", MENU_FIRST_POLICY + k, policy_ops[k].menu);
+        }
+        printf("%d. Exit\n", MENU_EXIT);
+        for (int k = first_policies; k < POLICY_COUNT; k++) {
+            printf("%d. %s\n", MENU_MORE_POLICIES + k - first_policies, policy_ops[k].menu);
+        }
+        printf("%d. Compare All Policies\n", MENU_COMPARE);
+        printf("%d. Dispatch Next Job\n", MENU_DISPATCH);
+        printf("%d. Cancel a Job\n", MENU_CANCEL);
+        printf("%d. Change a Job's Priority\n", MENU_REPRIORITIZE);
+        printf("--------------------------------------\n");
+        printf("Enter your choice: ");
+
+        int read = scanf("%d", &choice);
+        if (read == EOF) {
+            printf("\nExiting simulation. Goodbye!\n");
+            return;
+        }
+        // Take in whatever other threads submitted meanwhile
+        drainSubmissions();
+        if (read != 1) {
+            clearInputLine();
+            printf("Invalid input. Please enter a number.\n");
+            continue;
+        }
+
+        switch (choice) {
+            case 1:
+                addJob();
+                break;
+            case 2:
+                displayQueue();
+                break;
+            case MENU_COMPARE:
+                if (job_count == 0) {
+                    printf("Cannot run simulation: The print queue is empty.\n");
+                } else {
+                    compactJobQueue();
+                    compareAllPolicies(job_queue, job_count);
+                }
+                break;
+            case MENU_DISPATCH:
+                dispatchNextJob();
+                break;
+            case MENU_CANCEL:
+                cancelQueuedJob();
+                break;
+            case MENU_REPRIORITIZE:
+                reprioritizeQueuedJob();
+                break;
+            case MENU_EXIT:
+                printf("Exiting simulation. Goodbye!\n");
+                return;
+            default:
+                if (choice >= MENU_FIRST_POLICY && choice < MENU_EXIT) {
+                    runMenuPolicy((SchedPolicy)(choice - MENU_FIRST_POLICY));
+                } else if (choice >= MENU_MORE_POLICIES && choice < MENU_COMPARE) {
+                    runMenuPolicy((SchedPolicy)(choice - MENU_MORE_POLICIES + first_policies));
+                } else {
+                    printf("Invalid choice. Please try again.\n");
+                }
+        }
+        // One group commit per command, covering the drained submissions too
+        journalCommit();
+    }
+}
+
+/**
+ * @brief Discards the rest of the current input line. Stops at end of
+ * input too, so a closed stdin cannot leave a prompt spinning.
+ */
+static void clearInputLine() {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF);
+}
+
+/**
+ * @brief Prints `prompt` and reads one number for a menu prompt. Input
+ * that is not a number is discarded up to the end of its line.
+ * @return 1 if a number was read, 0 on bad input or at end of input.
+ */
+static int readMenuNumber(const char* prompt, int* value) {
+    printf("%s", prompt);
+    if (scanf("%d", value) != 1) {
+        clearInputLine();
+        return 0;
+    }
+    return 1;
+}
+
+// --- Command-Line Options ---
+
+/**
+ * @brief Parses the command line into `options`.
+ * @return 1 on success, 0 if an argument is unknown or malformed.
+ */
+int parseOptions(int argc, char* argv[], SpoolOptions* options) {
+    options->trace_path = NULL;
+    options->convert_in = NULL;
+    options->convert_out = NULL;
+    options->policy = -1; // All policies
+    options->interactive = 0;
+    options->compare = 0;
+    options->packed = 0;
+    options->sweep = 0;
+    SweepConfig* sweep = &options->sweep_config;
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->mean_pages = 20.0;
+    sweep->arrivals = ARRIVAL_POISSON;
+    sweep->class_weights[0] = 20; // Faculty
+    sweep->class_weights[1] = 50; // Student
+    sweep->class_weights[2] = 30; // Guest
+    sweep->jobs = 10000;
+    sweep->replicates = 10;
+    sweep->seed = 1;
+    options->generate_jobs = 0;
+    options->submit_bench_jobs = 0;
+    options->serve_endpoint = NULL;
+    options->bench = 0;
+    BenchConfig* bench = &options->bench_config;
+    bench->jobs[0] = 100;
+    bench->jobs[1] = 10000;
+    bench->jobs[2] = 1000000;
+    bench->job_count = 3;
+    bench->runs = 5;
+    bench->warmup = 1;
+    options->journal_path = NULL;
+    options->write_trace_path = NULL;
+    options->output_path = NULL;
+    options->show_help = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+            options->trace_path = argv[++i];
+        } else if (strcmp(arg, "--convert") == 0 && i + 2 < argc) {
+            options->convert_in = argv[++i];
+            options->convert_out = argv[++i];
+        } else if (strcmp(arg, "--policy") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int found = (strcmp(name, "all") == 0) ? -1 : -2;
+            for (int k = 0; k < POLICY_COUNT; k++) {
+                if (strcmp(name, policy_ops[k].key) == 0) {
+                    found = k;
+                }
+            }
+            if (found == -2) {
+                fprintf(stderr, "Error: Unknown policy '%s'.\n", name);
+                return 0;
+            }
+            options->policy = found;
+        } else if (strcmp(arg, "--switch-cost") == 0 && i + 1 < argc) {
+            context_switch_cost = atoi(argv[++i]);
+            if (context_switch_cost < 0) {
+                fprintf(stderr, "Error: --switch-cost cannot be negative.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--shards") == 0 && i + 1 < argc) {
+            shard_count = atoi(argv[++i]);
+            if (shard_count < 1 || shard_count > MAX_PRINTERS) {
+                fprintf(stderr, "Error: --shards must be between 1 and %d.\n", MAX_PRINTERS);
+                return 0;
+            }
+        } else if (strcmp(arg, "--steal-cost") == 0 && i + 1 < argc) {
+            steal_cost = atoi(argv[++i]);
+            if (steal_cost < 0) {
+                fprintf(stderr, "Error: --steal-cost cannot be negative.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--no-steal") == 0) {
+            shard_stealing = 0;
+        } else if (strcmp(arg, "--setup-cost") == 0 && i + 1 < argc) {
+            setup_cost = atoi(argv[++i]);
+            if (setup_cost < 0) {
+                fprintf(stderr, "Error: --setup-cost cannot be negative.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--coalesce") == 0 && i + 1 < argc) {
+            char extra;
+            if (sscanf(argv[++i], "%d,%d%c", &coalesce_pages, &coalesce_window,
+                       &extra) != 2 || coalesce_pages < 1 || coalesce_window < 0) {
+                fprintf(stderr, "Error: --coalesce takes a page limit of at least 1 "
+                        "and a non-negative window.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--aging-interval") == 0 && i + 1 < argc) {
+            aging_interval = atoi(argv[++i]);
+            if (aging_interval < 1) {
+                fprintf(stderr, "Error: --aging-interval must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--mlfq-quanta") == 0 && i + 1 < argc) {
+            if (!parseQuanta(argv[++i])) {
+                fprintf(stderr, "Error: --mlfq-quanta takes 1 to %d positive quanta.\n",
+                        MAX_MLFQ_LEVELS);
+                return 0;
+            }
+        } else if (strcmp(arg, "--drr-quantum") == 0 && i + 1 < argc) {
+            drr_quantum = atoi(argv[++i]);
+            if (drr_quantum < 1) {
+                fprintf(stderr, "Error: --drr-quantum must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--drr-weights") == 0 && i + 1 < argc) {
+            int* w = drr_weights;
+            char extra;
+            if (sscanf(argv[++i], "%d,%d,%d%c", &w[1], &w[2], &w[3], &extra) != 3 ||
+                w[1] < 1 || w[2] < 1 || w[3] < 1) {
+                fprintf(stderr, "Error: --drr-weights takes three positive weights.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--printers") == 0 && i + 1 < argc) {
+            printer_count = atoi(argv[++i]);
+            if (printer_count < 1 || printer_count > MAX_PRINTERS) {
+                fprintf(stderr, "Error: --printers must be between 1 and %d.\n",
+                        MAX_PRINTERS);
+                return 0;
+            }
+        } else if (strcmp(arg, "--compare") == 0) {
+            options->compare = 1;
+        } else if (strcmp(arg, "--sweep") == 0) {
+            options->sweep = 1;
+        } else if ((strcmp(arg, "--loads") == 0 || strcmp(arg, "--fleets") == 0 ||
+                    strcmp(arg, "--sizes") == 0) && i + 1 < argc) {
+            if (!parseSweepList(argv[++i], sweep, arg[2])) {
+                fprintf(stderr, "Error: Invalid value list for %s.\n", arg);
+                return 0;
+            }
+        } else if (strcmp(arg, "--mean-pages") == 0 && i + 1 < argc) {
+            sweep->mean_pages = atof(argv[++i]);
+            if (!(sweep->mean_pages >= 1.0)) {
+                fprintf(stderr, "Error: --mean-pages must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--jobs") == 0 && i + 1 < argc) {
+            sweep->jobs = atoi(argv[++i]);
+            if (sweep->jobs < 1) {
+                fprintf(stderr, "Error: --jobs must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--replicates") == 0 && i + 1 < argc) {
+            sweep->replicates = atoi(argv[++i]);
+            if (sweep->replicates < 1) {
+                fprintf(stderr, "Error: --replicates must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--arrivals") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int found = -1;
+            for (int m = 0; m < ARRIVAL_MODEL_COUNT; m++) {
+                if (strcmp(name, arrival_model_names[m]) == 0) {
+                    found = m;
+                }
+            }
+            if (found < 0) {
+                fprintf(stderr, "Error: Unknown arrival process '%s'.\n", name);
+                return 0;
+            }
+            sweep->arrivals = (ArrivalModel)found;
+        } else if (strcmp(arg, "--classes") == 0 && i + 1 < argc) {
+            int* w = sweep->class_weights;
+            char extra;
+            if (sscanf(argv[++i], "%d,%d,%d%c", &w[0], &w[1], &w[2], &extra) != 3 ||
+                w[0] < 0 || w[1] < 0 || w[2] < 0 || w[0] + w[1] + w[2] <= 0) {
+                fprintf(stderr, "Error: --classes takes three non-negative weights.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--generate") == 0 && i + 1 < argc) {
+            char* end;
+            long jobs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || jobs < 1 || jobs > INT_MAX) {
+                fprintf(stderr, "Error: --generate takes 1 to %d jobs.\n", INT_MAX);
+                return 0;
+            }
+            options->generate_jobs = (int)jobs;
+        } else if (strcmp(arg, "--submit-bench") == 0 && i + 1 < argc) {
+            char* end;
+            long jobs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || jobs < 1 || jobs > INT_MAX) {
+                fprintf(stderr, "Error: --submit-bench takes 1 to %d jobs.\n", INT_MAX);
+                return 0;
+            }
+            options->submit_bench_jobs = (int)jobs;
+        } else if (strcmp(arg, "--serve") == 0 && i + 1 < argc) {
+            options->serve_endpoint = argv[++i];
+        } else if (strcmp(arg, "--dump-dir") == 0 && i + 1 < argc) {
+            dump_dir = argv[++i];
+        } else if (strcmp(arg, "--bench") == 0) {
+            options->bench = 1;
+        } else if (strcmp(arg, "--bench-jobs") == 0 && i + 1 < argc) {
+            if (!parseJobCounts(argv[++i], bench)) {
+                fprintf(stderr, "Error: --bench-jobs takes 1 to %d job counts "
+                        "between 1 and %d.\n", MAX_SWEEP_VALUES, INT_MAX);
+                return 0;
+            }
+        } else if (strcmp(arg, "--bench-runs") == 0 && i + 1 < argc) {
+            bench->runs = atoi(argv[++i]);
+            if (bench->runs < 1 || bench->runs > MAX_BENCH_RUNS) {
+                fprintf(stderr, "Error: --bench-runs must be between 1 and %d.\n",
+                        MAX_BENCH_RUNS);
+                return 0;
+            }
+        } else if (strcmp(arg, "--bench-warmup") == 0 && i + 1 < argc) {
+            bench->warmup = atoi(argv[++i]);
+            if (bench->warmup < 0) {
+                fprintf(stderr, "Error: --bench-warmup cannot be negative.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--journal") == 0 && i + 1 < argc) {
+            options->journal_path = argv[++i];
+        } else if (strcmp(arg, "--journal-sync") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int found = -1;
+            for (int m = 0; m < JOURNAL_SYNC_COUNT; m++) {
+                if (strcmp(name, journal_sync_names[m]) == 0) {
+                    found = m;
+                }
+            }
+            if (found < 0) {
+                fprintf(stderr, "Error: Unknown journal sync mode '%s'.\n", name);
+                return 0;
+            }
+            journal_sync = (JournalSync)found;
+        } else if (strcmp(arg, "--journal-interval") == 0 && i + 1 < argc) {
+            journal_sync_interval_ms = atoi(argv[++i]);
+            if (journal_sync_interval_ms < 1) {
+                fprintf(stderr, "Error: --journal-interval must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--snapshot-every") == 0 && i + 1 < argc) {
+            snapshot_every = atoll(argv[++i]);
+            if (snapshot_every < 1) {
+                fprintf(stderr, "Error: --snapshot-every must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--perf-trace") == 0 && i + 1 < argc) {
+            perf_trace_path = argv[++i];
+        } else if (strcmp(arg, "--perf-counters") == 0) {
+            perf_counters_report = 1;
+        } else if (strcmp(arg, "--write-trace") == 0 && i + 1 < argc) {
+            options->write_trace_path = argv[++i];
+        } else if (strcmp(arg, "--seed") == 0 && i + 1 < argc) {
+            sweep->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0 && i + 1 < argc) {
+            worker_thread_count = atoi(argv[++i]);
+            if (worker_thread_count < 1) {
+                fprintf(stderr, "Error: --threads must be at least 1.\n");
+                return 0;
+            }
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int found = -1;
+            for (int m = 0; m < OUTPUT_MODE_COUNT; m++) {
+                if (strcmp(name, output_mode_names[m]) == 0) {
+                    found = m;
+                }
+            }
+            if (found < 0) {
+                fprintf(stderr, "Error: Unknown output mode '%s'.\n", name);
+                return 0;
+            }
+            output_mode = (OutputMode)found;
+        } else if (strcmp(arg, "--output-file") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else if (strcmp(arg, "--packed") == 0) {
+            options->packed = 1;
+        } else if (strcmp(arg, "--interactive") == 0) {
+            options->interactive = 1;
+        } else if (strcmp(arg, "--help") == 0) {
+            options->show_help = 1;
+        } else {
+            fprintf(stderr, "Error: Unknown or incomplete option '%s'.\n", arg);
+            return 0;
+        }
+    }
+
+    // Unset sweep axes fall back to a single default value
+    if (sweep->load_count == 0) {
+        sweep->loads[sweep->load_count++] = 0.8;
+    }
+    if (sweep->fleet_count == 0) {
+        sweep->fleets[sweep->fleet_count++] = printer_count;
+    }
+    if (sweep->size_count == 0 && options->bench) {
+        for (int d = 0; d < SIZE_DIST_COUNT; d++) {
+            sweep->sizes[sweep->size_count++] = (SizeDist)d;
+        }
+    } else if (sweep->size_count == 0) {
+        sweep->sizes[sweep->size_count++] = SIZE_EXPONENTIAL;
+    }
+    return 1;
+}
+
+/**
+ * @brief Parses the comma-separated --bench-jobs counts, which may be
+ * written in exponent form (1e8).
+ * @return 1 on success, 0 on a malformed or out-of-range count.
+ */
+int parseJobCounts(const char* text, BenchConfig* config) {
+    int counts = 0;
+    const char* cursor = text;
+    for (;;) {
+        char* end;
+        double jobs = strtod(cursor, &end);
+        if (end == cursor || counts == MAX_SWEEP_VALUES ||
+            !(jobs >= 1.0 && jobs <= INT_MAX) || jobs != (double)(int)jobs) {
+            return 0;
+        }
+        config->jobs[counts++] = (int)jobs;
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != ',') {
+            return 0;
+        }
+        cursor = end + 1;
+    }
+    config->job_count = counts;
+    return 1;
+}
+
+/**
+ * @brief Parses the comma-separated MLFQ quanta, top level first, into
+ * mlfq_quanta and mlfq_levels.
+ * @return 1 on success, 0 on a malformed list or too many levels.
+ */
+int parseQuanta(const char* text) {
+    int quanta[MAX_MLFQ_LEVELS];
+    int levels = 0;
+    const char* cursor = text;
+    for (;;) {
+        char* end;
+        long quantum = strtol(cursor, &end, 10);
+        if (end == cursor || quantum < 1 || quantum > INT_MAX ||
+            levels == MAX_MLFQ_LEVELS) {
+            return 0;
+        }
+        quanta[levels++] = (int)quantum;
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != ',') {
+            return 0;
+        }
+        cursor = end + 1;
+    }
+    memcpy(mlfq_quanta, quanta, (size_t)levels * sizeof(int));
+    mlfq_levels = levels;
+    return 1;
+}
+
+/**
+ * @brief Parses a comma-separated list for one sweep axis: 'l' (loads),
+ * 'f' (fleet sizes) or 's' (size distributions).
+ * @return 1 on success, 0 on a malformed or out-of-range value.
+ */
+int parseSweepList(const char* text, SweepConfig* config, char axis) {
+    char buffer[256];
+    if (strlen(text) >= sizeof(buffer)) {
+        return 0;
+    }
+    strcpy(buffer, text);
+    if (axis == 'l') {
+        config->load_count = 0;
+    } else if (axis == 'f') {
+        config->fleet_count = 0;
+    } else {
+        config->size_count = 0;
+    }
+
+    for (char* item = strtok(buffer, ","); item != NULL; item = strtok(NULL, ",")) {
+        if (axis == 'l') {
+            double load = atof(item);
+            if (config->load_count == MAX_SWEEP_VALUES || !(load > 0.0)) {
+                return 0;
+            }
+            config->loads[config->load_count++] = load;
+        } else if (axis == 'f') {
+            int fleet = atoi(item);
+            if (config->fleet_count == MAX_SWEEP_VALUES ||
+                fleet < 1 || fleet > MAX_PRINTERS) {
+                return 0;
+            }
+            config->fleets[config->fleet_count++] = fleet;
+        } else {
+            int found = -1;
+            for (int d = 0; d < SIZE_DIST_COUNT; d++) {
+                if (strcmp(item, size_dist_names[d]) == 0) {
+                    found = d;
+                }
+            }
+            if (found < 0 || config->size_count == SIZE_DIST_COUNT) {
+                return 0;
+            }
+            config->sizes[config->size_count++] = (SizeDist)found;
+        }
+    }
+    return 1;
+}
+
+void printUsage(const char* program) {
+    printf("Usage: %s [--trace FILE] [--policy NAME | --compare] [--printers M]\n"
+           "          [--switch-cost N] [--setup-cost S] [--coalesce P,W]\n"
+           "          [--shards K] [--steal-cost C] [--no-steal]\n"
+           "          [--aging-interval A] [--threads T]\n"
+           "          [--mlfq-quanta Q,..] [--drr-quantum Q] [--drr-weights F,S,G]\n"
+           "          [--interactive] [--output MODE] [--output-file FILE]\n"
+           "          [--packed] [--perf-counters] [--perf-trace FILE]\n", program);
+    printf("       %s --convert IN.csv OUT.bin\n", program);
+    printf("       %s --sweep [--loads L,..] [--fleets M,..] [--sizes D,..]\n"
+           "          [--jobs N] [--replicates R] [WORKLOAD OPTIONS]\n", program);
+    printf("       %s --generate N [--write-trace OUT.bin] [--loads L] [--sizes D]\n"
+           "          [--printers M] [WORKLOAD OPTIONS]\n", program);
+    printf("       %s --submit-bench N [--threads T] [--interactive]\n", program);
+    printf("       %s --bench [--bench-jobs N,..] [--bench-runs R] [--bench-warmup W]\n"
+           "          [--sizes D,..] [--printers M] [WORKLOAD OPTIONS]\n", program);
+    printf("       %s --serve ENDPOINT [--dump-dir DIR] [--printers M]\n"
+           "          [POLICY OPTIONS]\n", program);
+    printf("       %s --journal FILE [--journal-sync S] [--journal-interval MS]\n"
+           "          [--snapshot-every N] [--serve ENDPOINT | --submit-bench N]\n", program);
+    printf("  --trace FILE     Load jobs from a CSV trace of\n");
+    printf("                   job_id,page_count,priority[,arrival] lines,\n");
+    printf("                   or replay a binary trace in place\n");
+    printf("  --convert IN OUT Convert a CSV trace to the binary trace format\n");
+    printf("  --policy NAME    Policy to simulate for the trace: fcfs, sjf,\n");
+    printf("                   priority, srtf, ppriority, aging, mlfq, drr or\n");
+    printf("                   all (default)\n");
+    printf("  --compare        Run every policy concurrently and print one table\n");
+    printf("  --packed         Simulate the trace or generated jobs as 8-byte packed\n");
+    printf("                   jobs (FCFS, SJF, Priority and Aging; the others,\n");
+    printf("                   and jobs with over 65535 pages, priorities over 7\n");
+    printf("                   or ids out of arrival order, use the wide layout)\n");
+    printf("  --threads T      Worker threads for --compare, --sweep and\n");
+    printf("                   --generate (default: one per core)\n");
+    printf("  --sweep          Simulate synthetic workloads over a parameter grid:\n");
+    printf("                   offered loads per printer (default 0.8), fleet\n");
+    printf("                   sizes (default --printers) and page-count\n");
+    printf("                   distributions uniform, exponential (default),\n");
+    printf("                   lognormal or pareto; R replicates (default 10)\n");
+    printf("                   of N jobs (default 10000) each\n");
+    printf("  --generate N     Synthesize N jobs in parallel at the first --loads\n");
+    printf("                   value over --printers printers, then simulate them\n");
+    printf("                   as a trace (or open the menu with --interactive)\n");
+    printf("  --write-trace F  Write the generated jobs to binary trace F instead\n");
+    printf("  --submit-bench N Submit N jobs from --threads producer threads\n");
+    printf("                   through the lock-free submission ring while the\n");
+    printf("                   scheduler drains them, and report the rate\n");
+    printf("  --serve ENDPOINT Run as a spooler daemon on a Unix socket (a path\n");
+    printf("                   containing '/') or TCP [HOST:]PORT (host defaults\n");
+    printf("                   to 127.0.0.1). One request per line: SUBMIT\n");
+    printf("                   PAGES,PRIORITY[,ARRIVAL] ... (a batch of jobs),\n");
+    printf("                   DISPATCH [fcfs|sjf|priority], JOB ID, CANCEL ID,\n");
+    printf("                   PRIORITY ID P, SIMULATE POLICY, STATS, QUEUE\n");
+    printf("                   [N [FROM POS]] (a page of the queue), DUMP NAME\n");
+    printf("                   (the whole queue, written in the background),\n");
+    printf("                   QUIT or SHUTDOWN\n");
+    printf("  --dump-dir DIR   Directory DUMP NAME writes into; NAME may not\n");
+    printf("                   contain '/' or '..'. DUMP is refused without it\n");
+    printf("  --journal FILE   Recover the live queue from FILE and FILE.snap, then\n");
+    printf("                   journal every job added or dispatched. --serve\n");
+    printf("                   replies are sent after the commit; menu commands\n");
+    printf("                   and ring submissions (--submit-bench) are durable\n");
+    printf("                   once the commit that follows them completes\n");
+    printf("  --journal-sync S Force the journal to disk every group commit\n");
+    printf("                   (batch, default), every --journal-interval MS\n");
+    printf("                   (interval, default 10) or never\n");
+    printf("  --snapshot-every N  Snapshot the queue and restart the journal\n");
+    printf("                   after N records (default 1048576)\n");
+    printf("  --bench          Time the sorts, simulations, metrics, online\n");
+    printf("                   dispatch and trace ingestion on synthetic workloads\n");
+    printf("                   of each --bench-jobs size (default 100,10000,1e6)\n");
+    printf("                   and --sizes distribution (default all), W warmup\n");
+    printf("                   (default 1) and R timed runs (default 5) each, and\n");
+    printf("                   print ns/job, jobs/s and peak RSS as JSON\n");
+    printf("  --perf-counters  At exit, print the hot-path counters: jobs submitted,\n");
+    printf("                   rejected and dispatched, sort and metrics time and\n");
+    printf("                   the deepest the queue got (works with every mode)\n");
+    printf("  --perf-trace F   Trace sorts, runs, drains, commits, dispatches and\n");
+    printf("                   the queue depth, and write the newest 65536 events\n");
+    printf("                   per thread to F at exit as a Chrome trace (for\n");
+    printf("                   chrome://tracing or ui.perfetto.dev)\n");
+    printf("  --printers M     Number of printers sharing the spool (default 1)\n");
+    printf("  --shards K       Split the printers into K shards, each with its own\n");
+    printf("                   queue; jobs go to a shard by id, and a shard with\n");
+    printf("                   idle printers and no work takes the next job of the\n");
+    printf("                   shard with the most waiting (FCFS, SJF, Priority and\n");
+    printf("                   Aging; reports the tail wait against no stealing)\n");
+    printf("  --steal-cost C   Time a job taken from another shard waits to move\n");
+    printf("                   (default 0)\n");
+    printf("  --no-steal       Keep every job on its own shard\n");
+    printf("  --switch-cost N  Time a printer loses per preemption (default 0)\n");
+    printf("  --setup-cost S   Time a printer spends setting up before each run it\n");
+    printf("                   prints (default 0)\n");
+    printf("  --coalesce P,W   Hold jobs of at most P pages for up to W time units\n");
+    printf("                   and print those of one class as a single run, paying\n");
+    printf("                   the setup once; reports the throughput gained and\n");
+    printf("                   the wait added against printing them one by one\n");
+    printf("  --aging-interval A  Waiting time that earns an aging job one\n");
+    printf("                   priority level (default 100)\n");
+    printf("  --mlfq-quanta Q,..  Pages per slice at each MLFQ level, top\n");
+    printf("                   first; one level per value (default 8,32,128)\n");
+    printf("  --drr-quantum Q  Pages DRR credits per round per unit of weight\n");
+    printf("                   (default 20)\n");
+    printf("  --drr-weights F,S,G  DRR weights of priorities 1/2/3 (default 4,2,1)\n");
+    printf("  --interactive    Open the menu after the trace has been simulated\n");
+    printf("  --output MODE    What each simulation prints: off, summary, table\n");
+    printf("                   (default: a row per job) or csv rows\n");
+    printf("  --output-file F  Write the per-job table or CSV rows to F\n");
+    printf("Workload options for --sweep, --generate and --bench:\n");
+    printf("  --mean-pages P   Mean page count (default 20)\n");
+    printf("  --arrivals A     poisson (default) or bursty on-off arrivals\n");
+    printf("  --classes F,S,G  Weights of priorities 1/2/3 (default 20,50,30)\n");
+    printf("  --seed S         Random seed (default 1)\n");
+    printf("Without --trace the interactive menu starts directly.\n");
+}
+
+/**
+ * @brief Runs a loaded trace the way the command line asked for: as a
+ * side-by-side comparison, or policy by policy with full results.
+ */
+void runTraceJobs(const PrintJob jobs[], int count, const SpoolOptions* options) {
+    if (options->compare) {
+        compareAllPolicies(jobs, count);
+    } else if (options->packed) {
+        runPackedPolicies(jobs, count, options->policy);
+    } else {
+        runSelectedPolicies(jobs, count, options->policy);
+    }
+}
+
+/**
+ * @brief Runs one policy, or all of them when `policy` is -1, over
+ * `jobs`.
+ */
+void runSelectedPolicies(const PrintJob jobs[], int count, int policy) {
+    if (count == 0) {
+        printf("Cannot run simulation: The trace contains no jobs.\n");
+        return;
+    }
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (policy == -1 || policy == k) {
+            simulatePolicy(jobs, count, (SchedPolicy)k);
+        }
+    }
+}
+
+/**
+ * @brief Frees the job store and everything derived from it.
+ */
+void releaseJobStore() {
+    free(job_queue);
+    free(scratch_queue);
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        free(sched_heaps[k].slots);
+        free(sched_heaps[k].pos);
+    }
+    idMapFree(&job_index);
+    index_ready = 0;
+    free(queue_runs);
+    free(queue_runs_spare);
+    freeRunningMetrics();
+    freeSubmitRing(&submit_ring);
+    free(daemon_batch);
+    closeJournal();
+    arenaRelease(runArena());
+}
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// --- Function Implementations ---
+
+/**
+ * @brief Makes sure a job buffer can hold at least `needed` jobs.
+ * The buffer grows geometrically (doubling), so appends are amortized
+ * O(1) and the records always stay in one contiguous block.
+ *
+ * @param buffer Pointer to the buffer to grow (may point to NULL).
+ * @param capacity Pointer to the buffer's current capacity in jobs.
+ * @param needed The number of jobs the buffer must be able to hold.
+ * @return 1 on success, 0 if memory could not be allocated. On failure
+ * the existing buffer is left untouched.
+ */
+int reserveJobs(PrintJob** buffer, int* capacity, int needed) {
+    if (needed <= *capacity) {
+        return 1;
+    }
+
+    int new_capacity = (*capacity > 0) ? *capacity : INITIAL_JOB_CAPACITY;
+    while (new_capacity < needed) {
+        if (new_capacity > INT_MAX / 2) {
+            new_capacity = needed; // Can't double any further
+            break;
+        }
+        new_capacity *= 2;
+    }
+
+    PrintJob* grown = realloc(*buffer, (size_t)new_capacity * sizeof(PrintJob));
+    if (grown == NULL) {
+        return 0;
+    }
+
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+/**
+ * @brief Returns the shared scratch buffer, large enough for `count` jobs.
+ * Simulations sort and schedule into this buffer instead of allocating
+ * a fresh copy of the queue on every run.
+ *
+ * @param count The number of jobs the caller needs room for.
+ * @return The scratch buffer, or NULL if memory could not be allocated.
+ */
+PrintJob* getScratchQueue(int count) {
+    if (!reserveJobs(&scratch_queue, &scratch_capacity, count)) {
+        return NULL;
+    }
+    return scratch_queue;
+}
+
+// --- Run Arenas ---
+
+// The calling thread's run arena: pool workers simulating side by side
+// each bump their own, without touching malloc's locks
+_Thread_local Arena thread_arena = { NULL, 0 };
+
+Arena* runArena() {
+    return &thread_arena;
+}
+
+/**
+ * @brief Bump-allocates `size` bytes from `arena`, 16-byte aligned,
+ * taking a new chunk from malloc when the newest one is full. There is
+ * no per-block free; arenaReset() reclaims everything at once.
+ * @return The block, or NULL if memory could not be allocated.
+ */
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = ARENA_CHUNK_SIZE;
+        if (chunk == NULL && arena->reserve > chunk_size) {
+            chunk_size = arena->reserve; // Last run's total, in one piece
+        }
+        while (chunk_size < size) {
+            if (chunk_size > SIZE_MAX / 2) {
+                return NULL;
+            }
+            chunk_size *= 2;
+        }
+        chunk = malloc(ARENA_HEADER_SIZE + chunk_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+    void* block = (unsigned char*)chunk + ARENA_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+    return block;
+}
+
+void* arenaCalloc(Arena* arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* block = arenaAlloc(arena, count * size);
+    if (block != NULL) {
+        memset(block, 0, count * size);
+    }
+    return block;
+}
+
+/**
+ * @brief Grows `block`, of `old_size` bytes, to `new_size`: in place when
+ * it is the newest block and its chunk has room, else by copying it to
+ * a fresh block (the old one is reclaimed with the rest at the reset).
+ * @return The grown block, or NULL (leaving `block` intact) if memory
+ * could not be allocated.
+ */
+void* arenaGrow(Arena* arena, void* block, size_t old_size, size_t new_size) {
+    ArenaChunk* chunk = arena->chunks;
+    size_t old_rounded = (old_size + 15) & ~(size_t)15;
+    size_t new_rounded = (new_size + 15) & ~(size_t)15;
+    if (block != NULL && chunk != NULL &&
+        (unsigned char*)block + old_rounded ==
+            (unsigned char*)chunk + ARENA_HEADER_SIZE + chunk->used &&
+        chunk->size - chunk->used >= new_rounded - old_rounded) {
+        chunk->used += new_rounded - old_rounded;
+        return block;
+    }
+    void* grown = arenaAlloc(arena, new_size);
+    if (grown != NULL && block != NULL) {
+        memcpy(grown, block, old_size);
+    }
+    return grown;
+}
+
+/**
+ * @brief Reclaims every block of `arena` at once, at the end of a run.
+ * A lone chunk is kept for the next run; several are handed back and
+ * replaced, on the next allocation, by one chunk of their total size,
+ * so a steady workload settles into one malloc-free chunk. Nothing
+ * above ARENA_RETAIN_MAX is kept, so one huge run does not pin its
+ * memory in a long-running daemon.
+ */
+void arenaReset(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk != NULL && chunk->next == NULL && chunk->size <= ARENA_RETAIN_MAX) {
+        chunk->used = 0;
+        return;
+    }
+    size_t total = 0;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        total += chunk->size;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->reserve = total <= ARENA_RETAIN_MAX ? total : 0;
+}
+
+// Hands every chunk of `arena` back to malloc
+void arenaRelease(Arena* arena) {
+    arenaReset(arena);
+    if (arena->chunks != NULL) {
+        free(arena->chunks);
+        arena->chunks = NULL;
+    }
+    arena->reserve = 0;
+}
+
+// --- Hot-Path Counters and Tracing ---
+
+uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Gives the calling thread its own slot of hot_counters, and a
+ * trace ring when tracing. Past MAX_COUNTER_THREADS threads share the
+ * last slot, whose counts are then kept with atomic adds and which
+ * records no trace.
+ * @return The thread's slot.
+ */
+HotCounters* claimHotCounters() {
+    int slot = atomic_fetch_add(&hot_counter_threads, 1);
+    HotCounters* counters = &hot_counters[MAX_COUNTER_THREADS - 1];
+    if (slot < MAX_COUNTER_THREADS - 1) {
+        counters = &hot_counters[slot];
+        if (trace_enabled) {
+            counters->trace = malloc(TRACE_RING_RECORDS * sizeof(TraceRecord));
+        }
+    } else {
+        counters->shared = 1;
+    }
+    thread_counters = counters;
+    return counters;
+}
+
+// The calling thread's counters
+static inline HotCounters* hotCounters() {
+    HotCounters* counters = thread_counters;
+    return counters != NULL ? counters : claimHotCounters();
+}
+
+// Adds to a counter. The owner is its only writer, so a plain load and
+// store is enough, and costs no locked instruction.
+static inline void counterAdd(HotCounters* counters, atomic_llong* counter, long long n) {
+    if (counters->shared) {
+        atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(counter,
+                              atomic_load_explicit(counter, memory_order_relaxed) + n,
+                              memory_order_relaxed);
+    }
+}
+
+// Raises the queue depth high-water mark, racing benignly if shared
+static inline void counterMax(HotCounters* counters, int depth) {
+    if (depth > atomic_load_explicit(&counters->depth_high, memory_order_relaxed)) {
+        atomic_store_explicit(&counters->depth_high, depth, memory_order_relaxed);
+    }
+}
+
+// Start time of an optional trace span: 0, and no clock read, while
+// tracing is off
+static inline uint64_t traceStart() {
+    return trace_enabled ? nowNanos() : 0;
+}
+
+// Ends a span begun with traceStart()
+static inline void traceEnd(TraceEvent event, int detail, long long arg, uint64_t started) {
+    if (trace_enabled) {
+        traceWrite(hotCounters(), event, detail, arg, started, nowNanos() - started);
+    }
+}
+
+// Records an instant or counter event
+static inline void traceMark(TraceEvent event, long long arg) {
+    if (trace_enabled) {
+        traceWrite(hotCounters(), event, 0, arg, nowNanos(), 0);
+    }
+}
+
+// Charges a sort begun at `started` to the sort-time counter, and
+// traces it
+static inline void countSortTime(SchedPolicy policy, int count, uint64_t started) {
+    uint64_t elapsed = nowNanos() - started;
+    HotCounters* counters = hotCounters();
+    counterAdd(counters, &counters->sort_ns, (long long)elapsed);
+    if (trace_enabled) {
+        traceWrite(counters, TRACE_SORT, policy, count, started, elapsed);
+    }
+}
+
+/**
+ * @brief Appends a record to the thread's trace ring, overwriting the
+ * oldest once the ring is full. Owning thread only.
+ */
+void traceWrite(HotCounters* counters, TraceEvent event, int detail, long long arg,
+                uint64_t start_ns, uint64_t duration_ns) {
+    if (counters->trace == NULL) {
+        return; // The shared slot, or the ring could not be allocated
+    }
+    unsigned long long n = atomic_load_explicit(&counters->traced, memory_order_relaxed);
+    TraceRecord* record = &counters->trace[n & (TRACE_RING_RECORDS - 1)];
+    record->start_ns = start_ns - trace_epoch_ns;
+    record->duration_ns = duration_ns;
+    record->arg = arg;
+    record->event = (uint16_t)event;
+    record->detail = (uint16_t)detail;
+    record->unused = 0;
+    atomic_store_explicit(&counters->traced, n + 1, memory_order_release);
+}
+
+/**
+ * @brief Sums the counters of every thread that has claimed a slot. The
+ * totals may lag the owners by a few updates while they run.
+ */
+void sumHotCounters(HotTotals* totals) {
+    memset(totals, 0, sizeof(*totals));
+    int threads = atomic_load(&hot_counter_threads);
+    totals->threads = threads;
+    if (threads > MAX_COUNTER_THREADS) {
+        threads = MAX_COUNTER_THREADS;
+    }
+    for (int t = 0; t < threads; t++) {
+        HotCounters* counters = &hot_counters[t];
+        totals->submitted += atomic_load_explicit(&counters->submitted, memory_order_relaxed);
+        totals->rejected += atomic_load_explicit(&counters->rejected, memory_order_relaxed);
+        totals->dispatched += atomic_load_explicit(&counters->dispatched, memory_order_relaxed);
+        totals->sort_ns += atomic_load_explicit(&counters->sort_ns, memory_order_relaxed);
+        totals->metrics_ns += atomic_load_explicit(&counters->metrics_ns, memory_order_relaxed);
+        int depth = atomic_load_explicit(&counters->depth_high, memory_order_relaxed);
+        if (depth > totals->depth_high) {
+            totals->depth_high = depth;
+        }
+    }
+}
+
+/**
+ * @brief Writes every thread's trace ring to `path` in the Chrome trace
+ * event format, which chrome://tracing and Perfetto open: spans as
+ * complete ("X") events, dispatches as instants and the queue depth as
+ * a counter track, one track per thread. Call once the traced threads
+ * have stopped.
+ * @return 1 on success, 0 on an I/O error.
+ */
+int writeChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot create '%s'.\n", path);
+        return 0;
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    int threads = atomic_load(&hot_counter_threads);
+    if (threads > MAX_COUNTER_THREADS) {
+        threads = MAX_COUNTER_THREADS;
+    }
+    long long dropped = 0;
+    int first = 1;
+    for (int t = 0; t < threads; t++) {
+        const HotCounters* counters = &hot_counters[t];
+        if (counters->trace == NULL) {
+            continue;
+        }
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s %d\"}}", first ? "" : ",\n", t,
+                t == 0 ? "scheduler" : "thread", t);
+        first = 0;
+        unsigned long long traced = atomic_load_explicit(&counters->traced,
+                                                         memory_order_acquire);
+        unsigned long long oldest = 0;
+        if (traced > TRACE_RING_RECORDS) {
+            oldest = traced - TRACE_RING_RECORDS;
+            dropped += (long long)oldest;
+        }
+        for (unsigned long long n = oldest; n < traced; n++) {
+            const TraceRecord* record = &counters->trace[n & (TRACE_RING_RECORDS - 1)];
+            const char* name = trace_event_names[record->event];
+            const char* arg_name = record->event == TRACE_DAEMON_WAKEUP ? "events"
+                : record->event == TRACE_JOURNAL_COMMIT ? "records" : "jobs";
+            double ts = record->start_ns / 1e3; // Chrome traces count in microseconds
+            if (record->event == TRACE_QUEUE_DEPTH) {
+                fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, "
+                        "\"tid\": %d, \"args\": {\"jobs\": %lld}}",
+                        name, ts, t, (long long)record->arg);
+            } else if (record->event == TRACE_DISPATCH) {
+                fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, "
+                        "\"pid\": 1, \"tid\": %d, \"args\": {\"job_id\": %lld}}",
+                        name, ts, t, (long long)record->arg);
+            } else if (record->event == TRACE_SORT || record->event == TRACE_SIMULATE) {
+                fprintf(file, ",\n{\"name\": \"%s %s\", \"ph\": \"X\", \"ts\": %.3f, "
+                        "\"dur\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {\"jobs\": %lld}}",
+                        name, policy_ops[record->detail].key, ts, record->duration_ns / 1e3,
+                        t, (long long)record->arg);
+            } else {
+                fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                        "\"dur\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {\"%s\": %lld}}",
+                        name, ts, record->duration_ns / 1e3, t, arg_name,
+                        (long long)record->arg);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (ferror(file) | (fclose(file) != 0)) {
+        fprintf(stderr, "Error: Cannot write '%s'.\n", path);
+        return 0;
+    }
+    if (dropped > 0) {
+        fprintf(stderr, "Trace rings overflowed: the oldest %lld event(s) were dropped.\n",
+                dropped);
+    }
+    return 1;
+}
+
+/**
+ * @brief At exit: prints the summed counters (--perf-counters) and
+ * writes the trace (--perf-trace), then frees the trace rings.
+ */
+void reportPerf() {
+    if (perf_counters_report) {
+        HotTotals totals;
+        sumHotCounters(&totals);
+        fprintf(stderr, "Counters over %d thread(s): submitted=%lld rejected=%lld "
+                "dispatched=%lld sort_ms=%.3f metrics_ms=%.3f depth_high=%d\n",
+                totals.threads, totals.submitted, totals.rejected, totals.dispatched,
+                totals.sort_ns / 1e6, totals.metrics_ns / 1e6, totals.depth_high);
+    }
+    if (perf_trace_path != NULL) {
+        writeChromeTrace(perf_trace_path);
+    }
+    for (int t = 0; t < MAX_COUNTER_THREADS; t++) {
+        free(hot_counters[t].trace);
+        hot_counters[t].trace = NULL;
+    }
+}
+
+// --- Online Scheduling Heaps ---
+
+// A slot in job_queue whose page_count is 0 holds a dispatched job
+// that has not been compacted away yet.
+static inline int isDispatched(const PrintJob* job) {
+    return job->page_count == 0;
+}
+
+// Returns 1 if job `a` must be dispatched before job `b` under `policy`.
+static ALWAYS_INLINE int jobBefore(SchedPolicy policy, const PrintJob* a, const PrintJob* b) {
+    switch (policy) {
+        case POLICY_FCFS:
+            if (a->arrival_time != b->arrival_time) {
+                return a->arrival_time < b->arrival_time;
+            }
+            break;
+        case POLICY_SJF:
+            if (a->page_count != b->page_count) {
+                return a->page_count < b->page_count;
+            }
+            break;
+        case POLICY_PRIORITY:
+            if (a->priority != b->priority) {
+                return a->priority < b->priority;
+            }
+            break;
+        default:
+            break;
+    }
+    // Tie-breaker: First-Come, First-Served
+    return a->job_id < b->job_id;
+}
+
+// Returns 1 if `jobs` is already in `policy`'s dispatch order.
+static ALWAYS_INLINE int jobsInOrder(SchedPolicy policy, const PrintJob jobs[], int count) {
+    for (int i = 1; i < count; i++) {
+        if (jobBefore(policy, &jobs[i], &jobs[i - 1])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static ALWAYS_INLINE int heapEntryBefore(const JobHeap* heap, SchedPolicy policy,
+                                         int a, int b) {
+    return jobBefore(policy, &job_queue[heap->slots[a]], &job_queue[heap->slots[b]]);
+}
+
+static inline void heapSwap(JobHeap* heap, int a, int b) {
+    int tmp = heap->slots[a];
+    heap->slots[a] = heap->slots[b];
+    heap->slots[b] = tmp;
+    heap->pos[heap->slots[a]] = a;
+    heap->pos[heap->slots[b]] = b;
+}
+
+static ALWAYS_INLINE void heapSiftUpFor(JobHeap* heap, SchedPolicy policy, int k) {
+    while (k > 0) {
+        int parent = (k - 1) / 2;
+        if (!heapEntryBefore(heap, policy, k, parent)) {
+            break;
+        }
+        heapSwap(heap, k, parent);
+        k = parent;
+    }
+}
+
+static ALWAYS_INLINE void heapSiftDownFor(JobHeap* heap, SchedPolicy policy, int k) {
+    for (;;) {
+        int best = k;
+        int left = 2 * k + 1;
+        int right = left + 1;
+        if (left < heap->size && heapEntryBefore(heap, policy, left, best)) {
+            best = left;
+        }
+        if (right < heap->size && heapEntryBefore(heap, policy, right, best)) {
+            best = right;
+        }
+        if (best == k) {
+            break;
+        }
+        heapSwap(heap, k, best);
+        k = best;
+    }
+}
+
+// The sifts pick the heap's policy once, then run a loop specialised for
+// it, so a bulk heapify makes no policy decision per comparison.
+void heapSiftUp(JobHeap* heap, int k) {
+    switch (heap->policy) {
+        case POLICY_FCFS:
+            heapSiftUpFor(heap, POLICY_FCFS, k);
+            break;
+        case POLICY_SJF:
+            heapSiftUpFor(heap, POLICY_SJF, k);
+            break;
+        default:
+            heapSiftUpFor(heap, POLICY_PRIORITY, k);
+            break;
+    }
+}
+
+void heapSiftDown(JobHeap* heap, int k) {
+    switch (heap->policy) {
+        case POLICY_FCFS:
+            heapSiftDownFor(heap, POLICY_FCFS, k);
+            break;
+        case POLICY_SJF:
+            heapSiftDownFor(heap, POLICY_SJF, k);
+            break;
+        default:
+            heapSiftDownFor(heap, POLICY_PRIORITY, k);
+            break;
+    }
+}
+
+/**
+ * @brief Grows every scheduling heap so it can index `capacity` slots of
+ * job_queue. Called whenever job_queue itself grows.
+ *
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int reserveSchedulingHeaps(int capacity) {
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        JobHeap* heap = &sched_heaps[k];
+        if (capacity <= heap->capacity) {
+            continue;
+        }
+        int* slots = realloc(heap->slots, (size_t)capacity * sizeof(int));
+        if (slots == NULL) {
+            return 0;
+        }
+        heap->slots = slots;
+        int* pos = realloc(heap->pos, (size_t)capacity * sizeof(int));
+        if (pos == NULL) {
+            return 0;
+        }
+        heap->pos = pos;
+        heap->capacity = capacity;
+    }
+    return 1;
+}
+
+/**
+ * @brief Builds the scheduling heaps over the live queue if they are not
+ * already in sync with it. This is an O(n) bottom-up heapify; afterwards
+ * addJob() keeps the heaps current at O(log n) per job.
+ *
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int ensureSchedulingHeaps() {
+    if (heaps_ready) {
+        return 1;
+    }
+    if (!reserveSchedulingHeaps(job_capacity)) {
+        return 0;
+    }
+
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        JobHeap* heap = &sched_heaps[k];
+        heap->size = 0;
+        for (int i = 0; i < job_store_size; i++) {
+            if (!isDispatched(&job_queue[i])) {
+                heap->slots[heap->size] = i;
+                heap->pos[i] = heap->size;
+                heap->size++;
+            }
+        }
+        for (int h = heap->size / 2 - 1; h >= 0; h--) {
+            heapSiftDown(heap, h);
+        }
+    }
+
+    heaps_ready = 1;
+    return 1;
+}
+
+/**
+ * @brief Inserts job_queue[index] into a heap in O(log n).
+ */
+void heapPush(JobHeap* heap, int index) {
+    int k = heap->size++;
+    heap->slots[k] = index;
+    heap->pos[index] = k;
+    heapSiftUp(heap, k);
+}
+
+/**
+ * @brief Removes job_queue[index] from a heap in O(log n), using the
+ * position index to find it without a scan.
+ */
+void heapRemove(JobHeap* heap, int index) {
+    int k = heap->pos[index];
+    int last = --heap->size;
+    if (k != last) {
+        heapSwap(heap, k, last);
+        heapSiftDown(heap, k);
+        heapSiftUp(heap, k);
+    }
+}
+
+/**
+ * @brief Squeezes dispatched slots out of job_queue, keeping the
+ * remaining jobs in arrival order. Heap entries are renumbered in place,
+ * so the heaps stay valid without being rebuilt.
+ */
+void compactJobQueue() {
+    if (job_store_size == job_count) {
+        return;
+    }
+
+    compactQueueRuns();
+    int live = 0;
+    for (int i = 0; i < job_store_size; i++) {
+        if (isDispatched(&job_queue[i])) {
+            continue;
+        }
+        if (heaps_ready) {
+            for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+                JobHeap* heap = &sched_heaps[k];
+                int position = heap->pos[i];
+                heap->slots[position] = live;
+                heap->pos[live] = position;
+            }
+        }
+        if (index_ready) {
+            size_t slot = idSlot(&job_index, job_queue[i].job_id);
+            if (job_index.values[slot] == i) {
+                job_index.values[slot] = live;
+            }
+        }
+        job_queue[live++] = job_queue[i];
+    }
+    job_store_size = live;
+    queue_head = 0;
+}
+
+/**
+ * @brief Marks every structure derived from the live queue as stale
+ * after a bulk change to job_queue: the heaps are rebuilt on the next
+ * dispatch, the id index on the next lookup and the running metrics on
+ * the next query.
+ */
+void invalidateQueueIndexes() {
+    heaps_ready = 0;
+    index_ready = 0;
+    running_ready = 0;
+}
+
+// --- Job Index ---
+
+static inline size_t idHome(const IdMap* map, int id) {
+    return ((uint32_t)id * 2654435761u) & map->mask;
+}
+
+// The slot holding `id`, or the empty slot where it would go
+static size_t idSlot(const IdMap* map, int id) {
+    size_t slot = idHome(map, id);
+    while (map->ids[slot] != 0 && map->ids[slot] != id) {
+        slot = (slot + 1) & map->mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Empties `map`, sized so that `entries` ids fill at most half
+ * of it.
+ * @return 1 on success, 0 (map untouched) if out of memory.
+ */
+int idMapInit(IdMap* map, size_t entries) {
+    size_t size = 16;
+    while (size < 2 * entries) {
+        size <<= 1;
+    }
+    int* ids = calloc(size, sizeof(int));
+    int* values = malloc(size * sizeof(int));
+    if (ids == NULL || values == NULL) {
+        free(ids);
+        free(values);
+        return 0;
+    }
+    free(map->ids);
+    free(map->values);
+    map->ids = ids;
+    map->values = values;
+    map->mask = size - 1;
+    map->used = 0;
+    return 1;
+}
+
+void idMapFree(IdMap* map) {
+    free(map->ids);
+    free(map->values);
+    memset(map, 0, sizeof(*map));
+}
+
+/**
+ * @brief Indexes job_queue[index] under its id, doubling the map once it
+ * is half full. A repeated id keeps its first job and sets
+ * index_shadowed.
+ * @return 1 on success, 0 if out of memory.
+ */
+static int indexJob(int index) {
+    int id = job_queue[index].job_id;
+    if (2 * (job_index.used + 1) > job_index.mask + 1) {
+        IdMap grown = { NULL, NULL, 0, 0 };
+        if (!idMapInit(&grown, job_index.used + 1)) {
+            return 0;
+        }
+        for (size_t i = 0; i <= job_index.mask; i++) {
+            if (job_index.ids[i] != 0) {
+                size_t slot = idSlot(&grown, job_index.ids[i]);
+                grown.ids[slot] = job_index.ids[i];
+                grown.values[slot] = job_index.values[i];
+            }
+        }
+        grown.used = job_index.used;
+        idMapFree(&job_index);
+        job_index = grown;
+    }
+    size_t slot = idSlot(&job_index, id);
+    if (job_index.ids[slot] == id) {
+        index_shadowed = 1;
+        return 1;
+    }
+    job_index.ids[slot] = id;
+    job_index.values[slot] = index;
+    job_index.used++;
+    return 1;
+}
+
+/**
+ * @brief Drops `id` from job_index. The entries probed past its slot are
+ * shifted back over the hole, so lookups never meet a tombstone.
+ */
+static void unindexJob(int id) {
+    size_t hole = idSlot(&job_index, id);
+    if (job_index.ids[hole] == 0) {
+        return;
+    }
+    job_index.ids[hole] = 0;
+    job_index.used--;
+    for (size_t next = (hole + 1) & job_index.mask; job_index.ids[next] != 0;
+         next = (next + 1) & job_index.mask) {
+        // It may move back if the hole lies on its probe path
+        size_t home = idHome(&job_index, job_index.ids[next]);
+        if (((next - home) & job_index.mask) >= ((next - hole) & job_index.mask)) {
+            job_index.ids[hole] = job_index.ids[next];
+            job_index.values[hole] = job_index.values[next];
+            job_index.ids[next] = 0;
+            hole = next;
+        }
+    }
+}
+
+/**
+ * @brief Builds job_index over the live queue if it is not in sync with
+ * it. Like the heaps, it is rebuilt in O(n) after bulk loads, on the
+ * first lookup; storeJob(), removals and compaction then keep it current
+ * at O(1) per job.
+ * @return 1 on success, 0 if out of memory.
+ */
+int ensureJobIndex() {
+    if (index_ready) {
+        return 1;
+    }
+    if (!idMapInit(&job_index, (size_t)job_count)) {
+        return 0;
+    }
+    index_shadowed = 0;
+    for (int i = 0; i < job_store_size; i++) {
+        if (!isDispatched(&job_queue[i]) && !indexJob(i)) {
+            return 0;
+        }
+    }
+    index_ready = 1;
+    return 1;
+}
+
+/**
+ * @brief Finds the live job with `job_id` in O(1).
+ * @return Its slot in job_queue, -1 if no such job is queued, or -2 if
+ * the index could not be built.
+ */
+int findJob(int job_id) {
+    if (job_id <= 0 || job_count == 0) {
+        return -1;
+    }
+    if (!ensureJobIndex()) {
+        return -2;
+    }
+    size_t slot = idSlot(&job_index, job_id);
+    return (job_index.ids[slot] == job_id) ? job_index.values[slot] : -1;
+}
+
+// --- Live Queue Snapshots ---
+
+// Counter entry of a job's priority: its class, or 0 for any other
+static inline int queueClass(int priority) {
+    return (priority >= 1 && priority <= PRIORITY_CLASSES) ? priority : 0;
+}
+
+/**
+ * @brief Adds `delta` to queue_counters as one update of the sequence
+ * lock. Scheduler thread only: with a single writer the update is a few
+ * relaxed stores between two stores of the sequence, and never waits.
+ */
+static void publishQueueDelta(const QueueView* delta) {
+    QueueCounters* c = &queue_counters;
+    unsigned long long sequence = atomic_load_explicit(&c->sequence, memory_order_relaxed);
+    atomic_store_explicit(&c->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // Odd before any field changes
+
+    atomic_store_explicit(&c->depth, atomic_load_explicit(&c->depth, memory_order_relaxed) +
+                          delta->depth, memory_order_relaxed);
+    atomic_store_explicit(&c->pages, atomic_load_explicit(&c->pages, memory_order_relaxed) +
+                          delta->pages, memory_order_relaxed);
+    for (int k = 0; k <= PRIORITY_CLASSES; k++) {
+        if (delta->class_depth[k] != 0 || delta->class_pages[k] != 0) {
+            atomic_store_explicit(&c->class_depth[k],
+                                  atomic_load_explicit(&c->class_depth[k], memory_order_relaxed) +
+                                  delta->class_depth[k], memory_order_relaxed);
+            atomic_store_explicit(&c->class_pages[k],
+                                  atomic_load_explicit(&c->class_pages[k], memory_order_relaxed) +
+                                  delta->class_pages[k], memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&c->added, atomic_load_explicit(&c->added, memory_order_relaxed) +
+                          delta->added, memory_order_relaxed);
+    atomic_store_explicit(&c->removed, atomic_load_explicit(&c->removed, memory_order_relaxed) +
+                          delta->removed, memory_order_relaxed);
+
+    atomic_store_explicit(&c->sequence, sequence + 2, memory_order_release);
+}
+
+// Publishes the gathered changes to the counters, if there are any
+static void flushQueueCounters() {
+    if (queue_pending_changes > 0) {
+        publishQueueDelta(&queue_pending);
+        memset(&queue_pending, 0, sizeof(queue_pending));
+        queue_pending_changes = 0;
+    }
+}
+
+/**
+ * @brief Lets a batch of queue changes (a ring drain, a SUBMIT) gather
+ * in queue_pending and be published as one update by
+ * publishQueueCounters(), instead of one per job. Readers then see the
+ * queue as it was before or after the batch, never part-way.
+ */
+static void deferQueueCounters() {
+    queue_deferred = 1;
+}
+
+static void publishQueueCounters() {
+    queue_deferred = 0;
+    flushQueueCounters();
+}
+
+// Counts `count` jobs into (sign 1) or out of (sign -1) the live queue
+static void countQueueJobs(const PrintJob jobs[], int count, int sign) {
+    QueueView* delta = &queue_pending;
+    for (int i = 0; i < count; i++) {
+        int k = queueClass(jobs[i].priority);
+        delta->class_depth[k] += sign;
+        delta->class_pages[k] += sign * (long long)jobs[i].page_count;
+        delta->pages += sign * (long long)jobs[i].page_count;
+    }
+    delta->depth += sign * count;
+    if (sign > 0) {
+        delta->added += count;
+    } else {
+        delta->removed += count;
+    }
+    queue_pending_changes++;
+    if (!queue_deferred) {
+        flushQueueCounters();
+    }
+}
+
+// Moves a queued job of `pages` pages between priority classes
+static void countQueueReprioritized(int pages, int from, int to) {
+    QueueView* delta = &queue_pending;
+    delta->class_depth[queueClass(from)]--;
+    delta->class_pages[queueClass(from)] -= pages;
+    delta->class_depth[queueClass(to)]++;
+    delta->class_pages[queueClass(to)] += pages;
+    queue_pending_changes++;
+    if (!queue_deferred) {
+        flushQueueCounters();
+    }
+}
+
+/**
+ * @brief Takes a consistent reading of the live queue counters. Safe on
+ * any thread and lock-free: it retries only while the scheduler thread
+ * is mid-update, which is a handful of stores.
+ */
+void readQueueCounters(QueueView* view) {
+    const QueueCounters* c = &queue_counters;
+    for (;;) {
+        unsigned long long before = atomic_load_explicit(&c->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        view->depth = atomic_load_explicit(&c->depth, memory_order_relaxed);
+        view->pages = atomic_load_explicit(&c->pages, memory_order_relaxed);
+        for (int k = 0; k <= PRIORITY_CLASSES; k++) {
+            view->class_depth[k] = atomic_load_explicit(&c->class_depth[k], memory_order_relaxed);
+            view->class_pages[k] = atomic_load_explicit(&c->class_pages[k], memory_order_relaxed);
+        }
+        view->added = atomic_load_explicit(&c->added, memory_order_relaxed);
+        view->removed = atomic_load_explicit(&c->removed, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire); // The fields before the recheck
+        if (atomic_load_explicit(&c->sequence, memory_order_relaxed) == before) {
+            view->epoch = before / 2;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Copies the live jobs from slot `*slot` on, in queue order, into
+ * `page` until it holds `limit`, and leaves `*slot` past the last one.
+ * @return The number of jobs copied.
+ */
+static int copyQueuePage(int* slot, PrintJob page[], int limit) {
+    int copied = 0;
+    int i = *slot;
+    for (; i < job_store_size && copied < limit; i++) {
+        if (!isDispatched(&job_queue[i])) {
+            page[copied++] = job_queue[i];
+        }
+    }
+    *slot = i;
+    return copied;
+}
+
+// The first slot at or after `slot` holding a live job, or job_store_size
+static int nextLiveSlot(int slot) {
+    while (slot < job_store_size && isDispatched(&job_queue[slot])) {
+        slot++;
+    }
+    return slot;
+}
+
+// The run holding job_queue[slot]; queue_run_count must be positive
+static int queueRunOf(int slot) {
+    int lo = 0;
+    int hi = queue_run_count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (queue_runs[mid].slot <= slot) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// The queue position of job_queue[slot]
+static long long slotPosition(int slot) {
+    if (queue_run_count == 0) {
+        return queue_position_base + slot;
+    }
+    const QueueRun* run = &queue_runs[queueRunOf(slot)];
+    return run->position + (slot - run->slot);
+}
+
+// The first slot whose queue position is `position` or later
+static int positionSlot(long long position) {
+    long long slot = position - queue_position_base;
+    if (slot < 0) {
+        slot = 0;
+    }
+    if (queue_run_count > 0) {
+        int lo = 0;
+        int hi = queue_run_count - 1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo + 1) / 2;
+            if (queue_runs[mid].position <= position) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        const QueueRun* run = &queue_runs[lo];
+        if (position < run->position) {
+            return run->slot; // Before the first run
+        }
+        slot = run->slot + (position - run->position);
+        if (lo + 1 < queue_run_count && slot > queue_runs[lo + 1].slot) {
+            slot = queue_runs[lo + 1].slot; // Inside a gap compaction left
+        }
+    }
+    return (slot < job_store_size) ? (int)slot : job_store_size;
+}
+
+// Appends a run to queue_runs_spare; 0 if out of memory
+static int pushQueueRun(int* count, int slot, long long position) {
+    if (*count == queue_runs_spare_capacity) {
+        int capacity = queue_runs_spare_capacity > 0 ? 2 * queue_runs_spare_capacity : 16;
+        QueueRun* grown = realloc(queue_runs_spare, (size_t)capacity * sizeof(QueueRun));
+        if (grown == NULL) {
+            return 0;
+        }
+        queue_runs_spare = grown;
+        queue_runs_spare_capacity = capacity;
+    }
+    queue_runs_spare[*count] = (QueueRun){ slot, position };
+    (*count)++;
+    return 1;
+}
+
+/**
+ * @brief Works out the queue runs for the compaction of job_queue about
+ * to happen, so every job that stays keeps its queue position and a
+ * QUEUE cursor neither skips nor repeats jobs across the compaction.
+ * A run begins wherever compacted-away slots leave a gap in positions,
+ * so under FCFS dispatch there is none beyond the first, which is kept
+ * as queue_position_base. If the runs cannot be allocated, positions
+ * restart so that the last job keeps its own: every job then moves to
+ * the same or a later position, so a cursor may repeat jobs but never
+ * skips one.
+ */
+static void compactQueueRuns() {
+    int count = 0;
+    int run = 0;
+    int live = 0;
+    long long last = 0;
+    int ok = 1;
+    for (int i = 0; i <= job_store_size && ok; i++) {
+        if (i < job_store_size && isDispatched(&job_queue[i])) {
+            continue;
+        }
+        // Walk the old runs alongside: slots only move forward
+        while (run + 1 < queue_run_count && queue_runs[run + 1].slot <= i) {
+            run++;
+        }
+        long long position = (queue_run_count == 0) ? queue_position_base + i :
+                             queue_runs[run].position + (i - queue_runs[run].slot);
+        // The tail (i == job_store_size) is where the next job will go
+        if (count == 0 || position != last + 1) {
+            ok = pushQueueRun(&count, live, position);
+        }
+        last = position;
+        live++;
+    }
+    if (!ok) {
+        queue_position_base = slotPosition(job_store_size) - job_count;
+        queue_run_count = 0;
+        return;
+    }
+    if (count == 1) {
+        queue_position_base = queue_runs_spare[0].position; // Its slot is 0
+        count = 0;
+    }
+    QueueRun* runs = queue_runs;
+    int capacity = queue_run_capacity;
+    queue_runs = queue_runs_spare;
+    queue_run_capacity = queue_runs_spare_capacity;
+    queue_run_count = count;
+    queue_runs_spare = runs;
+    queue_runs_spare_capacity = capacity;
+}
+
+/**
+ * @brief Copies one page of the live queue, in queue order, with the
+ * counters it matches. Runs on the scheduler thread, between updates,
+ * so the page and the counters are one consistent view; the cost is the
+ * page, not the queue. Dispatched slots at the head are skipped once
+ * and remembered in queue_head, so under FCFS dispatch the first page
+ * stays O(limit) however many jobs have gone.
+ *
+ * Pages are addressed by queue position (see queue_runs), not by job:
+ * a job keeps its position from the moment it is stored until it
+ * leaves, so a cursor stays valid while the jobs before it, or the job
+ * it follows, are dispatched or cancelled, and compaction moves no job
+ * across it.
+ *
+ * @param from Start at the first queued job at or after this position
+ * (the previous page's cursor), or 0 to start at the head.
+ * @param page Output: room for `limit` jobs.
+ * @param next Output: the cursor for the following page, or 0 if no
+ * jobs follow this one.
+ * @param view Output: the counters, whose epoch tells a client paging
+ * through the queue whether it changed between pages.
+ * @return The number of jobs copied.
+ */
+int snapshotQueue(long long from, PrintJob page[], int limit, long long* next,
+                  QueueView* view) {
+    queue_head = nextLiveSlot(queue_head);
+    int slot = queue_head;
+    if (from > 0) {
+        int wanted = positionSlot(from);
+        if (wanted > slot) {
+            slot = wanted;
+        }
+    }
+    int copied = copyQueuePage(&slot, page, limit);
+    slot = nextLiveSlot(slot);
+    *next = (slot < job_store_size) ? slotPosition(slot) : 0;
+    readQueueCounters(view);
+    return copied;
+}
+
+// Writes the jobs in `page` as displayQueue() rows into `out`
+static char* formatQueueRows(char* out, const PrintJob page[], int count) {
+    for (int i = 0; i < count; i++) {
+        out = formatPadded(out, page[i].job_id, 6);
+        memcpy(out, " | ", 3);
+        out = formatPadded(out + 3, page[i].page_count, 10);
+        memcpy(out, " | ", 3);
+        out = formatPadded(out + 3, page[i].priority, 8);
+        memcpy(out, " | ", 3);
+        out = formatPadded(out + 3, page[i].arrival_time, 7);
+        *out++ = '\n';
+    }
+    return out;
+}
+
+// --- Running Backlog Metrics ---
+
+// Grows `tree` to cover keys up to `key` by doubling. The old nodes
+// keep their ranges; the new top node covers everything, so it takes
+// the old root's total and the nodes in between start empty.
+static int fenwickReserve(PageFenwick* tree, int key) {
+    if (key <= tree->size) {
+        return 1;
+    }
+    if (key > RUNNING_KEY_LIMIT) {
+        return 0;
+    }
+    int size = tree->size > 0 ? tree->size : 64;
+    while (size < key) {
+        size *= 2;
+    }
+    long long* count = realloc(tree->count, ((size_t)size + 1) * sizeof(long long));
+    if (count == NULL) {
+        return 0;
+    }
+    tree->count = count;
+    long long* pages = realloc(tree->pages, ((size_t)size + 1) * sizeof(long long));
+    if (pages == NULL) {
+        return 0;
+    }
+    tree->pages = pages;
+
+    int old = tree->size;
+    memset(count + old + 1, 0, (size_t)(size - old) * sizeof(long long));
+    memset(pages + old + 1, 0, (size_t)(size - old) * sizeof(long long));
+    for (int root = old; root > 0 && root < size; root *= 2) {
+        count[2 * root] = count[root];
+        pages[2 * root] = pages[root];
+    }
+    tree->size = size;
+    return 1;
+}
+
+static void fenwickAdd(PageFenwick* tree, int key, long long count, long long pages) {
+    for (int i = key; i <= tree->size; i += i & -i) {
+        tree->count[i] += count;
+        tree->pages[i] += pages;
+    }
+}
+
+// Jobs with a key of at most `key`, and their pages
+static void fenwickPrefix(const PageFenwick* tree, int key, long long* count,
+                          long long* pages) {
+    *count = 0;
+    *pages = 0;
+    if (key > tree->size) {
+        key = tree->size;
+    }
+    for (int i = key; i > 0; i -= i & -i) {
+        *count += tree->count[i];
+        *pages += tree->pages[i];
+    }
+}
+
+// Wait a job adds to (or, once removed, takes from) the SJF total: for
+// every pair of jobs the shorter one prints first, so each other job
+// contributes min(its pages, this job's pages).
+static long long sjfPairWait(const RunningMetrics* m, int pages) {
+    long long shorter_count, shorter_pages;
+    fenwickPrefix(&m->by_pages, pages, &shorter_count, &shorter_pages);
+    return shorter_pages + (long long)pages * (m->jobs - shorter_count);
+}
+
+// Sort key of `job` in the FCFS or Priority order: that policy's field,
+// then the id, as jobBefore() breaks ties. Its pages come last, so jobs
+// with equal keys (ids may repeat in a trace) are interchangeable.
+static inline void orderKey(SchedPolicy policy, const PrintJob* job, int key[3]) {
+    key[0] = (policy == POLICY_FCFS) ? job->arrival_time : job->priority;
+    key[1] = job->job_id;
+    key[2] = job->page_count;
+}
+
+static inline int orderKeyCompare(const int a[3], const int b[3]) {
+    for (int i = 0; i < 3; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Heap order of the treap: a fixed pseudo-random weight per slot,
+// heavier nodes on top
+static inline uint32_t orderWeight(int node) {
+    uint64_t state = (uint64_t)node;
+    return (uint32_t)splitmix64(&state);
+}
+
+// Makes room for `extra` more nodes, setting up nodes[0] on first use
+static int orderReserve(OrderTree* tree, int extra) {
+    if (tree->used == 0) {
+        extra++;
+    }
+    if ((long long)tree->used + extra <= tree->capacity) {
+        return 1;
+    }
+    long long capacity = tree->capacity > 0 ? tree->capacity : 64;
+    while (capacity < (long long)tree->used + extra) {
+        capacity *= 2;
+    }
+    if (capacity > INT_MAX) {
+        return 0;
+    }
+    OrderNode* nodes = realloc(tree->nodes, (size_t)capacity * sizeof(OrderNode));
+    if (nodes == NULL) {
+        return 0;
+    }
+    tree->nodes = nodes;
+    tree->capacity = (int)capacity;
+    if (tree->used == 0) {
+        memset(&nodes[0], 0, sizeof(OrderNode));
+        tree->used = 1;
+    }
+    return 1;
+}
+
+// Recomputes a node's subtree totals from its children's
+static inline void orderUpdate(OrderTree* tree, int t) {
+    OrderNode* node = &tree->nodes[t];
+    const OrderNode* left = &tree->nodes[node->left];
+    const OrderNode* right = &tree->nodes[node->right];
+    node->count = 1 + left->count + right->count;
+    node->pages = node->key[2] + left->pages + right->pages;
+}
+
+// Splits subtree `t` into the keys up to `key` and those after it
+static void orderSplit(OrderTree* tree, int t, const int key[3], int* low, int* high) {
+    if (t == 0) {
+        *low = *high = 0;
+        return;
+    }
+    OrderNode* node = &tree->nodes[t];
+    if (orderKeyCompare(node->key, key) <= 0) {
+        orderSplit(tree, node->right, key, &node->right, high);
+        *low = t;
+    } else {
+        orderSplit(tree, node->left, key, low, &node->left);
+        *high = t;
+    }
+    orderUpdate(tree, t);
+}
+
+// Joins two subtrees, every key in `a` sorting no later than those in `b`
+static int orderMerge(OrderTree* tree, int a, int b) {
+    if (a == 0 || b == 0) {
+        return a != 0 ? a : b;
+    }
+    if (orderWeight(a) > orderWeight(b)) {
+        tree->nodes[a].right = orderMerge(tree, tree->nodes[a].right, b);
+        orderUpdate(tree, a);
+        return a;
+    }
+    tree->nodes[b].left = orderMerge(tree, a, tree->nodes[b].left);
+    orderUpdate(tree, b);
+    return b;
+}
+
+// Adds `job` to `tree`, after any job with an equal key
+static int orderInsert(OrderTree* tree, SchedPolicy policy, const PrintJob* job) {
+    if (!orderReserve(tree, 1)) {
+        return 0;
+    }
+    int n = tree->free_list;
+    if (n != 0) {
+        tree->free_list = tree->nodes[n].left;
+    } else {
+        n = tree->used++;
+    }
+    OrderNode* node = &tree->nodes[n];
+    orderKey(policy, job, node->key);
+    node->left = node->right = 0;
+    orderUpdate(tree, n);
+
+    int low, high;
+    orderSplit(tree, tree->root, node->key, &low, &high);
+    tree->root = orderMerge(tree, orderMerge(tree, low, n), high);
+    return 1;
+}
+
+// Takes one job with `key` out of subtree `t` and returns the subtree
+static int orderErase(OrderTree* tree, int t, const int key[3], int* found) {
+    if (t == 0) {
+        return 0;
+    }
+    OrderNode* node = &tree->nodes[t];
+    int side = orderKeyCompare(key, node->key);
+    if (side == 0) {
+        int rest = orderMerge(tree, node->left, node->right);
+        node->left = tree->free_list;
+        tree->free_list = t;
+        *found = 1;
+        return rest;
+    }
+    if (side < 0) {
+        node->left = orderErase(tree, node->left, key, found);
+    } else {
+        node->right = orderErase(tree, node->right, key, found);
+    }
+    orderUpdate(tree, t);
+    return t;
+}
+
+// Removes `job` from `tree`; 0 if it was not there
+static int orderRemove(OrderTree* tree, SchedPolicy policy, const PrintJob* job) {
+    int key[3];
+    int found = 0;
+    orderKey(policy, job, key);
+    tree->root = orderErase(tree, tree->root, key, &found);
+    return found;
+}
+
+// Wait `job` adds to (or, once removed, takes from) the total of the
+// order `tree` holds without it: the pages ahead of it, then its own
+// pages once for every job behind it. Jobs with an equal key count as
+// ahead, which is where orderInsert() puts it.
+static long long orderPairWait(const OrderTree* tree, SchedPolicy policy,
+                               const PrintJob* job) {
+    int key[3];
+    orderKey(policy, job, key);
+    long long ahead_count = 0;
+    long long ahead_pages = 0;
+    for (int t = tree->root; t != 0;) {
+        const OrderNode* node = &tree->nodes[t];
+        if (orderKeyCompare(node->key, key) <= 0) {
+            ahead_count += tree->nodes[node->left].count + 1;
+            ahead_pages += tree->nodes[node->left].pages + node->key[2];
+            t = node->right;
+        } else {
+            t = node->left;
+        }
+    }
+    long long behind = (tree->root != 0 ? tree->nodes[tree->root].count : 0) - ahead_count;
+    return ahead_pages + (long long)job->page_count * behind;
+}
+
+/**
+ * @brief Rebuilds `tree` from jobs already in its order, in O(n): each
+ * job joins the right spine of the tree built so far, under the
+ * lighter nodes it displaces, and a node's totals are final once it
+ * leaves the spine.
+ * @return 1 on success, 0 if out of memory.
+ */
+static int orderBuild(OrderTree* tree, SchedPolicy policy, const PrintJob order[],
+                      int count) {
+    tree->root = 0;
+    tree->free_list = 0;
+    if (tree->used > 1) {
+        tree->used = 1;
+    }
+    int* spine = malloc(((size_t)count + 1) * sizeof(int));
+    if (spine == NULL || !orderReserve(tree, count)) {
+        free(spine);
+        return 0;
+    }
+    int depth = 0;
+    for (int i = 0; i < count; i++) {
+        int n = tree->used++;
+        OrderNode* node = &tree->nodes[n];
+        orderKey(policy, &order[i], node->key);
+        node->right = 0;
+        int last = 0;
+        while (depth > 0 && orderWeight(spine[depth - 1]) < orderWeight(n)) {
+            last = spine[--depth];
+            orderUpdate(tree, last);
+        }
+        node->left = last;
+        if (depth > 0) {
+            tree->nodes[spine[depth - 1]].right = n;
+        } else {
+            tree->root = n;
+        }
+        spine[depth++] = n;
+    }
+    while (depth > 0) {
+        orderUpdate(tree, spine[--depth]);
+    }
+    free(spine);
+    return 1;
+}
+
+// Sorts runs of jobs with equal FCFS or Priority keys but for their
+// pages, which only repeated ids produce, the way OrderTree orders them
+static void orderTwins(SchedPolicy policy, PrintJob order[], int count) {
+    for (int i = 1; i < count; i++) {
+        int a[3], b[3];
+        for (int j = i; j > 0; j--) {
+            orderKey(policy, &order[j - 1], a);
+            orderKey(policy, &order[j], b);
+            if (a[0] != b[0] || a[1] != b[1] || a[2] <= b[2]) {
+                break;
+            }
+            PrintJob swap = order[j - 1];
+            order[j - 1] = order[j];
+            order[j] = swap;
+        }
+    }
+}
+
+// Sum of every job's wait with the jobs printed back to back in `order`
+static long long backlogWait(const PrintJob order[], int count) {
+    long long ahead = 0;
+    long long total = 0;
+    for (int i = 0; i < count; i++) {
+        total += ahead;
+        ahead += order[i].page_count;
+    }
+    return total;
+}
+
+/**
+ * @brief Rebuilds running_metrics from the live queue if it is stale,
+ * like ensureSchedulingHeaps(): bulk loads only clear running_ready,
+ * and the O(n log n) rebuild happens on the next query. The trees are
+ * filled in O(n + keys) rather than job by job.
+ * @return 1 if running_metrics is valid, 0 if out of memory or a key
+ * exceeds RUNNING_KEY_LIMIT.
+ */
+int ensureRunningMetrics() {
+    if (running_ready) {
+        return 1;
+    }
+    RunningMetrics* m = &running_metrics;
+    compactJobQueue();
+
+    int max_pages = 1;
+    m->total_pages = 0;
+    memset(m->total_wait, 0, sizeof(m->total_wait));
+    for (int i = 0; i < job_count; i++) {
+        const PrintJob* job = &job_queue[i];
+        max_pages = job->page_count > max_pages ? job->page_count : max_pages;
+        m->total_pages += job->page_count;
+    }
+    PrintJob* order = getScratchQueue(job_count);
+    if ((order == NULL && job_count > 0) || !fenwickReserve(&m->by_pages, max_pages)) {
+        return 0;
+    }
+
+    // Every order is rebuilt, even an empty one, to clear the old trees
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        if (job_count > 0) {
+            memcpy(order, job_queue, (size_t)job_count * sizeof(PrintJob));
+            if (k != POLICY_FCFS) {
+                sortForPolicy(order, job_count, (SchedPolicy)k);
+            } else if (!jobsInOrder(POLICY_FCFS, order, job_count)) {
+                sortJobsByArrival(order, job_count);
+            }
+        }
+        if (k != POLICY_SJF) {
+            OrderTree* tree = (k == POLICY_FCFS) ? &m->by_arrival : &m->by_priority;
+            orderTwins((SchedPolicy)k, order, job_count);
+            if (!orderBuild(tree, (SchedPolicy)k, order, job_count)) {
+                return 0;
+            }
+        }
+        m->total_wait[k] = backlogWait(order, job_count);
+    }
+
+    // Point counts first, then each node passes its total to its parent
+    PageFenwick* tree = &m->by_pages;
+    memset(tree->count, 0, ((size_t)tree->size + 1) * sizeof(long long));
+    memset(tree->pages, 0, ((size_t)tree->size + 1) * sizeof(long long));
+    for (int i = 0; i < job_count; i++) {
+        const PrintJob* job = &job_queue[i];
+        tree->count[job->page_count]++;
+        tree->pages[job->page_count] += job->page_count;
+    }
+    for (int i = 1; i <= tree->size; i++) {
+        int parent = i + (i & -i);
+        if (parent <= tree->size) {
+            tree->count[parent] += tree->count[i];
+            tree->pages[parent] += tree->pages[i];
+        }
+    }
+    m->jobs = job_count;
+    running_ready = 1;
+    return 1;
+}
+
+/**
+ * @brief Accounts for a job just added to the live queue, wherever it
+ * lands in each order: SJF costs O(log keys), FCFS and Priority
+ * expected O(log n). Out of memory marks the totals stale instead.
+ */
+void runningMetricsAdd(const PrintJob* job) {
+    RunningMetrics* m = &running_metrics;
+    if (!fenwickReserve(&m->by_pages, job->page_count)) {
+        running_ready = 0;
+        return;
+    }
+
+    // It waits for the pages ahead of it and delays the jobs behind it
+    m->total_wait[POLICY_FCFS] += orderPairWait(&m->by_arrival, POLICY_FCFS, job);
+    m->total_wait[POLICY_SJF] += sjfPairWait(m, job->page_count);
+    m->total_wait[POLICY_PRIORITY] += orderPairWait(&m->by_priority, POLICY_PRIORITY, job);
+
+    if (!orderInsert(&m->by_arrival, POLICY_FCFS, job) ||
+        !orderInsert(&m->by_priority, POLICY_PRIORITY, job)) {
+        running_ready = 0;
+        return;
+    }
+    fenwickAdd(&m->by_pages, job->page_count, 1, job->page_count);
+    m->total_pages += job->page_count;
+    m->jobs++;
+}
+
+/**
+ * @brief Accounts for a job just dispatched or cancelled, from any
+ * place in any order, in the same time as runningMetricsAdd().
+ */
+void runningMetricsRemove(const PrintJob* job) {
+    RunningMetrics* m = &running_metrics;
+    if (!orderRemove(&m->by_arrival, POLICY_FCFS, job) ||
+        !orderRemove(&m->by_priority, POLICY_PRIORITY, job)) {
+        running_ready = 0; // Not found: rebuilt from the queue instead
+        return;
+    }
+    fenwickAdd(&m->by_pages, job->page_count, -1, -job->page_count);
+    m->jobs--;
+    m->total_pages -= job->page_count;
+
+    m->total_wait[POLICY_FCFS] -= orderPairWait(&m->by_arrival, POLICY_FCFS, job);
+    m->total_wait[POLICY_SJF] -= sjfPairWait(m, job->page_count);
+    m->total_wait[POLICY_PRIORITY] -= orderPairWait(&m->by_priority, POLICY_PRIORITY, job);
+}
+
+/**
+ * @brief Accounts for a queued job about to move from its priority to
+ * `priority`: it leaves the Priority order at its old key and rejoins
+ * at the new one, in expected O(log n). FCFS and SJF do not depend on
+ * priority.
+ */
+void runningMetricsReprioritize(const PrintJob* job, int priority) {
+    RunningMetrics* m = &running_metrics;
+    PrintJob moved = *job;
+    moved.priority = priority;
+    if (!orderRemove(&m->by_priority, POLICY_PRIORITY, job)) {
+        running_ready = 0;
+        return;
+    }
+    m->total_wait[POLICY_PRIORITY] -= orderPairWait(&m->by_priority, POLICY_PRIORITY, job);
+    m->total_wait[POLICY_PRIORITY] += orderPairWait(&m->by_priority, POLICY_PRIORITY, &moved);
+    if (!orderInsert(&m->by_priority, POLICY_PRIORITY, &moved)) {
+        running_ready = 0;
+    }
+}
+
+/**
+ * @brief Average wait and turnaround if one printer drained the live
+ * queue now, in the order `policy` dispatches it. O(1) while the totals
+ * are current.
+ * @return 1 on success, 0 if the totals cannot be built.
+ */
+int runningAverages(SchedPolicy policy, double* avg_wait, double* avg_turnaround) {
+    if (policy >= ONLINE_POLICY_COUNT || !ensureRunningMetrics()) {
+        return 0;
+    }
+    const RunningMetrics* m = &running_metrics;
+    *avg_wait = m->jobs > 0 ? (double)m->total_wait[policy] / m->jobs : 0.0;
+    *avg_turnaround = m->jobs > 0
+        ? (double)(m->total_wait[policy] + m->total_pages) / m->jobs : 0.0;
+    return 1;
+}
+
+void freeRunningMetrics() {
+    free(running_metrics.by_pages.count);
+    free(running_metrics.by_pages.pages);
+    free(running_metrics.by_arrival.nodes);
+    free(running_metrics.by_priority.nodes);
+    memset(&running_metrics, 0, sizeof(running_metrics));
+    running_ready = 0;
+}
+
+// --- Trace File Ingestion ---
+
+// Parses an unsigned decimal field starting at *cursor, skipping
+// surrounding blanks. Returns 1 and advances *cursor past the field on
+// success, 0 if the field is missing, malformed or overflows an int.
+static inline int parseTraceField(const char** cursor, const char* end, int* value) {
+    const char* p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return 0;
+    }
+
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        if (v > INT_MAX) {
+            return 0;
+        }
+        p++;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    *value = (int)v;
+    *cursor = p;
+    return 1;
+}
+
+/**
+ * @brief Parses one trace line (without its newline) into `job`.
+ * @return 1 if a job was read, 0 if the line is blank or a comment,
+ * -1 if the line is malformed.
+ */
+int parseTraceLine(const char* line, const char* end, PrintJob* job) {
+    if (end > line && end[-1] == '\r') {
+        end--; // Tolerate CRLF line endings
+    }
+    const char* p = line;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p == end || *p == '#') {
+        return 0;
+    }
+
+    int fields[4];
+    int n = 0;
+    for (;;) {
+        if (!parseTraceField(&p, end, &fields[n])) {
+            return -1;
+        }
+        n++;
+        if (p == end) {
+            break;
+        }
+        if (*p != ',' || n == 4) {
+            return -1;
+        }
+        p++;
+    }
+    if (n < 3) {
+        return -1;
+    }
+
+    job->job_id = fields[0];
+    job->page_count = fields[1];
+    job->priority = fields[2];
+    job->arrival_time = (n == 4) ? fields[3] : 0;
+    if (job->job_id <= 0 || job->page_count <= 0 || job->priority <= 0) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Loads a CSV trace of `job_id,page_count,priority[,arrival]`
+ * lines and appends the jobs to job_queue. A header line, blank lines
+ * and lines starting with '#' are skipped.
+ *
+ * The file is read in large chunks and parsed in place with a
+ * hand-rolled integer parser, so there is no per-field scanf and no
+ * per-line allocation. Only a line split across two chunks is moved.
+ *
+ * @param path The trace file to read.
+ * @return The number of jobs loaded, or -1 on error (in which case the
+ * queue is left as it was).
+ */
+int loadTraceFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open trace file '%s'.\n", path);
+        return -1;
+    }
+
+    char* buffer = malloc(TRACE_READ_CHUNK);
+    if (buffer == NULL) {
+        fclose(file);
+        fprintf(stderr, "Error: Out of memory while loading trace.\n");
+        return -1;
+    }
+
+    compactJobQueue();
+    int first_new = job_store_size;
+    long long line_number = 0;
+    int max_id = next_job_id - 1;
+    int status = 0;
+    size_t pending = 0; // Bytes of an unfinished line kept at the front
+
+    for (;;) {
+        size_t got = fread(buffer + pending, 1, TRACE_READ_CHUNK - pending, file);
+        size_t filled = pending + got;
+        int at_eof = (got == 0);
+        if (filled == 0) {
+            break;
+        }
+
+        const char* p = buffer;
+        const char* end = buffer + filled;
+        for (;;) {
+            const char* newline = memchr(p, '\n', (size_t)(end - p));
+            if (newline == NULL) {
+                if (!at_eof) {
+                    break; // Finish this line after the next read
+                }
+                newline = end;
+            }
+
+            line_number++;
+            PrintJob job;
+            int parsed = parseTraceLine(p, newline, &job);
+            if (parsed < 0 && line_number == 1 &&
+                ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))) {
+                parsed = 0; // Column header
+            }
+            if (parsed < 0) {
+                fprintf(stderr, "Error: %s:%lld: malformed trace line.\n",
+                        path, line_number);
+                status = -1;
+                break;
+            }
+            if (parsed > 0) {
+                if (job_store_size == INT_MAX ||
+                    !reserveJobs(&job_queue, &job_capacity, job_store_size + 1)) {
+                    fprintf(stderr, "Error: Out of memory while loading trace.\n");
+                    status = -1;
+                    break;
+                }
+                job_queue[job_store_size++] = job;
+                if (job.job_id > max_id) {
+                    max_id = job.job_id;
+                }
+            }
+
+            p = newline + 1;
+            if (newline == end) {
+                break;
+            }
+        }
+        if (status < 0 || at_eof) {
+            break;
+        }
+
+        pending = (size_t)(end - p);
+        if (pending == TRACE_READ_CHUNK) {
+            fprintf(stderr, "Error: %s:%lld: trace line too long.\n",
+                    path, line_number + 1);
+            status = -1;
+            break;
+        }
+        memmove(buffer, p, pending);
+    }
+
+    if (status == 0 && ferror(file)) {
+        fprintf(stderr, "Error: Failed reading trace file '%s'.\n", path);
+        status = -1;
+    }
+    free(buffer);
+    fclose(file);
+
+    if (status < 0) {
+        job_store_size = first_new; // Drop the partially loaded trace
+        return -1;
+    }
+
+    int loaded = job_store_size - first_new;
+    job_count += loaded;
+    countQueueJobs(&job_queue[first_new], loaded, 1);
+    counterMax(hotCounters(), job_count);
+    if (max_id < INT_MAX) {
+        next_job_id = max_id + 1;
+    }
+    invalidateQueueIndexes();
+    return loaded;
+}
+
+/**
+ * @brief Appends a block of already validated jobs to job_queue.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int appendJobs(const PrintJob jobs[], int count) {
+    if (count == 0) {
+        return 1; // Nothing to copy; job_queue may not exist yet
+    }
+    compactJobQueue();
+    if (count > INT_MAX - job_store_size ||
+        !reserveJobs(&job_queue, &job_capacity, job_store_size + count)) {
+        return 0;
+    }
+    memcpy(&job_queue[job_store_size], jobs, (size_t)count * sizeof(PrintJob));
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].job_id >= next_job_id && jobs[i].job_id < INT_MAX) {
+            next_job_id = jobs[i].job_id + 1;
+        }
+    }
+    job_store_size += count;
+    job_count += count;
+    countQueueJobs(jobs, count, 1);
+    counterMax(hotCounters(), job_count);
+    invalidateQueueIndexes();
+    return 1;
+}
+
+// --- Binary Trace Format ---
+
+static int hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    return *(const uint8_t*)&probe == 1;
+}
+
+static uint32_t readLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t readLE64(const unsigned char* p) {
+    return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+static void writeLE32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void writeLE64(unsigned char* p, uint64_t v) {
+    writeLE32(p, (uint32_t)v);
+    writeLE32(p + 4, (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief Returns 1 if `path` starts with the binary trace magic.
+ */
+int isBinaryTrace(const char* path) {
+    char magic[8];
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    int is_binary = (fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                     memcmp(magic, BINARY_TRACE_MAGIC, sizeof(magic)) == 0);
+    fclose(file);
+    return is_binary;
+}
+
+/**
+ * @brief Opens a binary trace for replay. On little-endian hosts the
+ * records are used in place through a read-only mapping, with no copy;
+ * elsewhere they are decoded into a heap buffer.
+ *
+ * @return 1 on success, 0 if the file cannot be mapped or is not a
+ * valid version 1 trace.
+ */
+int mapBinaryTrace(const char* path, MappedTrace* trace) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open trace file '%s'.\n", path);
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(BinaryTraceHeader)) {
+        fprintf(stderr, "Error: '%s' is too short to be a binary trace.\n", path);
+        close(fd);
+        return 0;
+    }
+
+    size_t length = (size_t)info.st_size;
+    void* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map trace file '%s'.\n", path);
+        return 0;
+    }
+
+    const unsigned char* header = base;
+    uint32_t version = readLE32(header + 8);
+    uint32_t record_size = readLE32(header + 12);
+    uint64_t record_count = readLE64(header + 16);
+    const char* problem = NULL;
+    if (version != BINARY_TRACE_VERSION) {
+        problem = "unsupported version";
+    } else if (record_size != BINARY_TRACE_RECORD_SIZE) {
+        problem = "unexpected record size";
+    } else if (record_count > INT_MAX ||
+               record_count > (length - sizeof(BinaryTraceHeader)) / record_size) {
+        problem = "record count does not match file size";
+    }
+    if (problem != NULL) {
+        fprintf(stderr, "Error: '%s': %s.\n", path, problem);
+        munmap(base, length);
+        return 0;
+    }
+
+    trace->count = (int)record_count;
+    const unsigned char* records = header + sizeof(BinaryTraceHeader);
+    if (hostIsLittleEndian() && sizeof(PrintJob) == BINARY_TRACE_RECORD_SIZE) {
+        posix_madvise(base, length, POSIX_MADV_SEQUENTIAL);
+        trace->base = base;
+        trace->length = length;
+        trace->jobs = (const PrintJob*)records;
+    } else {
+        PrintJob* decoded = malloc((size_t)trace->count * sizeof(PrintJob) + 1);
+        if (decoded == NULL) {
+            fprintf(stderr, "Error: Out of memory while loading trace.\n");
+            munmap(base, length);
+            return 0;
+        }
+        for (int i = 0; i < trace->count; i++) {
+            const unsigned char* r = records + (size_t)i * BINARY_TRACE_RECORD_SIZE;
+            decoded[i].job_id = (int32_t)readLE32(r);
+            decoded[i].page_count = (int32_t)readLE32(r + 4);
+            decoded[i].priority = (int32_t)readLE32(r + 8);
+            decoded[i].arrival_time = (int32_t)readLE32(r + 12);
+        }
+        munmap(base, length);
+        trace->base = decoded;
+        trace->length = 0;
+        trace->jobs = decoded;
+    }
+
+    // A read-only pass, so corrupt files are rejected before replay
+    for (int i = 0; i < trace->count; i++) {
+        const PrintJob* job = &trace->jobs[i];
+        if (job->job_id <= 0 || job->page_count <= 0 ||
+            job->priority <= 0 || job->arrival_time < 0) {
+            fprintf(stderr, "Error: '%s': invalid job record %d.\n", path, i);
+            unmapBinaryTrace(trace);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void unmapBinaryTrace(MappedTrace* trace) {
+    if (trace->length > 0) {
+        munmap(trace->base, trace->length);
+    } else {
+        free(trace->base);
+    }
+    trace->base = NULL;
+    trace->jobs = NULL;
+    trace->count = 0;
+}
+
+/**
+ * @brief Writes `jobs` to `path` in the binary trace format.
+ * @return 1 on success, 0 on an I/O error.
+ */
+int writeBinaryTrace(const char* path, const PrintJob jobs[], int count) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot create '%s'.\n", path);
+        return 0;
+    }
+
+    unsigned char header[sizeof(BinaryTraceHeader)] = { 0 };
+    memcpy(header, BINARY_TRACE_MAGIC, 8);
+    writeLE32(header + 8, BINARY_TRACE_VERSION);
+    writeLE32(header + 12, BINARY_TRACE_RECORD_SIZE);
+    writeLE64(header + 16, (uint64_t)count);
+    int ok = (fwrite(header, 1, sizeof(header), file) == sizeof(header));
+
+    if (ok && hostIsLittleEndian() && sizeof(PrintJob) == BINARY_TRACE_RECORD_SIZE) {
+        ok = (fwrite(jobs, sizeof(PrintJob), (size_t)count, file) == (size_t)count);
+    } else {
+        unsigned char record[BINARY_TRACE_RECORD_SIZE];
+        for (int i = 0; ok && i < count; i++) {
+            writeLE32(record, (uint32_t)jobs[i].job_id);
+            writeLE32(record + 4, (uint32_t)jobs[i].page_count);
+            writeLE32(record + 8, (uint32_t)jobs[i].priority);
+            writeLE32(record + 12, (uint32_t)jobs[i].arrival_time);
+            ok = (fwrite(record, 1, sizeof(record), file) == sizeof(record));
+        }
+    }
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed writing '%s'.\n", path);
+    }
+    return ok;
+}
+
+/**
+ * @brief Converts a CSV trace into the binary trace format, so it can
+ * be parsed once and replayed many times.
+ * @return 0 on success, 1 on failure (for use as an exit status).
+ */
+int convertTraceFile(const char* in_path, const char* out_path) {
+    int loaded = loadTraceFile(in_path);
+    if (loaded < 0 || !writeBinaryTrace(out_path, job_queue, job_count)) {
+        return 1;
+    }
+    printf("Converted %d jobs from %s to %s.\n", loaded, in_path, out_path);
+    return 0;
+}
+
+/**
+ * @brief Appends `job` to the job store and to every structure kept in
+ * step with it. Scheduler thread only.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int storeJob(const PrintJob* job) {
+    if (job_store_size == INT_MAX ||
+        !reserveJobs(&job_queue, &job_capacity, job_store_size + 1) ||
+        (heaps_ready && !reserveSchedulingHeaps(job_capacity))) {
+        return 0;
+    }
+
+    int index = job_store_size++;
+    job_queue[index] = *job;
+    job_count++;
+    countQueueJobs(job, 1, 1);
+    counterMax(hotCounters(), job_count);
+
+    if (heaps_ready) {
+        for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+            heapPush(&sched_heaps[k], index);
+        }
+    }
+    if (index_ready && !indexJob(index)) {
+        index_ready = 0; // Rebuilt on the next lookup
+    }
+    if (running_ready) {
+        runningMetricsAdd(job);
+    }
+    journalRecord(JOURNAL_SUBMIT, job);
+    return 1;
+}
+
+/**
+ * @brief Adds a new job to the global job_queue.
+ * Takes user input for page count and priority.
+ */
+void addJob() {
+    PrintJob newJob;
+
+    HotCounters* counters = hotCounters();
+    if (!readMenuNumber("  Enter Page Count (e.g., 50): ", &newJob.page_count) ||
+        !readMenuNumber("  Enter Priority (1=Faculty, 2=Student, 3=Guest): ",
+                        &newJob.priority) ||
+        !readMenuNumber("  Enter Arrival Time (0 = start of simulation): ",
+                        &newJob.arrival_time)) {
+        printf("Error: Please enter a number.\n");
+        counterAdd(counters, &counters->rejected, 1);
+        return;
+    }
+    if (newJob.page_count <= 0 || newJob.priority <= 0) {
+        printf("Error: Page count and priority must be positive.\n");
+        counterAdd(counters, &counters->rejected, 1);
+        return;
+    }
+    if (newJob.arrival_time < 0) {
+        printf("Error: Arrival time cannot be negative.\n");
+        counterAdd(counters, &counters->rejected, 1);
+        return;
+    }
+
+    // Taken only once the job is valid, so there is nothing to roll back
+    newJob.job_id = atomic_fetch_add(&next_job_id, 1);
+    if (!storeJob(&newJob)) {
+        printf("Error: Out of memory. Cannot add more jobs.\n");
+        counterAdd(counters, &counters->rejected, 1);
+        return;
+    }
+    counterAdd(counters, &counters->submitted, 1);
+
+    printf("  Success: Added Job %d (%d pages, priority %d, arrives at %d).\n",
+           newJob.job_id, newJob.page_count, newJob.priority, newJob.arrival_time);
+}
+
+// --- Write-Ahead Journal ---
+
+#if defined(__SSE4_2__)
+/**
+ * @brief Extends the CRC-32C `crc` over `length` bytes, eight at a time
+ * with the SSE4.2 instruction.
+ */
+static uint32_t crc32c(uint32_t crc, const unsigned char* data, size_t length) {
+    crc = ~crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+    }
+    for (; length > 0; data++, length--) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return ~crc;
+}
+#else
+/**
+ * @brief Extends the CRC-32C `crc` over `length` bytes, a byte at a time
+ * through a table built on first use.
+ */
+static uint32_t crc32c(uint32_t crc, const unsigned char* data, size_t length) {
+    static uint32_t table[256];
+    static int table_ready = 0;
+    if (!table_ready) {
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t v = b;
+            for (int bit = 0; bit < 8; bit++) {
+                v = (v >> 1) ^ (0x82F63B78u & (0u - (v & 1)));
+            }
+            table[b] = v;
+        }
+        table_ready = 1;
+    }
+    crc = ~crc;
+    for (; length > 0; data++, length--) {
+        crc = table[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+#endif
+
+// Job fields in the binary trace record layout
+static void encodeJob(unsigned char* p, const PrintJob* job) {
+    writeLE32(p, (uint32_t)job->job_id);
+    writeLE32(p + 4, (uint32_t)job->page_count);
+    writeLE32(p + 8, (uint32_t)job->priority);
+    writeLE32(p + 12, (uint32_t)job->arrival_time);
+}
+
+static void decodeJob(const unsigned char* p, PrintJob* job) {
+    job->job_id = (int32_t)readLE32(p);
+    job->page_count = (int32_t)readLE32(p + 4);
+    job->priority = (int32_t)readLE32(p + 8);
+    job->arrival_time = (int32_t)readLE32(p + 12);
+}
+
+// write() all `length` bytes, retrying short writes
+static int writeAll(int fd, const unsigned char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return 0;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+// Makes a rename inside the directory of `path` durable
+static int syncParentDir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char dir[4096] = ".";
+    if (slash != NULL) {
+        size_t length = (slash == path) ? 1 : (size_t)(slash - path);
+        if (length >= sizeof(dir)) {
+            return 0;
+        }
+        memcpy(dir, path, length);
+        dir[length] = '\0';
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    int ok = (fsync(fd) == 0);
+    close(fd);
+    return ok;
+}
+
+// Starts an empty journal of `generation` on the open, empty journal.fd
+static int writeJournalHeader(uint64_t generation) {
+    unsigned char header[JOURNAL_HEADER_SIZE] = { 0 };
+    memcpy(header, JOURNAL_MAGIC, 8);
+    writeLE32(header + 8, JOURNAL_VERSION);
+    writeLE32(header + 12, JOURNAL_RECORD_SIZE);
+    writeLE64(header + 16, generation);
+    return writeAll(journal.fd, header, sizeof(header)) && fdatasync(journal.fd) == 0;
+}
+
+static void stopJournal(const char* what) {
+    fprintf(stderr, "Error: %s '%s' failed; jobs are no longer journaled.\n",
+            what, journal.path);
+    close(journal.fd);
+    journal.fd = -1;
+    journal.length = 0;
+}
+
+/**
+ * @brief Appends one record to the journal buffer. It reaches the file
+ * on the next journalCommit, or sooner if the buffer fills.
+ */
+void journalRecord(JournalRecordType type, const PrintJob* job) {
+    if (journal.fd < 0) {
+        return;
+    }
+    if (journal.length + JOURNAL_RECORD_SIZE > JOURNAL_BUFFER_SIZE) {
+        if (!writeAll(journal.fd, journal.buffer, journal.length)) {
+            stopJournal("Writing journal");
+            return;
+        }
+        journal.length = 0;
+        journal.unsynced = 1;
+    }
+    unsigned char* r = journal.buffer + journal.length;
+    writeLE32(r + 4, (uint32_t)type);
+    encodeJob(r + 8, job);
+    writeLE32(r, crc32c(0, r + 4, JOURNAL_RECORD_SIZE - 4));
+    journal.length += JOURNAL_RECORD_SIZE;
+    journal.records++;
+}
+
+/**
+ * @brief Group commit: writes every buffered record with one write()
+ * and, as --journal-sync asks, one fdatasync. Once enough records have
+ * built up, the live queue is snapshotted and the journal restarted.
+ * Callers commit before acknowledging the jobs the records describe.
+ * @return 1 on success, 0 if journaling had to stop.
+ */
+int journalCommit() {
+    if (journal.fd < 0) {
+        return journal.path == NULL; // Only an error if journaling failed
+    }
+    uint64_t started = traceStart();
+    long long written = (long long)(journal.length / JOURNAL_RECORD_SIZE);
+    if (journal.length > 0) {
+        if (!writeAll(journal.fd, journal.buffer, journal.length)) {
+            stopJournal("Writing journal");
+            return 0;
+        }
+        journal.length = 0;
+        journal.unsynced = 1;
+        journal.commits++;
+    }
+
+    double now = nowSeconds();
+    if (journal.unsynced &&
+        (journal_sync == JOURNAL_SYNC_BATCH ||
+         (journal_sync == JOURNAL_SYNC_INTERVAL &&
+          (now - journal.last_sync) * 1000.0 >= journal_sync_interval_ms))) {
+        if (fdatasync(journal.fd) != 0) {
+            stopJournal("Syncing journal");
+            return 0;
+        }
+        journal.unsynced = 0;
+        journal.last_sync = now;
+        journal.syncs++;
+    }
+    if (written > 0) {
+        traceEnd(TRACE_JOURNAL_COMMIT, 0, written, started);
+    }
+
+    if (journal.records >= snapshot_every) {
+        return writeSnapshot();
+    }
+    return 1;
+}
+
+/**
+ * @brief Saves the live queue as the snapshot of the next generation and
+ * restarts the journal empty. The snapshot is complete on disk before it
+ * replaces the old one, and a journal still carrying the old generation
+ * is ignored on recovery, so a crash at any point loses nothing.
+ * @return 1 on success, 0 if journaling had to stop.
+ */
+int writeSnapshot() {
+    compactJobQueue();
+    uint64_t generation = journal.generation + 1;
+    size_t records_size = (size_t)job_count * BINARY_TRACE_RECORD_SIZE;
+    unsigned char* image = malloc(SNAPSHOT_HEADER_SIZE + records_size);
+    if (image == NULL) {
+        fprintf(stderr, "Error: Out of memory; snapshot postponed.\n");
+        return 1; // The journal is still complete, just longer
+    }
+    memcpy(image, SNAPSHOT_MAGIC, 8);
+    writeLE32(image + 8, JOURNAL_VERSION);
+    writeLE32(image + 12, BINARY_TRACE_RECORD_SIZE);
+    writeLE64(image + 16, generation);
+    writeLE64(image + 24, (uint64_t)job_count);
+    writeLE32(image + 32, (uint32_t)next_job_id);
+    for (int i = 0; i < job_count; i++) {
+        encodeJob(image + SNAPSHOT_HEADER_SIZE + (size_t)i * BINARY_TRACE_RECORD_SIZE,
+                  &job_queue[i]);
+    }
+    uint32_t crc = crc32c(0, image, 36); // The header up to the checksum
+    crc = crc32c(crc, image + SNAPSHOT_HEADER_SIZE, records_size);
+    writeLE32(image + 36, crc);
+
+    int fd = open(journal.snapshot_temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ok = fd >= 0 && writeAll(fd, image, SNAPSHOT_HEADER_SIZE + records_size) &&
+             fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) {
+        ok = 0;
+    }
+    free(image);
+    if (!ok || rename(journal.snapshot_temp_path, journal.snapshot_path) != 0 ||
+        !syncParentDir(journal.snapshot_path)) {
+        stopJournal("Writing snapshot for");
+        return 0;
+    }
+
+    journal.generation = generation;
+    journal.records = 0;
+    if (ftruncate(journal.fd, 0) != 0 || !writeJournalHeader(generation)) {
+        stopJournal("Restarting journal");
+        return 0;
+    }
+    journal.unsynced = 0;
+    return 1;
+}
+
+/**
+ * @brief Maps `path` read-only in full. Empty or missing files give
+ * length 0 and no mapping.
+ * @return 1 on success (or a missing file), 0 on an I/O error.
+ */
+static int mapWholeFile(const char* path, const unsigned char** data, size_t* length) {
+    *data = NULL;
+    *length = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    struct stat info;
+    int ok = (fstat(fd, &info) == 0);
+    if (ok && info.st_size > 0) {
+        void* base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = (base != MAP_FAILED);
+        if (ok) {
+            posix_madvise(base, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+            *data = base;
+            *length = (size_t)info.st_size;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief Rebuilds the live queue from the snapshot and journal at `path`
+ * and opens the journal for appending. A torn record at the end, left by
+ * a crash mid-write, is dropped.
+ * @return 1 on success, 0 on an I/O error or a corrupt snapshot.
+ */
+int openJournal(const char* path) {
+    double started = nowSeconds();
+    size_t path_length = strlen(path);
+    journal.path = path;
+    journal.snapshot_path = malloc(path_length + sizeof(".snap"));
+    journal.snapshot_temp_path = malloc(path_length + sizeof(".snap.tmp"));
+    journal.buffer = malloc(JOURNAL_BUFFER_SIZE);
+    if (journal.snapshot_path == NULL || journal.snapshot_temp_path == NULL ||
+        journal.buffer == NULL) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 0;
+    }
+    sprintf(journal.snapshot_path, "%s.snap", path);
+    sprintf(journal.snapshot_temp_path, "%s.snap.tmp", path);
+
+    const unsigned char* snapshot;
+    size_t snapshot_length;
+    if (!mapWholeFile(journal.snapshot_path, &snapshot, &snapshot_length)) {
+        fprintf(stderr, "Error: Cannot read snapshot '%s'.\n", journal.snapshot_path);
+        return 0;
+    }
+    uint64_t snapshot_generation = 0;
+    uint64_t snapshot_count = 0;
+    int snapshot_next_id = 1;
+    if (snapshot != NULL) {
+        const char* problem = NULL;
+        if (snapshot_length < SNAPSHOT_HEADER_SIZE ||
+            memcmp(snapshot, SNAPSHOT_MAGIC, 8) != 0 ||
+            readLE32(snapshot + 8) != JOURNAL_VERSION ||
+            readLE32(snapshot + 12) != BINARY_TRACE_RECORD_SIZE) {
+            problem = "not a version 1 snapshot";
+        } else {
+            snapshot_generation = readLE64(snapshot + 16);
+            snapshot_count = readLE64(snapshot + 24);
+            snapshot_next_id = (int)readLE32(snapshot + 32);
+            if (snapshot_count >= INT_MAX ||
+                snapshot_count != (snapshot_length - SNAPSHOT_HEADER_SIZE) /
+                                  BINARY_TRACE_RECORD_SIZE) {
+                problem = "record count does not match file size";
+            } else if (crc32c(crc32c(0, snapshot, 36), snapshot + SNAPSHOT_HEADER_SIZE,
+                              (size_t)snapshot_count * BINARY_TRACE_RECORD_SIZE) !=
+                       readLE32(snapshot + 36)) {
+                problem = "checksum mismatch";
+            }
+        }
+        if (problem != NULL) {
+            fprintf(stderr, "Error: '%s': %s.\n", journal.snapshot_path, problem);
+            munmap((void*)snapshot, snapshot_length);
+            return 0;
+        }
+    }
+
+    const unsigned char* log;
+    size_t log_length;
+    if (!mapWholeFile(path, &log, &log_length)) {
+        fprintf(stderr, "Error: Cannot read journal '%s'.\n", path);
+        if (snapshot != NULL) {
+            munmap((void*)snapshot, snapshot_length);
+        }
+        return 0;
+    }
+    // Shorter than a header is a journal torn as it was created; anything
+    // else must be one, so that no other file is overwritten
+    const char* problem = NULL;
+    uint64_t log_generation = 0;
+    if (log_length >= JOURNAL_HEADER_SIZE) {
+        log_generation = readLE64(log + 16);
+        if (memcmp(log, JOURNAL_MAGIC, 8) != 0 || readLE32(log + 8) != JOURNAL_VERSION ||
+            readLE32(log + 12) != JOURNAL_RECORD_SIZE) {
+            problem = "not a version 1 journal";
+        } else if (log_generation > snapshot_generation) {
+            problem = "newer than its snapshot";
+        }
+    } else if (log_length > 0 && memcmp(log, JOURNAL_MAGIC, log_length < 8 ? log_length : 8) != 0) {
+        problem = "not a version 1 journal";
+    }
+    if (problem != NULL) {
+        fprintf(stderr, "Error: '%s': %s.\n", path, problem);
+        munmap((void*)log, log_length);
+        if (snapshot != NULL) {
+            munmap((void*)snapshot, snapshot_length);
+        }
+        return 0;
+    }
+    // A journal from before the snapshot was taken is already in it
+    int replay = log_length >= JOURNAL_HEADER_SIZE && log_generation == snapshot_generation;
+    size_t log_records = replay ? (log_length - JOURNAL_HEADER_SIZE) / JOURNAL_RECORD_SIZE : 0;
+
+    // Live jobs are the snapshot's plus those submitted since, less those
+    // dispatched or cancelled since, with their latest priorities
+    PrintJob* live = NULL;
+    int live_capacity = 0;
+    int live_count = 0;
+    IdMap updates = { NULL, NULL, 0, 0 }; // id -> new priority, or 0 once gone
+    int ok = idMapInit(&updates, log_records) &&
+             reserveJobs(&live, &live_capacity, (int)snapshot_count + 1);
+    for (uint64_t i = 0; ok && i < snapshot_count; i++) {
+        decodeJob(snapshot + SNAPSHOT_HEADER_SIZE + i * BINARY_TRACE_RECORD_SIZE,
+                  &live[live_count++]);
+    }
+
+    size_t good_length = replay ? JOURNAL_HEADER_SIZE : 0;
+    size_t replayed = 0;
+    int max_id = 0;
+    int has_updates = 0;
+    for (size_t i = 0; ok && i < log_records; i++) {
+        const unsigned char* r = log + JOURNAL_HEADER_SIZE + i * JOURNAL_RECORD_SIZE;
+        if (crc32c(0, r + 4, JOURNAL_RECORD_SIZE - 4) != readLE32(r)) {
+            break; // Torn or corrupt: nothing after it was acknowledged
+        }
+        PrintJob job;
+        decodeJob(r + 8, &job);
+        uint32_t type = readLE32(r + 4);
+        if (type == JOURNAL_SUBMIT) {
+            ok = reserveJobs(&live, &live_capacity, live_count + 1);
+            if (ok) {
+                live[live_count++] = job;
+            }
+        } else if (type == JOURNAL_DISPATCH || type == JOURNAL_CANCEL ||
+                   type == JOURNAL_PRIORITY) {
+            size_t slot = idSlot(&updates, job.job_id);
+            updates.ids[slot] = job.job_id;
+            updates.values[slot] = (type == JOURNAL_PRIORITY) ? job.priority : 0;
+            has_updates = 1;
+        } else {
+            break;
+        }
+        if (job.job_id > max_id) {
+            max_id = job.job_id;
+        }
+        good_length += JOURNAL_RECORD_SIZE;
+        replayed++;
+    }
+    if (has_updates) {
+        int kept = 0;
+        for (int i = 0; i < live_count; i++) {
+            size_t slot = idSlot(&updates, live[i].job_id);
+            if (updates.ids[slot] == 0) {
+                live[kept++] = live[i];
+            } else if (updates.values[slot] > 0) {
+                live[kept] = live[i];
+                live[kept++].priority = updates.values[slot];
+            }
+        }
+        live_count = kept;
+    }
+    idMapFree(&updates);
+    if (log != NULL) {
+        munmap((void*)log, log_length);
+    }
+    if (snapshot != NULL) {
+        munmap((void*)snapshot, snapshot_length);
+    }
+    if (!ok || !appendJobs(live, live_count)) {
+        fprintf(stderr, "Error: Out of memory while replaying journal.\n");
+        free(live);
+        return 0;
+    }
+    free(live);
+    // Ids of dispatched jobs are never handed out again
+    if (snapshot_next_id > next_job_id) {
+        next_job_id = snapshot_next_id;
+    }
+    if (max_id >= next_job_id && max_id < INT_MAX) {
+        next_job_id = max_id + 1;
+    }
+
+    journal.fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    journal.generation = snapshot_generation;
+    journal.records = (long long)replayed;
+    journal.last_sync = nowSeconds();
+    if (journal.fd < 0 || ftruncate(journal.fd, (off_t)good_length) != 0 ||
+        (good_length == 0 && !writeJournalHeader(snapshot_generation)) ||
+        fdatasync(journal.fd) != 0) {
+        fprintf(stderr, "Error: Cannot open journal '%s' for writing.\n", path);
+        if (journal.fd >= 0) {
+            close(journal.fd);
+            journal.fd = -1;
+        }
+        return 0;
+    }
+
+    if (snapshot != NULL || replayed > 0) {
+        printf("Recovered %d job(s) from %s in %.3f s: a snapshot of %llu, "
+               "%zu record(s) replayed.\n", job_count, path, nowSeconds() - started,
+               (unsigned long long)snapshot_count, replayed);
+    }
+    return 1;
+}
+
+/**
+ * @brief Commits and syncs whatever is still buffered, then closes the
+ * journal.
+ */
+void closeJournal() {
+    if (journal.fd >= 0) {
+        journalCommit();
+    }
+    if (journal.fd >= 0) {
+        if (journal.unsynced && fdatasync(journal.fd) != 0) {
+            fprintf(stderr, "Error: Syncing journal '%s' failed.\n", journal.path);
+        }
+        close(journal.fd);
+        journal.fd = -1;
+    }
+    free(journal.buffer);
+    free(journal.snapshot_path);
+    free(journal.snapshot_temp_path);
+    journal.buffer = NULL;
+    journal.snapshot_path = NULL;
+    journal.snapshot_temp_path = NULL;
+}
+
+// --- Concurrent Job Submission ---
+
+/**
+ * @brief Allocates `ring` with room for `capacity` jobs, rounded up to a
+ * power of two. Must finish before any producer starts.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int initSubmitRing(SubmitRing* ring, int capacity) {
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+        size <<= 1;
+    }
+    ring->cells = malloc(size * sizeof(SubmitCell));
+    if (ring->cells == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&ring->cells[i].sequence, i);
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->tail, 0);
+    ring->head = 0;
+    return 1;
+}
+
+void freeSubmitRing(SubmitRing* ring) {
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+/**
+ * @brief Submits a job from any thread without blocking: claims a slot
+ * of submit_ring, takes the next job id and publishes the job for the
+ * scheduler thread's next drainSubmissions(). The ring must have been
+ * initialised. The id is not an acknowledgement of durability: with
+ * --journal the job is journaled by the drain that stores it, and
+ * survives a crash only once the journalCommit() after that drain
+ * returns.
+ * @return The new job's id, 0 if the ring is full (the caller may retry
+ * or shed the job) and -1 if the job is invalid.
+ */
+int submitJob(int page_count, int priority, int arrival_time) {
+    HotCounters* counters = hotCounters();
+    if (page_count <= 0 || priority <= 0 || arrival_time < 0) {
+        counterAdd(counters, &counters->rejected, 1);
+        return -1;
+    }
+    SubmitRing* ring = &submit_ring;
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    SubmitCell* cell;
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t lag = (intptr_t)sequence - (intptr_t)pos;
+        if (lag == 0) {
+            // The slot is free: claim it, or learn the new tail on failure
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            counterAdd(counters, &counters->rejected, 1);
+            return 0; // Still holds an undrained job from one lap ago
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    // The cell belongs to the scheduler once published, so the id is
+    // read back from a local
+    int job_id = atomic_fetch_add_explicit(&next_job_id, 1, memory_order_relaxed);
+    cell->job.job_id = job_id;
+    cell->job.page_count = page_count;
+    cell->job.priority = priority;
+    cell->job.arrival_time = arrival_time;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    counterAdd(counters, &counters->submitted, 1);
+    return job_id;
+}
+
+/**
+ * @brief Moves every published submission into the job store, in ring
+ * order. Scheduler thread only; producers keep submitting meanwhile. A
+ * job is only released from the ring once it is stored, so running out
+ * of memory leaves it there for a later drain.
+ * @return The number of jobs taken in.
+ */
+int drainSubmissions() {
+    SubmitRing* ring = &submit_ring;
+    if (ring->cells == NULL) {
+        return 0;
+    }
+    uint64_t started = traceStart();
+    int drained = 0;
+    deferQueueCounters();
+    for (;;) {
+        SubmitCell* cell = &ring->cells[ring->head & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if (sequence != ring->head + 1 || !storeJob(&cell->job)) {
+            break; // Empty, still being written, or out of memory
+        }
+        // Hand the slot to the producer one lap ahead
+        atomic_store_explicit(&cell->sequence, ring->head + ring->mask + 1,
+                              memory_order_release);
+        ring->head++;
+        drained++;
+        if (drained % 4096 == 0) {
+            flushQueueCounters(); // A drain can go on as long as producers keep up
+        }
+    }
+    publishQueueCounters();
+    if (drained > 0) {
+        traceEnd(TRACE_DRAIN, 0, drained, started);
+    }
+    return drained;
+}
+
+// Body of one --submit-bench producer: random jobs, retrying when full.
+static void* runSubmitProducer(void* arg) {
+    SubmitProducer* producer = arg;
+    Rng rng;
+    rngSeed(&rng, producer->seed);
+    for (int i = 0; i < producer->jobs; i++) {
+        if (i % 4096 == 0) {
+            // A reading of the live queue, taken while the scheduler
+            // thread keeps storing jobs
+            QueueView view;
+            readQueueCounters(&view);
+            int depth = 0;
+            long long pages = 0;
+            for (int k = 0; k <= PRIORITY_CLASSES; k++) {
+                depth += view.class_depth[k];
+                pages += view.class_pages[k];
+            }
+            producer->views++;
+            producer->torn += (depth != view.depth || pages != view.pages);
+            if (view.depth > producer->deepest) {
+                producer->deepest = view.depth;
+            }
+        }
+        int pages = 1 + (int)(rngNext(&rng) % 100);
+        int priority = 1 + (int)(rngNext(&rng) % PRIORITY_CLASSES);
+        int arrival = (int)(rngNext(&rng) % 1000000);
+        while (submitJob(pages, priority, arrival) == 0) {
+            sched_yield(); // Let the scheduler drain
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs --submit-bench: --threads producer threads submit `jobs`
+ * jobs between them while this thread drains them into the job store,
+ * then reports the sustained rate.
+ * @return 0 on success, 1 on failure (for use as an exit status).
+ */
+int runSubmitBench(int jobs) {
+    int producers = worker_thread_count;
+    if (producers < 1) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        producers = (cores > 0) ? (int)cores : 1;
+    }
+    // With the store sized up front, draining can never run out of
+    // memory and strand the producers on a full ring
+    SubmitProducer* threads = calloc((size_t)producers, sizeof(SubmitProducer));
+    if (threads == NULL || jobs > INT_MAX - job_store_size ||
+        !reserveJobs(&job_queue, &job_capacity, job_store_size + jobs) ||
+        (submit_ring.cells == NULL && !initSubmitRing(&submit_ring, SUBMIT_RING_CAPACITY))) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        free(threads);
+        return 1;
+    }
+
+    double started = nowSeconds();
+    int expected = 0;
+    for (int t = 0; t < producers; t++) {
+        threads[t].jobs = jobs / producers + (t < jobs % producers ? 1 : 0);
+        threads[t].seed = 1 + (uint64_t)t;
+        threads[t].started = (pthread_create(&threads[t].thread, NULL,
+                                             runSubmitProducer, &threads[t]) == 0);
+        if (threads[t].started) {
+            expected += threads[t].jobs;
+        }
+    }
+
+    int drained = 0;
+    while (drained < expected) {
+        int batch = drainSubmissions();
+        if (batch == 0) {
+            sched_yield(); // Let the producers fill the ring
+        }
+        drained += batch;
+        journalCommit(); // One group commit per drained batch
+    }
+    double elapsed = nowSeconds() - started;
+    for (int t = 0; t < producers; t++) {
+        if (threads[t].started) {
+            pthread_join(threads[t].thread, NULL);
+        }
+    }
+    drained += drainSubmissions();
+    journalCommit();
+    int views = 0;
+    int torn = 0;
+    int deepest = 0;
+    for (int t = 0; t < producers; t++) {
+        views += threads[t].views;
+        torn += threads[t].torn;
+        deepest = threads[t].deepest > deepest ? threads[t].deepest : deepest;
+    }
+    free(threads);
+
+    printf("Submitted %d jobs from %d producer thread(s) in %.3f s, %.1f M jobs/s; "
+           "%d jobs queued.\n", drained, producers, elapsed,
+           elapsed > 0.0 ? drained / elapsed / 1e6 : 0.0, job_count);
+    printf("Producers took %d readings of the live queue counters meanwhile "
+           "(deepest %d, %d inconsistent).\n", views, deepest, torn);
+    if (journal.fd >= 0) {
+        printf("Journaled them in %lld group commit(s) with %lld fdatasync(s).\n",
+               journal.commits, journal.syncs);
+    }
+    return drained == jobs ? 0 : 1;
+}
+
+/**
+ * @brief Removes the next job from the live queue and sends it to the
+ * printer, using the policy chosen by the user. The job is taken from the
+ * top of that policy's heap and dropped from the other heaps, all in
+ * O(log n); no copy or sort of the queue is needed.
+ */
+void dispatchNextJob() {
+    if (job_count == 0) {
+        printf("Cannot dispatch: The print queue is empty.\n");
+        return;
+    }
+
+    int policy = 0;
+    if (!readMenuNumber("  Dispatch using (1=FCFS, 2=SJF, 3=Priority): ", &policy) ||
+        policy < 1 || policy > ONLINE_POLICY_COUNT) {
+        printf("Error: Unknown policy.\n");
+        return;
+    }
+
+    PrintJob job;
+    if (!dispatchJob((SchedPolicy)(policy - 1), &job)) {
+        printf("Error: Out of memory. Cannot dispatch.\n");
+        return;
+    }
+
+    printf("  Dispatched Job %d (%d pages, priority %d). %d job(s) remain.\n",
+           job.job_id, job.page_count, job.priority, job_count);
+}
+
+/**
+ * @brief Takes job_queue[index] out of the live queue and every
+ * structure kept in step with it, in O(log n), and journals it as
+ * `type`.
+ * @param job Output: the job removed.
+ */
+static void removeLiveJob(int index, JournalRecordType type, PrintJob* job) {
+    *job = job_queue[index];
+    for (int k = 0; heaps_ready && k < ONLINE_POLICY_COUNT; k++) {
+        heapRemove(&sched_heaps[k], index);
+    }
+    if (index_shadowed) {
+        index_ready = 0; // Its id may lead to another job; rebuild instead
+    } else if (index_ready) {
+        unindexJob(job->job_id);
+    }
+    job_queue[index].page_count = 0; // Mark the slot as dispatched
+    job_count--;
+    countQueueJobs(job, 1, -1);
+    if (running_ready) {
+        runningMetricsRemove(job);
+    }
+    journalRecord(type, job);
+
+    // Reclaim dispatched slots once they outnumber the live ones, so
+    // compaction stays amortized O(1) per removal.
+    if (job_store_size - job_count > job_count) {
+        compactJobQueue();
+    }
+}
+
+/**
+ * @brief Removes the next job under online `policy` from the queue.
+ * @param job Output: the dispatched job.
+ * @return 1 on success, 0 if the queue is empty or the heaps could not
+ * be built.
+ */
+int dispatchJob(SchedPolicy policy, PrintJob* job) {
+    if (job_count == 0 || !ensureSchedulingHeaps()) {
+        return 0;
+    }
+
+    removeLiveJob(sched_heaps[policy].slots[0], JOURNAL_DISPATCH, job);
+    HotCounters* counters = hotCounters();
+    counterAdd(counters, &counters->dispatched, 1);
+    traceMark(TRACE_DISPATCH, job->job_id);
+    return 1;
+}
+
+/**
+ * @brief Removes the job with `job_id` from the live queue unprinted:
+ * an O(1) index lookup, then O(log n) removals from the heaps.
+ * @param job Output: the cancelled job.
+ * @return 1 on success, 0 if no such job is queued, -1 if out of memory.
+ */
+int cancelJob(int job_id, PrintJob* job) {
+    int index = findJob(job_id);
+    if (index < 0) {
+        return (index == -1) ? 0 : -1;
+    }
+    removeLiveJob(index, JOURNAL_CANCEL, job);
+    return 1;
+}
+
+/**
+ * @brief Gives the queued job with `job_id` a new (positive) priority:
+ * an O(1) index lookup, then one O(log n) sift of the Priority heap,
+ * up or down, and a move within the running metrics' Priority order.
+ * The FCFS and SJF orders do not depend on priority.
+ * @param job Output: the job, with its new priority.
+ * @return 1 on success, 0 if no such job is queued, -1 if out of memory.
+ */
+int reprioritizeJob(int job_id, int priority, PrintJob* job) {
+    int index = findJob(job_id);
+    if (index < 0) {
+        return (index == -1) ? 0 : -1;
+    }
+    PrintJob* queued = &job_queue[index];
+    if (queued->priority != priority) {
+        countQueueReprioritized(queued->page_count, queued->priority, priority);
+        if (running_ready) {
+            runningMetricsReprioritize(queued, priority);
+        }
+        queued->priority = priority;
+        if (heaps_ready) {
+            JobHeap* heap = &sched_heaps[POLICY_PRIORITY];
+            heapSiftUp(heap, heap->pos[index]);
+            heapSiftDown(heap, heap->pos[index]);
+        }
+        journalRecord(JOURNAL_PRIORITY, queued);
+    }
+    *job = *queued;
+    return 1;
+}
+
+// Reads a job id from the menu; 0 if the input is not a number or ended
+static int readJobId(const char* prompt) {
+    int job_id = 0;
+    if (!readMenuNumber(prompt, &job_id)) {
+        return 0;
+    }
+    return job_id;
+}
+
+/**
+ * @brief Asks for a job id and cancels that job, from the menu.
+ */
+void cancelQueuedJob() {
+    int job_id = readJobId("  Job ID to cancel: ");
+    PrintJob job;
+    int found = cancelJob(job_id, &job);
+    if (found < 0) {
+        printf("Error: Out of memory. Cannot look up jobs.\n");
+    } else if (found == 0) {
+        printf("Error: No job %d is queued.\n", job_id);
+    } else {
+        printf("  Cancelled Job %d (%d pages, priority %d). %d job(s) remain.\n",
+               job.job_id, job.page_count, job.priority, job_count);
+    }
+}
+
+/**
+ * @brief Asks for a job id and a new priority and applies it, from the
+ * menu.
+ */
+void reprioritizeQueuedJob() {
+    int job_id = readJobId("  Job ID to change: ");
+    int priority = 0;
+    if (!readMenuNumber("  New Priority (1=Faculty, 2=Student, 3=Guest): ", &priority) ||
+        priority <= 0) {
+        printf("Error: Priority must be positive.\n");
+        return;
+    }
+    PrintJob job;
+    int found = reprioritizeJob(job_id, priority, &job);
+    if (found < 0) {
+        printf("Error: Out of memory. Cannot look up jobs.\n");
+    } else if (found == 0) {
+        printf("Error: No job %d is queued.\n", job_id);
+    } else {
+        printf("  Job %d (%d pages) now has priority %d.\n",
+               job.job_id, job.page_count, job.priority);
+    }
+}
+
+/**
+ * @brief Displays all jobs currently in the queue in their arrival order.
+ * Rows go out DISPLAY_PAGE_JOBS at a time: each page is copied from the
+ * live queue, formatted by hand and written with one fwrite, rather
+ * than one printf per job.
+ */
+void displayQueue() {
+    if (job_count == 0) {
+        printf("The print queue is currently empty.\n");
+        return;
+    }
+    PrintJob* page = malloc(DISPLAY_PAGE_JOBS * sizeof(PrintJob));
+    char* rows = malloc(DISPLAY_PAGE_JOBS * 64); // A row takes at most 54 bytes
+    if (page == NULL || rows == NULL) {
+        printf("Error: Out of memory. Cannot display the queue.\n");
+        free(page);
+        free(rows);
+        return;
+    }
+
+    printf("\n--- Current Print Queue (FCFS Order) ---\n");
+    printf("Job ID | Page Count | Priority | Arrival\n");
+    printf("--------------------------------------------\n");
+    int slot = 0;
+    for (int n; (n = copyQueuePage(&slot, page, DISPLAY_PAGE_JOBS)) > 0;) {
+        char* end = formatQueueRows(rows, page, n);
+        fwrite(rows, 1, (size_t)(end - rows), stdout);
+    }
+    free(page);
+    free(rows);
+
+    QueueView view;
+    readQueueCounters(&view);
+    printf("\n%d job(s), %lld page(s) queued:", view.depth, view.pages);
+    for (int k = 1; k <= PRIORITY_CLASSES + 1; k++) {
+        int c = k % (PRIORITY_CLASSES + 1); // The known classes, then the rest
+        if (c != 0 || view.class_depth[0] > 0) {
+            printf("%s %s %d (%lld pages)", k > 1 ? "," : "", priority_class_names[c],
+                   view.class_depth[c], view.class_pages[c]);
+        }
+    }
+    printf("\n");
+
+    printf("\nIf one printer drained the queue now (all jobs already waiting):\n");
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        double avg_wait, avg_turnaround;
+        if (!runningAverages((SchedPolicy)k, &avg_wait, &avg_turnaround)) {
+            printf("  Backlog averages unavailable (page counts above %d,\n"
+                   "  or out of memory).\n", RUNNING_KEY_LIMIT);
+            break;
+        }
+        printf("  %-32s avg wait %.2f, avg turnaround %.2f\n",
+               policy_ops[k].name, avg_wait, avg_turnaround);
+    }
+}
+
+/**
+ * @brief Runs `policy` from the menu on the live queue.
+ */
+void runMenuPolicy(SchedPolicy policy) {
+    if (job_count == 0) {
+        printf("Cannot run simulation: The print queue is empty.\n");
+        return;
+    }
+    compactJobQueue();
+    simulatePolicy(job_queue, job_count, policy);
+}
+
+/**
+ * @brief Schedules `jobs` under `policy` on the configured printers and
+ * reports the resulting metrics. The jobs themselves are never modified,
+ * so they may live in job_queue or in a read-only mapped trace.
+ */
+void simulatePolicy(const PrintJob jobs[], int count, SchedPolicy policy) {
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+
+    // FCFS on a single printer processes the jobs in arrival order. They
+    // are normally queued in that order already, so no copy is needed.
+    SimResult result;
+    // Percentiles are only worth their pass when something prints them
+    LatencyStats* latency = NULL;
+    if (output_mode != OUTPUT_OFF) {
+        latency = malloc(sizeof(LatencyStats));
+        if (latency == NULL) {
+            printf("Error: Out of memory. Cannot run simulation.\n");
+            return;
+        }
+    }
+
+    if (policy == POLICY_FCFS && printer_count == 1 && setup_cost == 0 &&
+        coalesce_pages == 0 && jobsInOrder(POLICY_FCFS, jobs, count)) {
+        summarizeRun(jobs, NULL, count, &stats, &result, latency);
+        reportRun(jobs, NULL, count, policy, &stats, &result, latency);
+        free(latency);
+        return;
+    }
+
+    PrintJob* temp_queue = getScratchQueue(count);
+    long long* completion = NULL;
+    CoalesceStats made;
+    int ok = (temp_queue != NULL);
+    if (ok && coalesce_pages > 0) {
+        ok = runCoalescedPolicy(jobs, count, policy, coalesce_pages, temp_queue,
+                                &completion, &stats, &made);
+    } else if (ok) {
+        ok = runPolicy(jobs, count, policy, temp_queue, &completion, &stats);
+    }
+    if (!ok) {
+        printf("Error: Out of memory. Cannot run simulation.\n");
+        free(latency);
+        return;
+    }
+
+    summarizeRun(temp_queue, completion, count, &stats, &result, latency);
+    reportRun(temp_queue, completion, count, policy, &stats, &result, latency);
+    if (coalesce_pages > 0 && output_mode != OUTPUT_OFF) {
+        reportCoalescing(jobs, count, policy, &made, &stats, &result);
+    }
+    if (shardsInEffect(policy, stats.printers) > 1 && latency != NULL) {
+        reportSharding(jobs, count, policy, &stats, &result, latency);
+    }
+    free(completion);
+    free(latency);
+}
+
+// Schedules `jobs` as they are, with no setup; runPolicy() without --setup-cost
+static int scheduleRun(const PrintJob jobs[], int count, SchedPolicy policy,
+                       PrintJob order[], long long** completion, SimStats* stats) {
+    // Completion times are only needed when jobs do not simply print
+    // back to back on one printer.
+    *completion = NULL;
+    const PolicyOps* ops = &policy_ops[policy];
+    if (stats->printers > 1 || !ops->back_to_back) {
+        *completion = malloc((size_t)count * sizeof(long long) + 1);
+        if (*completion == NULL) {
+            return 0;
+        }
+    }
+
+    // One indirect call per run; the simulator inside is specialised
+    uint64_t started = traceStart();
+    int shards = shardsInEffect(policy, stats->printers);
+    int ok = (shards > 1)
+        ? scheduleSharded(jobs, count, policy, shards, shard_stealing, order,
+                          *completion, stats)
+        : ops->schedule(jobs, count, order, *completion, stats);
+    arenaReset(runArena()); // The run's scratch, all at once
+    if (!ok) {
+        free(*completion);
+        *completion = NULL;
+    }
+    traceEnd(TRACE_SIMULATE, policy, count, started);
+    return ok;
+}
+
+/**
+ * @brief Runs the simulation engine for one policy without printing
+ * anything. Safe to call from several threads at once on the same jobs.
+ * With --setup-cost or --coalesce the jobs are printed in runs that pay
+ * the setup (see runCoalescedPolicy()).
+ *
+ * @param jobs The jobs to schedule (not modified).
+ * @param count The number of jobs.
+ * @param policy The dispatch policy.
+ * @param order Output array with room for `count` jobs.
+ * @param completion Output: set to a malloc'd array of completion times
+ * when the run needs one (several printers, preemption or setup costs),
+ * else NULL. The caller frees it.
+ * @param stats In: the printer count. Out: the run's statistics.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int runPolicy(const PrintJob jobs[], int count, SchedPolicy policy,
+              PrintJob order[], long long** completion, SimStats* stats) {
+    if (setup_cost > 0 || coalesce_pages > 0) {
+        return runCoalescedPolicy(jobs, count, policy, coalesce_pages, order,
+                                  completion, stats, NULL);
+    }
+    return scheduleRun(jobs, count, policy, order, completion, stats);
+}
+
+// --- Setup Costs and Coalescing ---
+
+/**
+ * @brief Runs `policy` on printers that spend `setup_cost` before every
+ * run they print, coalescing small jobs into shared runs.
+ *
+ * Jobs of at most `max_pages` pages (none when 0) in a known priority
+ * class are held: the first opens a batch for its class that is released
+ * coalesce_window time units later, and every job of that class and size
+ * arriving by then joins it. The policy then schedules the runs - each
+ * batch, and every other job on its own, as one job of its pages plus
+ * the setup - and the members of a batch print in arrival order after
+ * its setup. A preempted run is not charged the setup again; that is
+ * what --switch-cost models.
+ *
+ * The jobs come back in `order` with their own completion times, so the
+ * metrics are per job; the printer counts in `stats` are of runs.
+ *
+ * @param made Output, if not NULL: how the jobs were grouped into runs.
+ * @return 1 on success, 0 if out of memory or a run's pages or release
+ * time would overflow an int.
+ */
+int runCoalescedPolicy(const PrintJob jobs[], int count, SchedPolicy policy,
+                       int max_pages, PrintJob order[], long long** completion,
+                       SimStats* stats, CoalesceStats* made) {
+    *completion = NULL;
+    size_t n = (size_t)count + 1;
+    PrintJob* arrivals = malloc(n * sizeof(PrintJob));   // The jobs, FCFS
+    int* run_of = malloc(n * sizeof(int));                // Run of arrivals[i]
+    PrintJob* runs = malloc(n * sizeof(PrintJob));        // Run r has job_id r + 1
+    PrintJob* run_order = malloc(n * sizeof(PrintJob));
+    int* first = malloc((n + 1) * sizeof(int));           // Run r's members are
+    int* members = malloc(n * sizeof(int));               // members[first[r]..first[r + 1])
+    long long* finished = malloc(n * sizeof(long long));  // Completion of run r
+    long long* done = malloc(n * sizeof(long long));
+    long long* run_completion = NULL;
+    int ok = (arrivals != NULL && run_of != NULL && runs != NULL && run_order != NULL &&
+              first != NULL && members != NULL && finished != NULL && done != NULL);
+
+    int run_count = 0;
+    if (ok) {
+        memcpy(arrivals, jobs, (size_t)count * sizeof(PrintJob));
+        if (!jobsInOrder(POLICY_FCFS, arrivals, count)) {
+            sortJobsByArrival(arrivals, count);
+        }
+        int open[PRIORITY_CLASSES + 1]; // The batch each class is filling, or -1
+        for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+            open[c] = -1;
+        }
+        for (int i = 0; ok && i < count; i++) {
+            const PrintJob* job = &arrivals[i];
+            int cls = job->priority;
+            int small = (job->page_count <= max_pages && cls >= 1 && cls <= PRIORITY_CLASSES);
+            int r = small ? open[cls] : -1;
+            if (r >= 0 && job->arrival_time <= runs[r].arrival_time &&
+                runs[r].page_count <= INT_MAX - job->page_count) {
+                runs[r].page_count += job->page_count;
+            } else {
+                long long release = job->arrival_time + (small ? (long long)coalesce_window : 0);
+                if (release > INT_MAX || job->page_count > INT_MAX - setup_cost) {
+                    ok = 0;
+                    break;
+                }
+                r = run_count++;
+                runs[r].job_id = r + 1;
+                runs[r].page_count = setup_cost + job->page_count;
+                runs[r].priority = cls;
+                runs[r].arrival_time = (int)release;
+                if (small) {
+                    open[cls] = r;
+                }
+            }
+            run_of[i] = r;
+        }
+    }
+
+    if (ok) {
+        // Group the members by run, each run's in arrival order: count
+        // them, take where each run ends, then fill every run from its end
+        memset(first, 0, ((size_t)run_count + 1) * sizeof(int));
+        for (int i = 0; i < count; i++) {
+            first[run_of[i]]++;
+        }
+        for (int r = 1; r < run_count; r++) {
+            first[r] += first[r - 1];
+        }
+        first[run_count] = count;
+        for (int i = count - 1; i >= 0; i--) {
+            members[--first[run_of[i]]] = i;
+        }
+        if (made != NULL) {
+            made->runs = run_count;
+            made->batches = 0;
+            made->batched_jobs = 0;
+            for (int r = 0; r < run_count; r++) {
+                int size = first[r + 1] - first[r];
+                if (size > 1) {
+                    made->batches++;
+                    made->batched_jobs += size;
+                }
+            }
+        }
+        ok = scheduleRun(runs, run_count, policy, run_order, &run_completion, stats);
+    }
+
+    if (ok) {
+        if (run_completion == NULL) {
+            // Back to back on one printer; scheduleRun() leaves the clock to us
+            long long clock = 0;
+            for (int k = 0; k < run_count; k++) {
+                const PrintJob* run = &run_order[k];
+                clock = (clock > run->arrival_time ? clock : run->arrival_time) +
+                        run->page_count;
+                finished[run->job_id - 1] = clock;
+                stats->busy_time[0] += run->page_count;
+            }
+            stats->jobs_printed[0] = run_count;
+            stats->makespan = clock;
+        } else {
+            for (int k = 0; k < run_count; k++) {
+                finished[run_order[k].job_id - 1] = run_completion[k];
+            }
+        }
+
+        // Each member finishes before the pages of the members after it
+        int k = 0;
+        for (int q = 0; q < run_count; q++) {
+            int r = run_order[q].job_id - 1;
+            long long after = runs[r].page_count - setup_cost;
+            for (int m = first[r]; m < first[r + 1]; m++) {
+                const PrintJob* job = &arrivals[members[m]];
+                after -= job->page_count;
+                order[k] = *job;
+                done[k] = finished[r] - after;
+                k++;
+            }
+        }
+        *completion = done;
+        done = NULL;
+    }
+
+    free(arrivals);
+    free(run_of);
+    free(runs);
+    free(run_order);
+    free(first);
+    free(members);
+    free(finished);
+    free(done);
+    free(run_completion);
+    return ok;
+}
+
+/**
+ * @brief Prints what coalescing bought in a run of `policy` on `jobs`:
+ * the printer runs it saved, and the makespan, throughput and average
+ * wait against printing every job on its own with the same setup cost.
+ *
+ * @param made, stats, result The coalesced run's grouping and outcome.
+ */
+static void reportCoalescing(const PrintJob jobs[], int count, SchedPolicy policy,
+                             const CoalesceStats* made, const SimStats* stats,
+                             const SimResult* result) {
+    SimStats alone;
+    initSimStats(&alone, stats->printers);
+    PrintJob* order = malloc((size_t)count * sizeof(PrintJob) + 1);
+    long long* completion = NULL;
+    if (order == NULL ||
+        !runCoalescedPolicy(jobs, count, policy, 0, order, &completion, &alone, NULL)) {
+        printf("Error: Out of memory. Cannot compare against uncoalesced printing.\n");
+        free(order);
+        return;
+    }
+    SimResult alone_result;
+    summarizeRun(order, completion, count, &alone, &alone_result, NULL);
+    free(order);
+    free(completion);
+
+    double alone_rate = alone.makespan > 0 ? (double)count / alone.makespan : 0.0;
+    double rate = stats->makespan > 0 ? (double)count / stats->makespan : 0.0;
+    printf("Coalescing:               %d jobs in %d runs (%d batches of %d jobs),\n"
+           "                          %lld time units of setup saved\n",
+           count, made->runs, made->batches, made->batched_jobs,
+           (long long)(count - made->runs) * setup_cost);
+    printf("  Printed one by one:     makespan %lld, %.4f jobs per time unit, "
+           "avg wait %.2f\n", alone.makespan, alone_rate, alone_result.avg_wait_time);
+    printf("  Coalesced:              makespan %lld, %.4f jobs per time unit "
+           "(%+.2f%%), avg wait %.2f (%+.2f)\n",
+           stats->makespan, rate, alone_rate > 0.0 ? 100.0 * (rate / alone_rate - 1.0) : 0.0,
+           result->avg_wait_time, result->avg_wait_time - alone_result.avg_wait_time);
+}
+
+// --- Spooler Daemon ---
+
+static void stopDaemon(int signal_number) {
+    (void)signal_number;
+    daemon_stop = 1;
+}
+
+static int setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/**
+ * @brief Opens a non-blocking listening socket on `endpoint`: a Unix
+ * socket if it contains a '/', otherwise TCP on [HOST:]PORT with HOST
+ * defaulting to 127.0.0.1. A stale Unix socket at the path is replaced.
+ * @param is_unix Output: 1 for a Unix socket, which the caller unlinks.
+ * @return The socket, or -1 after printing an error.
+ */
+int openListenSocket(const char* endpoint, int* is_unix) {
+    *is_unix = (strchr(endpoint, '/') != NULL);
+    if (*is_unix) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(endpoint) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Error: Socket path '%s' is too long.\n", endpoint);
+            return -1;
+        }
+        strcpy(addr.sun_path, endpoint);
+
+        struct stat info;
+        if (stat(endpoint, &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(endpoint);
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd)) {
+            fprintf(stderr, "Error: Cannot listen on '%s'.\n", endpoint);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
+
+    char host[256] = "127.0.0.1";
+    const char* port = endpoint;
+    const char* colon = strrchr(endpoint, ':');
+    if (colon != NULL) {
+        size_t length = (size_t)(colon - endpoint);
+        if (length >= sizeof(host)) {
+            fprintf(stderr, "Error: Host name in '%s' is too long.\n", endpoint);
+            return -1;
+        }
+        if (length > 0) {
+            memcpy(host, endpoint, length);
+            host[length] = '\0';
+        }
+        port = colon + 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* found;
+    if (getaddrinfo(host, port, &hints, &found) != 0) {
+        fprintf(stderr, "Error: Cannot resolve '%s'.\n", endpoint);
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* a = found; a != NULL && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) != 0 ||
+            listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot listen on '%s'.\n", endpoint);
+    }
+    return fd;
+}
+
+/**
+ * @brief Makes room for `length` more bytes of replies to `conn`.
+ * @return Where they go (the caller then adds them to out_length), or
+ * NULL if out of memory, which hangs up on the client.
+ */
+static char* reserveReply(DaemonConn* conn, size_t length) {
+    if (conn->out_length + length > conn->out_capacity) {
+        size_t capacity = conn->out_capacity > 0 ? conn->out_capacity : 4096;
+        while (capacity < conn->out_length + length) {
+            capacity *= 2;
+        }
+        char* grown = realloc(conn->out, capacity);
+        if (grown == NULL) {
+            conn->closing = 1;
+            return NULL;
+        }
+        conn->out = grown;
+        conn->out_capacity = capacity;
+    }
+    return conn->out + conn->out_length;
+}
+
+/**
+ * @brief Queues one formatted reply line on `conn`. On running out of
+ * memory the connection is marked to close instead.
+ */
+static void daemonReply(DaemonConn* conn, const char* format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length > sizeof(line) - 2) {
+        length = (int)sizeof(line) - 2; // Replies are short; never expected
+    }
+    line[length++] = '\n';
+
+    char* out = reserveReply(conn, (size_t)length);
+    if (out != NULL) {
+        memcpy(out, line, (size_t)length);
+        conn->out_length += (size_t)length;
+    }
+}
+
+static void closeConnection(int epoll_fd, DaemonConn* conn) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        daemon_conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    daemon_stats.open_connections--;
+
+    // Keep the connection, and buffers of ordinary size, for the next
+    // client, so reconnecting clients cost no allocations
+    if (daemon_free_count == DAEMON_FREE_CONNS) {
+        free(conn->in);
+        free(conn->out);
+        free(conn);
+        return;
+    }
+    char* in = conn->in;
+    size_t in_capacity = conn->in_capacity;
+    if (in_capacity > 2 * DAEMON_READ_CHUNK) {
+        free(in);
+        in = NULL;
+        in_capacity = 0;
+    }
+    char* out = conn->out;
+    size_t out_capacity = conn->out_capacity;
+    if (out_capacity > 2 * DAEMON_READ_CHUNK) {
+        free(out);
+        out = NULL;
+        out_capacity = 0;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->in = in;
+    conn->in_capacity = in_capacity;
+    conn->out = out;
+    conn->out_capacity = out_capacity;
+    conn->next = daemon_free_conns;
+    daemon_free_conns = conn;
+    daemon_free_count++;
+}
+
+// A cleared connection, reused from daemon_free_conns when possible
+static DaemonConn* newConnection() {
+    DaemonConn* conn = daemon_free_conns;
+    if (conn == NULL) {
+        return calloc(1, sizeof(DaemonConn));
+    }
+    daemon_free_conns = conn->next;
+    daemon_free_count--;
+    conn->next = NULL;
+    return conn;
+}
+
+// Frees the connections kept for reuse, when the daemon stops
+static void freeConnectionCache() {
+    while (daemon_free_conns != NULL) {
+        DaemonConn* conn = daemon_free_conns;
+        daemon_free_conns = conn->next;
+        free(conn->in);
+        free(conn->out);
+        free(conn);
+    }
+    daemon_free_count = 0;
+}
+
+/**
+ * @brief Writes as much of the queued replies as the socket takes, and
+ * waits for EPOLLOUT only while something is left over.
+ * @return 1 if the connection stays open, 0 if it was closed.
+ */
+static int flushReplies(int epoll_fd, DaemonConn* conn) {
+    while (conn->out_sent < conn->out_length) {
+        ssize_t sent = send(conn->fd, conn->out + conn->out_sent,
+                            conn->out_length - conn->out_sent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            closeConnection(epoll_fd, conn);
+            return 0;
+        }
+        conn->out_sent += (size_t)sent;
+    }
+
+    int pending = (conn->out_sent < conn->out_length);
+    if (!pending) {
+        conn->out_length = conn->out_sent = 0;
+        if (conn->closing) {
+            closeConnection(epoll_fd, conn);
+            return 0;
+        }
+    }
+    if (pending != conn->writing) {
+        struct epoll_event event;
+        event.events = EPOLLIN | (pending ? EPOLLOUT : 0);
+        event.data.ptr = conn;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+        conn->writing = pending;
+    }
+    return 1;
+}
+
+/**
+ * @brief Accepts every pending connection on `listen_fd`.
+ */
+static void acceptConnections(int epoll_fd, int listen_fd) {
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return; // EAGAIN once the backlog is empty; errors are retried later
+        }
+        DaemonConn* conn = newConnection();
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        if (conn == NULL || !setNonBlocking(fd) ||
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            if (conn != NULL) {
+                free(conn->in);
+                free(conn->out);
+                free(conn);
+            }
+            close(fd);
+            continue;
+        }
+        // Replies are single small writes; don't hold them back (fails
+        // harmlessly on Unix sockets)
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        conn->fd = fd;
+        conn->next = daemon_conns;
+        if (daemon_conns != NULL) {
+            daemon_conns->prev = conn;
+        }
+        daemon_conns = conn;
+        daemon_stats.connections++;
+        daemon_stats.open_connections++;
+    }
+}
+
+// 1 if the `length` bytes at `word` spell `name`
+static int wordIs(const char* word, size_t length, const char* name) {
+    return strlen(name) == length && memcmp(word, name, length) == 0;
+}
+
+/**
+ * @brief Reads the space-terminated word at `*cursor` and skips the
+ * blanks after it.
+ * @return The word's length.
+ */
+static size_t takeWord(const char** cursor, const char* end) {
+    const char* p = *cursor;
+    while (p < end && *p != ' ') {
+        p++;
+    }
+    size_t length = (size_t)(p - *cursor);
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    *cursor = p;
+    return length;
+}
+
+// The policy whose key is the next word, or -1 if none is
+static int takePolicyKey(const char** cursor, const char* end) {
+    const char* word = *cursor;
+    size_t length = takeWord(cursor, end);
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (wordIs(word, length, policy_ops[k].key)) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Queues a SUBMIT batch of PAGES,PRIORITY[,ARRIVAL] jobs separated
+ * by spaces. The batch is accepted whole or not at all, and its jobs get
+ * consecutive ids, so the reply is just the first id and the count.
+ */
+static void submitBatch(DaemonConn* conn, const char* cursor, const char* end) {
+    HotCounters* counters = hotCounters();
+    int count = 0;
+    while (cursor < end) {
+        PrintJob job = { 0, 0, 0, 0 };
+        int ok = parseTraceField(&cursor, end, &job.page_count) &&
+                 cursor < end && *cursor++ == ',' &&
+                 parseTraceField(&cursor, end, &job.priority);
+        if (ok && cursor < end && *cursor == ',') {
+            cursor++;
+            ok = parseTraceField(&cursor, end, &job.arrival_time);
+        }
+        // Jobs are separated by blanks, which parseTraceField skips
+        if (!ok || (cursor < end && cursor[-1] != ' ' && cursor[-1] != '\t')) {
+            daemonReply(conn, "ERR malformed job %d", count + 1);
+            daemon_stats.rejected_batches++;
+            counterAdd(counters, &counters->rejected, 1);
+            return;
+        }
+        if (job.page_count <= 0 || job.priority <= 0) {
+            daemonReply(conn, "ERR job %d: page count and priority must be positive",
+                        count + 1);
+            daemon_stats.rejected_batches++;
+            counterAdd(counters, &counters->rejected, 1);
+            return;
+        }
+        if (!reserveJobs(&daemon_batch, &daemon_batch_capacity, count + 1)) {
+            daemonReply(conn, "ERR out of memory");
+            return;
+        }
+        daemon_batch[count++] = job;
+    }
+    if (count == 0) {
+        daemonReply(conn, "ERR empty batch");
+        return;
+    }
+
+    // With the store and heaps sized up front, storeJob cannot fail
+    // part-way through the batch
+    if (count > INT_MAX - job_store_size ||
+        !reserveJobs(&job_queue, &job_capacity, job_store_size + count) ||
+        (heaps_ready && !reserveSchedulingHeaps(job_capacity))) {
+        daemonReply(conn, "ERR out of memory");
+        daemon_stats.rejected_batches++;
+        counterAdd(counters, &counters->rejected, 1);
+        return;
+    }
+    int first_id = atomic_fetch_add(&next_job_id, count);
+    deferQueueCounters();
+    for (int i = 0; i < count; i++) {
+        daemon_batch[i].job_id = first_id + i;
+        storeJob(&daemon_batch[i]);
+    }
+    publishQueueCounters();
+    daemon_stats.jobs_submitted += count;
+    counterAdd(counters, &counters->submitted, count);
+    daemonReply(conn, "OK %d %d", first_id, count);
+}
+
+static void replyStats(DaemonConn* conn) {
+    const DaemonStats* d = &daemon_stats;
+    char waits[256] = "";
+    size_t used = 0;
+    for (int k = 0; k < ONLINE_POLICY_COUNT; k++) {
+        double avg_wait, avg_turnaround;
+        if (!runningAverages((SchedPolicy)k, &avg_wait, &avg_turnaround)) {
+            break; // Keys too large to track, or out of memory
+        }
+        used += (size_t)snprintf(waits + used, sizeof(waits) - used,
+                                 " wait_%s=%.2f", policy_ops[k].key, avg_wait);
+    }
+    if (journal.fd >= 0) {
+        snprintf(waits + used, sizeof(waits) - used, " journal_commits=%lld journal_syncs=%lld",
+                 journal.commits, journal.syncs);
+    }
+    HotTotals totals;
+    sumHotCounters(&totals);
+    QueueView view;
+    readQueueCounters(&view);
+    daemonReply(conn, "OK depth=%d pages=%lld epoch=%llu submitted=%lld rejected_batches=%lld "
+                "dispatched=%lld cancelled=%lld dumps=%lld connections=%d accepted=%lld "
+                "requests=%lld handle_us_avg=%.2f "
+                "handle_us_max=%.2f depth_high=%d sort_ms=%.3f metrics_ms=%.3f%s",
+                view.depth, view.pages, view.epoch, d->jobs_submitted, d->rejected_batches,
+                d->jobs_dispatched, d->jobs_cancelled, d->dumps, d->open_connections,
+                d->connections, d->requests,
+                d->requests > 0 ? d->handle_time / d->requests * 1e6 : 0.0,
+                d->handle_max * 1e6, totals.depth_high, totals.sort_ns / 1e6,
+                totals.metrics_ns / 1e6, waits);
+}
+
+/**
+ * @brief Simulates the live queue under `policy` on the configured
+ * printers and replies with the run's summary. Runs on the event loop,
+ * so other clients wait for it.
+ */
+static void replySimulation(DaemonConn* conn, SchedPolicy policy) {
+    if (job_count == 0) {
+        daemonReply(conn, "EMPTY");
+        return;
+    }
+    compactJobQueue();
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+    PrintJob* order = getScratchQueue(job_count);
+    long long* completion = NULL;
+    if (order == NULL ||
+        !runPolicy(job_queue, job_count, policy, order, &completion, &stats)) {
+        daemonReply(conn, "ERR out of memory");
+        return;
+    }
+    SimResult result;
+    summarizeRun(order, completion, job_count, &stats, &result, NULL);
+    free(completion);
+    daemonReply(conn, "OK jobs=%d avg_wait=%.2f avg_turnaround=%.2f max_wait=%lld "
+                "makespan=%lld utilization=%.2f preemptions=%d",
+                job_count, result.avg_wait_time, result.avg_turnaround_time,
+                result.max_wait_time, result.makespan, result.utilization,
+                result.preemptions);
+}
+
+/**
+ * @brief Handles JOB ID (a lookup), CANCEL ID and PRIORITY ID P, each
+ * O(1) to find the job and at most O(log n) to update it, and replies
+ * with the job as DISPATCH does.
+ */
+static void replyJobUpdate(DaemonConn* conn, const char* word, size_t word_length,
+                           const char* cursor, const char* end) {
+    int job_id = 0;
+    int priority = 0;
+    int is_priority = wordIs(word, word_length, "PRIORITY");
+    if (!parseTraceField(&cursor, end, &job_id) ||
+        (is_priority && !parseTraceField(&cursor, end, &priority)) || cursor != end) {
+        daemonReply(conn, is_priority ? "ERR usage: PRIORITY ID P"
+                                      : "ERR usage: %.*s ID", (int)word_length, word);
+        return;
+    }
+    if (is_priority && priority <= 0) {
+        daemonReply(conn, "ERR priority must be positive");
+        return;
+    }
+
+    PrintJob job;
+    int found;
+    if (is_priority) {
+        found = reprioritizeJob(job_id, priority, &job);
+    } else if (wordIs(word, word_length, "CANCEL")) {
+        found = cancelJob(job_id, &job);
+        daemon_stats.jobs_cancelled += (found > 0);
+    } else {
+        found = findJob(job_id);
+        if (found >= 0) {
+            job = job_queue[found];
+        }
+        found = (found == -1) ? 0 : (found < -1 ? -1 : 1);
+    }
+    if (found < 0) {
+        daemonReply(conn, "ERR out of memory");
+    } else if (found == 0) {
+        daemonReply(conn, "ERR no job %d", job_id);
+    } else {
+        daemonReply(conn, "OK %d %d %d %d", job.job_id, job.page_count,
+                    job.priority, job.arrival_time);
+    }
+}
+
+// Reads a QUEUE cursor, a position of 1 or more, as the next word
+static int takeQueueCursor(const char** cursor, const char* end, long long* position) {
+    const char* word = *cursor;
+    size_t length = takeWord(cursor, end);
+    if (length == 0 || length > 18) {
+        return 0;
+    }
+    long long value = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (word[i] < '0' || word[i] > '9') {
+            return 0;
+        }
+        value = value * 10 + (word[i] - '0');
+    }
+    *position = value;
+    return value > 0;
+}
+
+/**
+ * @brief Handles QUEUE [N [FROM POS]]: a header line, then up to N
+ * (default QUEUE_PAGE_DEFAULT) queued jobs in queue order from the head
+ * or from cursor POS, one "id pages priority arrival" line each. The
+ * header carries the counters and epoch of the same instant, and `next`,
+ * the cursor for the following page (0 at the end), which stays usable
+ * however many jobs are dispatched or cancelled in between. A page
+ * costs its own jobs whatever the depth of the queue.
+ */
+static void replyQueuePage(DaemonConn* conn, const char* cursor, const char* end) {
+    int limit = QUEUE_PAGE_DEFAULT;
+    long long from = 0;
+    int ok = (cursor == end || parseTraceField(&cursor, end, &limit));
+    if (ok && cursor < end) {
+        const char* word = cursor;
+        size_t length = takeWord(&cursor, end);
+        ok = wordIs(word, length, "FROM") && takeQueueCursor(&cursor, end, &from);
+    }
+    if (!ok || cursor != end || limit < 1 || limit > QUEUE_PAGE_MAX) {
+        daemonReply(conn, "ERR usage: QUEUE [N [FROM POS]], N from 1 to %d", QUEUE_PAGE_MAX);
+        return;
+    }
+
+    PrintJob* page = getScratchQueue(limit);
+    if (page == NULL) {
+        daemonReply(conn, "ERR out of memory");
+        return;
+    }
+    long long next = 0;
+    QueueView view;
+    int shown = snapshotQueue(from, page, limit, &next, &view);
+    daemonReply(conn, "OK epoch=%llu depth=%d pages=%lld shown=%d next=%lld",
+                view.epoch, view.depth, view.pages, shown, next);
+    char* out = reserveReply(conn, (size_t)shown * 48); // A line takes at most 48 bytes
+    if (out == NULL) {
+        return;
+    }
+    char* p = out;
+    for (int i = 0; i < shown; i++) {
+        const PrintJob* job = &page[i];
+        p = formatLongLong(p, job->job_id);
+        *p++ = ' ';
+        p = formatLongLong(p, job->page_count);
+        *p++ = ' ';
+        p = formatLongLong(p, job->priority);
+        *p++ = ' ';
+        p = formatLongLong(p, job->arrival_time);
+        *p++ = '\n';
+    }
+    conn->out_length += (size_t)(p - out);
+}
+
+// 1 if the `length` bytes at `name` are a plain file name: no '/', no
+// "..", no NUL and not ".", so a DUMP cannot leave --dump-dir
+static int isDumpName(const char* name, size_t length) {
+    if (length == 0 || (length == 1 && name[0] == '.')) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (name[i] == '/' || name[i] == '\0' ||
+            (name[i] == '.' && i + 1 < length && name[i + 1] == '.')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Handles DUMP NAME: writes the whole live queue as a binary
+ * trace to NAME in --dump-dir from a forked child, so the event loop
+ * goes on serving while a queue of any depth is written. Clients name a
+ * file, never a path, so they can only write inside the directory the
+ * operator chose. The child works on the kernel's copy-on-write image
+ * of this instant: it compacts its copy, writes NAME.tmp and renames
+ * that over NAME, so NAME only ever holds a whole dump. Finished
+ * children are reaped on the next DUMP and at shutdown.
+ */
+static void replyDump(DaemonConn* conn, const char* cursor, const char* end) {
+    while (waitpid(-1, NULL, WNOHANG) > 0) {
+        // Reap the dumps that have finished
+    }
+    if (dump_dir == NULL) {
+        daemonReply(conn, "ERR DUMP is off; start the daemon with --dump-dir");
+        return;
+    }
+    char path[4096];
+    char temp[sizeof(path) + 4];
+    size_t length = (size_t)(end - cursor);
+    if (!isDumpName(cursor, length)) {
+        daemonReply(conn, "ERR usage: DUMP NAME, a file name without '/' or '..'");
+        return;
+    }
+    int written = snprintf(path, sizeof(path), "%s/%.*s", dump_dir, (int)length, cursor);
+    if (written < 0 || (size_t)written >= sizeof(path)) {
+        daemonReply(conn, "ERR dump name too long");
+        return;
+    }
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    QueueView view;
+    readQueueCounters(&view);
+    pid_t child = fork();
+    if (child < 0) {
+        daemonReply(conn, "ERR cannot fork: %s", strerror(errno));
+        return;
+    }
+    if (child == 0) {
+        compactJobQueue();
+        int ok = writeBinaryTrace(temp, job_queue, job_count) && rename(temp, path) == 0;
+        if (!ok) {
+            unlink(temp);
+        }
+        _exit(ok ? 0 : 1);
+    }
+    daemon_stats.dumps++;
+    daemonReply(conn, "OK epoch=%llu depth=%d dumping to %s (pid %d)",
+                view.epoch, view.depth, path, (int)child);
+}
+
+/**
+ * @brief Handles one request line (without its newline) from `conn` and
+ * queues the reply.
+ */
+void handleRequest(DaemonConn* conn, char* line, size_t length) {
+    const char* end = line + length;
+    const char* cursor = line;
+    while (cursor < end && *cursor == ' ') {
+        cursor++;
+    }
+    const char* word = cursor;
+    size_t word_length = takeWord(&cursor, end);
+
+    if (wordIs(word, word_length, "SUBMIT")) {
+        submitBatch(conn, cursor, end);
+    } else if (wordIs(word, word_length, "DISPATCH")) {
+        int policy = (cursor == end) ? POLICY_FCFS : takePolicyKey(&cursor, end);
+        PrintJob job;
+        if (policy < 0 || policy >= ONLINE_POLICY_COUNT) {
+            daemonReply(conn, "ERR dispatch takes fcfs, sjf or priority");
+        } else if (job_count == 0) {
+            daemonReply(conn, "EMPTY");
+        } else if (!dispatchJob((SchedPolicy)policy, &job)) {
+            daemonReply(conn, "ERR out of memory");
+        } else {
+            daemon_stats.jobs_dispatched++;
+            daemonReply(conn, "OK %d %d %d %d", job.job_id, job.page_count,
+                        job.priority, job.arrival_time);
+        }
+    } else if (wordIs(word, word_length, "JOB") || wordIs(word, word_length, "CANCEL") ||
+               wordIs(word, word_length, "PRIORITY")) {
+        replyJobUpdate(conn, word, word_length, cursor, end);
+    } else if (wordIs(word, word_length, "SIMULATE")) {
+        int policy = takePolicyKey(&cursor, end);
+        if (policy < 0) {
+            daemonReply(conn, "ERR unknown policy");
+        } else {
+            replySimulation(conn, (SchedPolicy)policy);
+        }
+    } else if (wordIs(word, word_length, "STATS")) {
+        replyStats(conn);
+    } else if (wordIs(word, word_length, "QUEUE")) {
+        replyQueuePage(conn, cursor, end);
+    } else if (wordIs(word, word_length, "DUMP")) {
+        replyDump(conn, cursor, end);
+    } else if (wordIs(word, word_length, "QUIT")) {
+        daemonReply(conn, "OK bye");
+        conn->closing = 1;
+    } else if (wordIs(word, word_length, "SHUTDOWN")) {
+        daemonReply(conn, "OK shutting down");
+        daemon_stop = 1;
+    } else if (word_length > 0) {
+        daemonReply(conn, "ERR unknown command");
+    }
+}
+
+/**
+ * @brief Reads one chunk from `conn` and handles every complete line in
+ * it. Reading a single chunk per event keeps one busy client from
+ * starving the rest. The replies are sent once the wakeup's journal
+ * records are committed; until then `conn` waits on daemon_flush_list.
+ */
+static void readRequests(int epoll_fd, DaemonConn* conn) {
+    if (conn->in_capacity - conn->in_length < DAEMON_READ_CHUNK) {
+        size_t capacity = conn->in_length + DAEMON_READ_CHUNK;
+        char* grown = realloc(conn->in, capacity);
+        if (grown == NULL) {
+            closeConnection(epoll_fd, conn);
+            return;
+        }
+        conn->in = grown;
+        conn->in_capacity = capacity;
+    }
+    ssize_t got = recv(conn->fd, conn->in + conn->in_length, DAEMON_READ_CHUNK, 0);
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (got <= 0) {
+        closeConnection(epoll_fd, conn); // Hung up, or failed
+        return;
+    }
+
+    size_t scanned = conn->in_length; // No newline before the new bytes
+    conn->in_length += (size_t)got;
+    size_t consumed = 0;
+    char* newline;
+    while (!conn->closing &&
+           (newline = memchr(conn->in + scanned, '\n', conn->in_length - scanned)) != NULL) {
+        char* line = conn->in + consumed;
+        size_t length = (size_t)(newline - line);
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+        double started = nowSeconds();
+        handleRequest(conn, line, length);
+        double elapsed = nowSeconds() - started;
+        daemon_stats.requests++;
+        daemon_stats.handle_time += elapsed;
+        if (elapsed > daemon_stats.handle_max) {
+            daemon_stats.handle_max = elapsed;
+        }
+        consumed = scanned = (size_t)(newline - conn->in) + 1;
+    }
+
+    if (consumed > 0) {
+        memmove(conn->in, conn->in + consumed, conn->in_length - consumed);
+        conn->in_length -= consumed;
+    }
+    if (conn->in_length > DAEMON_MAX_LINE) {
+        daemonReply(conn, "ERR request longer than %d bytes", DAEMON_MAX_LINE);
+        conn->closing = 1;
+    }
+    if (!conn->flush_queued && (conn->out_length > conn->out_sent || conn->closing)) {
+        conn->flush_queued = 1;
+        conn->flush_next = daemon_flush_list;
+        daemon_flush_list = conn;
+    }
+}
+
+/**
+ * @brief Serves the spooler on `endpoint` until SIGINT, SIGTERM or a
+ * SHUTDOWN request. One thread runs a level-triggered epoll loop over
+ * non-blocking sockets; submitted jobs go into the live queue through
+ * storeJob, as added or drained ones do, so DISPATCH, SIMULATE and STATS
+ * see them at once.
+ * @return 0 on a clean shutdown, 1 if the socket could not be set up.
+ */
+int runDaemon(const char* endpoint) {
+    int is_unix;
+    int listen_fd = openListenSocket(endpoint, &is_unix);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL; // Marks the listening socket
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) != 0) {
+        fprintf(stderr, "Error: Cannot create the event loop.\n");
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+        close(listen_fd);
+        return 1;
+    }
+
+    struct sigaction action, old_int, old_term;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopDaemon; // No SA_RESTART, so epoll_wait wakes up
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    memset(&daemon_stats, 0, sizeof(daemon_stats));
+    daemon_stop = 0;
+    printf("Serving on %s. Stop with SIGINT, SIGTERM or SHUTDOWN.\n", endpoint);
+    fflush(stdout);
+
+    struct epoll_event events[DAEMON_MAX_EVENTS];
+    while (!daemon_stop) {
+        // An interval-synced journal still needs its sync when idle
+        int timeout = (journal.fd >= 0 && journal.unsynced) ? journal_sync_interval_ms : -1;
+        int ready = epoll_wait(epoll_fd, events, DAEMON_MAX_EVENTS, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Error: The event loop failed.\n");
+            break;
+        }
+        uint64_t started = traceStart();
+        for (int e = 0; e < ready; e++) {
+            DaemonConn* conn = events[e].data.ptr;
+            if (conn == NULL) {
+                acceptConnections(epoll_fd, listen_fd);
+            } else if (events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                // A connection closed here cannot appear again in `events`,
+                // nor be on the flush list yet: epoll reports each file
+                // descriptor once per wakeup
+                readRequests(epoll_fd, conn);
+            } else if (events[e].events & EPOLLOUT) {
+                flushReplies(epoll_fd, conn);
+            }
+        }
+
+        // Group commit: one journal write (and sync) for every request
+        // of the wakeup, before any of them is acknowledged
+        journalCommit();
+        while (daemon_flush_list != NULL) {
+            DaemonConn* conn = daemon_flush_list;
+            daemon_flush_list = conn->flush_next;
+            conn->flush_queued = 0;
+            flushReplies(epoll_fd, conn);
+        }
+        traceEnd(TRACE_DAEMON_WAKEUP, 0, ready, started);
+        traceMark(TRACE_QUEUE_DEPTH, job_count);
+    }
+
+    // Last replies (such as SHUTDOWN's) are sent on a best-effort basis
+    while (daemon_conns != NULL) {
+        DaemonConn* conn = daemon_conns;
+        conn->closing = 1;
+        if (flushReplies(epoll_fd, conn)) {
+            closeConnection(epoll_fd, conn); // The socket is full; drop the rest
+        }
+    }
+    freeConnectionCache();
+    close(epoll_fd);
+    close(listen_fd);
+    while (waitpid(-1, NULL, 0) > 0) {
+        // Let the dumps still being written finish
+    }
+    if (is_unix) {
+        unlink(endpoint);
+    }
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+
+    printf("Served %lld requests over %lld connection(s): %lld jobs submitted, "
+           "%lld dispatched, %d queued.\n", daemon_stats.requests,
+           daemon_stats.connections, daemon_stats.jobs_submitted,
+           daemon_stats.jobs_dispatched, job_count);
+    return 0;
+}
+
+// --- Latency Histograms ---
+
+// Bucket of a value: itself while exact, then the power of two and the
+// top HISTOGRAM_EXACT_BITS - 1 bits below the leading one.
+static inline int histogramBucket(long long value) {
+    if (value < (1 << HISTOGRAM_EXACT_BITS)) {
+        return value < 0 ? 0 : (int)value;
+    }
+    int exponent = 63 - __builtin_clzll((unsigned long long)value);
+    int shift = exponent - (HISTOGRAM_EXACT_BITS - 1);
+    return (1 << HISTOGRAM_EXACT_BITS) +
+           (exponent - HISTOGRAM_EXACT_BITS) * HISTOGRAM_SUB_BUCKETS +
+           (int)(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+// Largest value that falls into `bucket`
+static long long histogramBucketTop(int bucket) {
+    if (bucket < (1 << HISTOGRAM_EXACT_BITS)) {
+        return bucket;
+    }
+    int k = bucket - (1 << HISTOGRAM_EXACT_BITS);
+    int shift = k / HISTOGRAM_SUB_BUCKETS + 1;
+    long long mantissa = HISTOGRAM_SUB_BUCKETS + k % HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static inline void histogramRecord(LatencyHistogram* histogram, long long value) {
+    histogram->counts[histogramBucket(value)]++;
+    histogram->total++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+/**
+ * @brief The `q` quantile (0 < q <= 1) of the union of `n` histograms:
+ * the smallest bucket top below which at least q of the values fall,
+ * capped at the exact maximum.
+ * @return The quantile, or 0 if the histograms are empty.
+ */
+long long histogramPercentile(const LatencyHistogram* const parts[], int n, double q) {
+    long long total = 0;
+    long long max = 0;
+    for (int h = 0; h < n; h++) {
+        total += parts[h]->total;
+        if (parts[h]->max > max) {
+            max = parts[h]->max;
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+    long long rank = (long long)ceil(q * (double)total);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    long long seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        for (int h = 0; h < n; h++) {
+            seen += parts[h]->counts[b];
+        }
+        if (seen >= rank) {
+            long long top = histogramBucketTop(b);
+            return top < max ? top : max;
+        }
+    }
+    return max;
+}
+
+// Prints one row of the percentile table for the union of `parts`.
+static void printLatencyRow(const char* metric, const char* group,
+                            const LatencyHistogram* const parts[], int n) {
+    static const double quantiles[4] = { 0.50, 0.90, 0.99, 0.999 };
+    long long jobs = 0;
+    long long max = 0;
+    for (int h = 0; h < n; h++) {
+        jobs += parts[h]->total;
+        if (parts[h]->max > max) {
+            max = parts[h]->max;
+        }
+    }
+    if (jobs == 0) {
+        return;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "%s (%s)", metric, group);
+    printf("%-20s | %-9lld", label, jobs);
+    for (int k = 0; k < 4; k++) {
+        printf(" | %-10lld", histogramPercentile(parts, n, quantiles[k]));
+    }
+    printf(" | %-10lld\n", max);
+}
+
+/**
+ * @brief Prints wait and turnaround percentiles, over all jobs and per
+ * priority class.
+ */
+void printLatencyReport(const LatencyStats* latency) {
+    printf("\n%-20s | %-9s | %-10s | %-10s | %-10s | %-10s | %-10s\n",
+           "Latency", "Jobs", "p50", "p90", "p99", "p99.9", "Max");
+    printf("-------------------------------------------------------------------"
+           "-------------------------------\n");
+    for (int m = 0; m < 2; m++) {
+        const LatencyHistogram* classes = (m == 0) ? latency->wait : latency->turnaround;
+        const char* metric = (m == 0) ? "Wait" : "Turnaround";
+        const LatencyHistogram* all[PRIORITY_CLASSES + 1];
+        for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+            all[c] = &classes[c];
+        }
+        printLatencyRow(metric, "All", all, PRIORITY_CLASSES + 1);
+        for (int c = 1; c <= PRIORITY_CLASSES; c++) {
+            printLatencyRow(metric, priority_class_names[c], &all[c], 1);
+        }
+        printLatencyRow(metric, priority_class_names[0], &all[0], 1);
+    }
+    printf("Fairness (Jain's index of slowdowns): %.4f\n", jainFairness(latency));
+}
+
+/**
+ * @brief Jain's fairness index of the jobs' slowdowns (turnaround over
+ * pages): 1 when every job is slowed down alike, falling towards 1/n as
+ * a few jobs absorb all the delay.
+ * @return The index, or 1 for a run without jobs.
+ */
+double jainFairness(const LatencyStats* latency) {
+    long long jobs = 0;
+    for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+        jobs += latency->turnaround[c].total;
+    }
+    if (jobs == 0 || latency->slowdown_squares <= 0) {
+        return 1.0;
+    }
+    return latency->slowdown_sum * latency->slowdown_sum /
+           ((double)jobs * latency->slowdown_squares);
+}
+
+// --- Run Summaries ---
+
+/**
+ * @brief Computes the summary metrics of a finished run, without
+ * printing anything. Runs of PARALLEL_MIN_JOBS jobs or more, summarized
+ * outside the worker pool, are scanned across it, with the same result.
+ *
+ * @param queue The jobs in the order the run produced.
+ * @param completion Completion times matching `queue`, or NULL if the
+ * jobs printed back to back on a single printer.
+ * @param count The number of jobs.
+ * @param stats The run's statistics.
+ * @param result Output: the summary.
+ * @param latency Output: wait and turnaround histograms per priority
+ * class, or NULL to skip them (and keep the vector kernel's speed).
+ */
+void summarizeRun(const PrintJob queue[], const long long completion[], int count,
+                  const SimStats* stats, SimResult* result, LatencyStats* latency) {
+    uint64_t started = nowNanos();
+    double total_wait_time = 0;
+    double total_turnaround_time = 0;
+    long long max_wait_time = 0;
+    long long busy = 0;
+
+    if (completion == NULL && latency == NULL) {
+        // One printer, never switching: it is busy for every page
+        BackToBackTotals totals;
+        backToBackTotals(queue, count, &totals);
+        total_wait_time = totals.total_wait;
+        total_turnaround_time = totals.total_wait + totals.total_pages;
+        max_wait_time = totals.max_wait;
+        busy = (long long)totals.total_pages;
+        result->makespan = totals.clock;
+    } else {
+        if (latency != NULL) {
+            memset(latency, 0, sizeof(*latency));
+        }
+        ThreadPool* pool = parallelPool(count);
+        MetricsBlock* blocks = (pool != NULL)
+            ? scanMetricsParallel(pool, queue, completion, count, 1, latency) : NULL;
+        MetricsBlock block;
+        block.clock_out = 0; // The printer's clock when `completion` is NULL
+        for (int b = 0, lo = 0; lo < count; b++, lo += SCAN_BLOCK) {
+            if (blocks != NULL) {
+                block = blocks[b];
+            } else {
+                block.clock_in = block.clock_out;
+                summarizeBlock(queue, completion, lo,
+                               (count - lo < SCAN_BLOCK) ? count : lo + SCAN_BLOCK,
+                               &block, latency);
+            }
+            total_wait_time += (double)block.wait_sum;
+            total_turnaround_time += (double)block.turnaround_sum;
+            if (block.max_wait > max_wait_time) {
+                max_wait_time = block.max_wait;
+            }
+            busy += block.pages;
+            if (latency != NULL) {
+                latency->slowdown_sum += block.slowdown_sum;
+                latency->slowdown_squares += block.slowdown_squares;
+            }
+        }
+        free(blocks);
+        if (completion != NULL) {
+            busy = 0;
+            for (int p = 0; p < stats->printers; p++) {
+                busy += stats->busy_time[p];
+            }
+            result->makespan = stats->makespan;
+        } else {
+            result->makespan = block.clock_out;
+        }
+    }
+
+    result->avg_wait_time = count > 0 ? total_wait_time / count : 0.0;
+    result->avg_turnaround_time = count > 0 ? total_turnaround_time / count : 0.0;
+    result->max_wait_time = max_wait_time;
+    result->preemptions = stats->preemptions;
+    result->utilization = result->makespan > 0
+        ? 100.0 * busy / ((double)result->makespan * stats->printers) : 0.0;
+
+    uint64_t elapsed = nowNanos() - started;
+    HotCounters* counters = hotCounters();
+    counterAdd(counters, &counters->metrics_ns, (long long)elapsed);
+    if (trace_enabled) {
+        traceWrite(counters, TRACE_METRICS, 0, count, started, elapsed);
+    }
+}
+
+// --- Back-to-Back Metrics Kernel ---
+
+// Reference loop for one tile: the printer idles until each job arrives.
+static void backToBackTileScalar(const JobColumnTile* tile, int n, long long* clock,
+                                 long long* wait_sum, long long* max_wait) {
+    long long now = *clock;
+    long long sum = 0;
+    long long max = *max_wait;
+    for (int i = 0; i < n; i++) {
+        if (now < tile->arrival_times[i]) {
+            now = tile->arrival_times[i];
+        }
+        long long wait = now - tile->arrival_times[i];
+        sum += wait;
+        if (wait > max) {
+            max = wait;
+        }
+        now += tile->page_counts[i];
+    }
+    *clock = now;
+    *wait_sum = sum;
+    *max_wait = max;
+}
+
+/**
+ * @brief Vector loop for one tile, assuming the printer never idles in
+ * it. Then each job starts when the previous one completes, so the
+ * completion times are `clock` plus a prefix sum of the page counts,
+ * taken in-register, and wait = completion - pages - arrival reduces
+ * into 64-bit sum and max lanes.
+ * @return 1 on success, 0 (outputs untouched) if some job arrives after
+ * its computed start, i.e. the printer does idle in this tile.
+ */
+static int backToBackTileSimd(const JobColumnTile* tile, int n, long long* clock,
+                              long long* wait_sum, long long* max_wait) {
+    const int* pages = tile->page_counts;
+    const int* arrivals = tile->arrival_times;
+    long long max_lanes[4] = { 0, 0, 0, 0 };
+    long long sum_lanes[4] = { 0, 0, 0, 0 };
+    long long negative = 0; // Sign bit set once any wait came out negative
+    long long now = *clock;
+    int i = 0;
+
+#if defined(METRICS_SIMD_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i carry = _mm256_set1_epi64x(now);
+    __m256i sums = zero, maxes = zero, negs = zero;
+    for (; i + 4 <= n; i += 4) {
+        __m256i p = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)&pages[i]));
+        __m256i a = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)&arrivals[i]));
+        // Inclusive prefix sum across the four lanes in two shifted adds
+        __m256i t = _mm256_add_epi64(p, _mm256_blend_epi32(
+            _mm256_permute4x64_epi64(p, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+        t = _mm256_add_epi64(t, _mm256_blend_epi32(
+            _mm256_permute4x64_epi64(t, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+        __m256i done = _mm256_add_epi64(t, carry);
+        __m256i wait = _mm256_sub_epi64(_mm256_sub_epi64(done, p), a);
+        carry = _mm256_permute4x64_epi64(done, _MM_SHUFFLE(3, 3, 3, 3));
+        sums = _mm256_add_epi64(sums, wait);
+        maxes = _mm256_blendv_epi8(maxes, wait, _mm256_cmpgt_epi64(wait, maxes));
+        negs = _mm256_or_si256(negs, wait);
+    }
+    _mm256_storeu_si256((__m256i*)sum_lanes, sums);
+    _mm256_storeu_si256((__m256i*)max_lanes, maxes);
+    long long neg_lanes[4];
+    _mm256_storeu_si256((__m256i*)neg_lanes, negs);
+    negative = neg_lanes[0] | neg_lanes[1] | neg_lanes[2] | neg_lanes[3];
+    now = _mm256_extract_epi64(carry, 0);
+#elif defined(METRICS_SIMD_SSE42)
+    __m128i carry = _mm_set1_epi64x(now);
+    __m128i sums = _mm_setzero_si128(), maxes = sums, negs = sums;
+    for (; i + 2 <= n; i += 2) {
+        __m128i p = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i*)&pages[i]));
+        __m128i a = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i*)&arrivals[i]));
+        __m128i done = _mm_add_epi64(_mm_add_epi64(p, _mm_slli_si128(p, 8)), carry);
+        __m128i wait = _mm_sub_epi64(_mm_sub_epi64(done, p), a);
+        carry = _mm_unpackhi_epi64(done, done);
+        sums = _mm_add_epi64(sums, wait);
+        maxes = _mm_blendv_epi8(maxes, wait, _mm_cmpgt_epi64(wait, maxes));
+        negs = _mm_or_si128(negs, wait);
+    }
+    _mm_storeu_si128((__m128i*)sum_lanes, sums);
+    _mm_storeu_si128((__m128i*)max_lanes, maxes);
+    long long neg_lanes[2];
+    _mm_storeu_si128((__m128i*)neg_lanes, negs);
+    negative = neg_lanes[0] | neg_lanes[1];
+    now = _mm_cvtsi128_si64(carry);
+#elif defined(METRICS_SIMD_NEON)
+    const int64x2_t zero = vdupq_n_s64(0);
+    int64x2_t carry = vdupq_n_s64(now);
+    int64x2_t sums = zero, maxes = zero, negs = zero;
+    for (; i + 2 <= n; i += 2) {
+        int64x2_t p = vmovl_s32(vld1_s32(&pages[i]));
+        int64x2_t a = vmovl_s32(vld1_s32(&arrivals[i]));
+        int64x2_t done = vaddq_s64(vaddq_s64(p, vextq_s64(zero, p, 1)), carry);
+        int64x2_t wait = vsubq_s64(vsubq_s64(done, p), a);
+        carry = vdupq_laneq_s64(done, 1);
+        sums = vaddq_s64(sums, wait);
+        maxes = vbslq_s64(vcgtq_s64(wait, maxes), wait, maxes);
+        negs = vorrq_s64(negs, wait);
+    }
+    vst1q_s64(sum_lanes, sums);
+    vst1q_s64(max_lanes, maxes);
+    negative = vgetq_lane_s64(negs, 0) | vgetq_lane_s64(negs, 1);
+    now = vgetq_lane_s64(carry, 0);
+#endif
+
+    // Leftover jobs, and the whole tile without vector support
+    long long total = sum_lanes[0] + sum_lanes[1] + sum_lanes[2] + sum_lanes[3];
+    long long max = *max_wait;
+    for (int lane = 0; lane < 4; lane++) {
+        if (max_lanes[lane] > max) {
+            max = max_lanes[lane];
+        }
+    }
+    for (; i < n; i++) {
+        long long wait = now - arrivals[i];
+        negative |= wait;
+        total += wait;
+        if (wait > max) {
+            max = wait;
+        }
+        now += pages[i];
+    }
+    if (negative < 0) {
+        return 0;
+    }
+    *clock = now;
+    *wait_sum = total;
+    *max_wait = max;
+    return 1;
+}
+
+// Back-to-back totals of queue[lo..hi) from block->clock_in, tile by tile
+static void backToBackBlock(const PrintJob queue[], int lo, int hi, MetricsBlock* block) {
+    JobColumnTile tile;
+    int scalar_tiles = 0; // Tiles left before the vector loop is retried
+    long long clock = block->clock_in;
+    long long wait_total = 0;
+    long long pages_total = 0;
+    long long max_wait = 0;
+
+    for (int base = lo; base < hi; base += METRICS_TILE) {
+        int n = (hi - base < METRICS_TILE) ? hi - base : METRICS_TILE;
+        long long tile_pages = 0;
+        for (int i = 0; i < n; i++) {
+            tile.page_counts[i] = queue[base + i].page_count;
+            tile.arrival_times[i] = queue[base + i].arrival_time;
+            tile_pages += queue[base + i].page_count;
+        }
+
+        long long wait_sum;
+        if (scalar_tiles > 0) {
+            scalar_tiles--;
+            backToBackTileScalar(&tile, n, &clock, &wait_sum, &max_wait);
+        } else if (!backToBackTileSimd(&tile, n, &clock, &wait_sum, &max_wait)) {
+            scalar_tiles = 8;
+            backToBackTileScalar(&tile, n, &clock, &wait_sum, &max_wait);
+        }
+        wait_total += wait_sum;
+        pages_total += tile_pages;
+    }
+    block->clock_out = clock;
+    block->pages = pages_total;
+    block->wait_sum = wait_total;
+    block->max_wait = max_wait;
+}
+
+/**
+ * @brief summarizeRun()'s per-job pass over queue[lo..hi): the wait and
+ * turnaround sums and the longest wait, plus (with `latency`) the
+ * histograms and slowdown sums. Without `completion` the jobs print
+ * back to back from block->clock_in.
+ */
+static void summarizeBlock(const PrintJob queue[], const long long completion[], int lo,
+                           int hi, MetricsBlock* block, LatencyStats* latency) {
+    long long current_time = block->clock_in;
+    long long pages = 0;
+    long long wait_sum = 0;
+    long long turnaround_sum = 0;
+    long long max_wait = 0;
+    double slowdown_sum = 0.0;
+    double slowdown_squares = 0.0;
+    for (int i = lo; i < hi; i++) {
+        long long turnaround_time;
+        if (completion != NULL) {
+            turnaround_time = completion[i] - queue[i].arrival_time;
+        } else {
+            if (current_time < queue[i].arrival_time) {
+                current_time = queue[i].arrival_time;
+            }
+            current_time += queue[i].page_count;
+            turnaround_time = current_time - queue[i].arrival_time;
+        }
+        pages += queue[i].page_count;
+        long long wait_time = turnaround_time - queue[i].page_count;
+        wait_sum += wait_time;
+        turnaround_sum += turnaround_time;
+        if (wait_time > max_wait) {
+            max_wait = wait_time;
+        }
+        if (latency != NULL) {
+            int cls = queue[i].priority;
+            if (cls < 1 || cls > PRIORITY_CLASSES) {
+                cls = 0;
+            }
+            histogramRecord(&latency->wait[cls], wait_time);
+            histogramRecord(&latency->turnaround[cls], turnaround_time);
+            double slowdown = queue[i].page_count > 0
+                ? (double)turnaround_time / queue[i].page_count : 1.0;
+            slowdown_sum += slowdown;
+            slowdown_squares += slowdown * slowdown;
+        }
+    }
+    block->clock_out = current_time;
+    block->pages = pages;
+    block->wait_sum = wait_sum;
+    block->turnaround_sum = turnaround_sum;
+    block->max_wait = max_wait;
+    block->slowdown_sum = slowdown_sum;
+    block->slowdown_squares = slowdown_squares;
+}
+
+void runMetricsTask(void* arg) {
+    MetricsTask* task = arg;
+    for (int b = task->first_block; b < task->end_block; b++) {
+        MetricsBlock* block = &task->blocks[b];
+        int lo = b * SCAN_BLOCK;
+        int hi = (task->count - lo < SCAN_BLOCK) ? task->count : lo + SCAN_BLOCK;
+        if (task->summarize) {
+            summarizeBlock(task->queue, task->completion, lo, hi, block, task->latency);
+        } else if (block->rescan) {
+            backToBackBlock(task->queue, lo, hi, block);
+        }
+    }
+}
+
+static void mergeHistogram(LatencyHistogram* into, const LatencyHistogram* from) {
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        into->counts[b] += from->counts[b];
+    }
+    into->total += from->total;
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+/**
+ * @brief Computes the MetricsBlock of each SCAN_BLOCK jobs of `queue`
+ * on `pool`: the per-job pass when summarizing (`summarize`), else the
+ * back-to-back totals. Histograms go to `latency` (zeroed by the caller)
+ * through one partial set per worker, merged at the end.
+ *
+ * Printing back to back, a block's start depends on every block before
+ * it: the first pass runs each block from an idle printer, which gives
+ * its pages P and its finish F from clock 0, and a block entered at
+ * clock x finishes at max(x + P, F). One serial pass over the blocks
+ * chains those into each block's true start, and the second pass
+ * re-runs from it only the blocks whose first job was still waiting for
+ * the printer (the others ran exactly from clock 0).
+ *
+ * @return The malloc'd blocks, or NULL if out of memory (nothing done).
+ */
+MetricsBlock* scanMetricsParallel(ThreadPool* pool, const PrintJob queue[],
+                                  const long long completion[], int count,
+                                  int summarize, LatencyStats* latency) {
+    int n = (int)(((long long)count + SCAN_BLOCK - 1) / SCAN_BLOCK);
+    int parts = (pool->thread_count < n) ? pool->thread_count : n;
+    MetricsBlock* blocks = malloc((size_t)n * sizeof(MetricsBlock));
+    MetricsTask* tasks = calloc((size_t)parts, sizeof(MetricsTask));
+    int ok = (blocks != NULL && tasks != NULL);
+    for (int t = 0; ok && t < parts; t++) {
+        tasks[t].queue = queue;
+        tasks[t].completion = completion;
+        tasks[t].count = count;
+        tasks[t].first_block = (int)((long long)n * t / parts);
+        tasks[t].end_block = (int)((long long)n * (t + 1) / parts);
+        tasks[t].blocks = blocks;
+        if (summarize && latency != NULL) {
+            tasks[t].latency = (t == 0) ? latency : calloc(1, sizeof(LatencyStats));
+            ok = (tasks[t].latency != NULL);
+        }
+    }
+
+    if (ok && completion == NULL) {
+        for (int b = 0; b < n; b++) {
+            blocks[b].clock_in = 0;
+            blocks[b].rescan = 1;
+        }
+        runParallelTasks(pool, runMetricsTask, tasks, sizeof(MetricsTask), parts);
+        long long clock = 0;
+        for (int b = 0; b < n; b++) {
+            long long finish = blocks[b].clock_out;
+            long long busy_finish = clock + blocks[b].pages;
+            // Entered before its first job arrives, it ran just like that
+            blocks[b].rescan = (clock > queue[b * SCAN_BLOCK].arrival_time);
+            blocks[b].clock_in = clock;
+            clock = (busy_finish > finish) ? busy_finish : finish;
+        }
+    }
+    if (ok) {
+        for (int t = 0; t < parts; t++) {
+            tasks[t].summarize = summarize;
+        }
+        runParallelTasks(pool, runMetricsTask, tasks, sizeof(MetricsTask), parts);
+    }
+
+    for (int t = 1; tasks != NULL && t < parts; t++) {
+        if (ok && tasks[t].latency != NULL) {
+            for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+                mergeHistogram(&latency->wait[c], &tasks[t].latency->wait[c]);
+                mergeHistogram(&latency->turnaround[c], &tasks[t].latency->turnaround[c]);
+            }
+        }
+        free(tasks[t].latency);
+    }
+    free(tasks);
+    if (!ok) {
+        if (latency != NULL) {
+            memset(latency, 0, sizeof(*latency));
+        }
+        free(blocks);
+        return NULL;
+    }
+    return blocks;
+}
+
+/**
+ * @brief Totals for `queue` printed back to back on one printer, each
+ * job starting no earlier than its arrival.
+ *
+ * The records are split into page and arrival columns one
+ * METRICS_TILE-job tile at a time, small enough to stay in L1, so the
+ * trace is read from memory once. Each tile first tries the vector
+ * loop, which holds whenever the printer stays busy (always, when every
+ * job arrives at time 0) and otherwise falls back to the scalar loop.
+ * Per-block sums are 64-bit integers, folded into double totals block
+ * by block. After a tile where the printer idled, the next few tiles go
+ * straight to the scalar loop, since lightly loaded traces idle almost
+ * everywhere. Large queues are scanned across the worker pool.
+ */
+void backToBackTotals(const PrintJob queue[], int count, BackToBackTotals* totals) {
+    totals->clock = 0;
+    totals->total_wait = 0.0;
+    totals->total_pages = 0.0;
+    totals->max_wait = 0;
+
+    ThreadPool* pool = parallelPool(count);
+    MetricsBlock* blocks = (pool != NULL)
+        ? scanMetricsParallel(pool, queue, NULL, count, 0, NULL) : NULL;
+    MetricsBlock block;
+    block.clock_out = 0;
+    for (int b = 0, lo = 0; lo < count; b++, lo += SCAN_BLOCK) {
+        if (blocks != NULL) {
+            block = blocks[b];
+        } else {
+            block.clock_in = block.clock_out;
+            backToBackBlock(queue, lo, (count - lo < SCAN_BLOCK) ? count : lo + SCAN_BLOCK,
+                            &block);
+        }
+        totals->total_wait += (double)block.wait_sum;
+        totals->total_pages += (double)block.pages;
+        if (block.max_wait > totals->max_wait) {
+            totals->max_wait = block.max_wait;
+        }
+    }
+    totals->clock = block.clock_out;
+    free(blocks);
+}
+
+// --- Policy Comparison ---
+
+// One policy's share of a comparison run
+typedef struct {
+    const PrintJob* jobs; // Shared, read-only job set
+    int count;
+    SchedPolicy policy;
+    int ok;               // 1 once `result` is valid
+    SimResult result;
+    LatencyStats* latency; // Histograms behind the percentile column
+} CompareTask;
+
+void runCompareTask(void* arg) {
+    CompareTask* task = arg;
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+
+    PrintJob* order = malloc((size_t)task->count * sizeof(PrintJob) + 1);
+    long long* completion = NULL;
+    task->latency = malloc(sizeof(LatencyStats));
+    task->ok = (order != NULL && task->latency != NULL &&
+                runPolicy(task->jobs, task->count, task->policy, order,
+                          &completion, &stats));
+    if (task->ok) {
+        summarizeRun(order, completion, task->count, &stats, &task->result,
+                     task->latency);
+    }
+    free(completion);
+    free(order);
+}
+
+/**
+ * @brief Runs every policy concurrently on the worker pool against the
+ * same read-only job set and prints one side-by-side table. Each worker
+ * schedules into its own buffers, so nothing is shared but the input.
+ */
+void compareAllPolicies(const PrintJob jobs[], int count) {
+    CompareTask tasks[POLICY_COUNT];
+    ThreadPool* pool = getWorkerPool();
+    double started = nowSeconds();
+
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        tasks[k].jobs = jobs;
+        tasks[k].count = count;
+        tasks[k].policy = (SchedPolicy)k;
+        tasks[k].ok = 0;
+        tasks[k].latency = NULL;
+        if (pool == NULL || !threadPoolSubmit(pool, runCompareTask, &tasks[k])) {
+            runCompareTask(&tasks[k]); // No pool: run it here instead
+        }
+    }
+    if (pool != NULL) {
+        threadPoolWait(pool);
+    }
+
+    printf("\n--- Policy Comparison: %d jobs, %d printer(s), %.3f s ---\n",
+           count, printer_count, nowSeconds() - started);
+    if (shardsInEffect(POLICY_FCFS, printer_count) > 1) {
+        printf("FCFS, SJF, Priority and Aging run on %d shards, %s.\n",
+               shardsInEffect(POLICY_FCFS, printer_count),
+               shard_stealing ? "stealing work" : "without stealing");
+    }
+    printf("%-36s | %-12s | %-14s | %-12s | %-12s | %-12s | %-11s | %-8s | %-8s\n",
+           "Policy", "Avg Wait", "Avg Turnaround", "P99 Wait", "Max Wait",
+           "Makespan", "Utilization", "Fairness", "Preempt.");
+    printf("-------------------------------------------------------------------"
+           "----------------------------------------------------------------"
+           "------------------------\n");
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        const SimResult* r = &tasks[k].result;
+        if (!tasks[k].ok) {
+            printf("%-36s | Error: Out of memory.\n", policy_ops[k].name);
+            continue;
+        }
+        const LatencyHistogram* waits[PRIORITY_CLASSES + 1];
+        for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+            waits[c] = &tasks[k].latency->wait[c];
+        }
+        printf("%-36s | %-12.2f | %-14.2f | %-12lld | %-12lld | %-12lld | %10.2f%% | %-8.4f | %-8d\n",
+               policy_ops[k].name, r->avg_wait_time, r->avg_turnaround_time,
+               histogramPercentile(waits, PRIORITY_CLASSES + 1, 0.99),
+               r->max_wait_time, r->makespan, r->utilization,
+               jainFairness(tasks[k].latency), r->preemptions);
+    }
+
+    // Starvation shows up in the tail of the lowest classes, so set the
+    // policies side by side per class
+    printf("\n%-36s", "Wait p99 / Max");
+    for (int c = 1; c <= PRIORITY_CLASSES; c++) {
+        printf(" | %-21s", priority_class_names[c]);
+    }
+    printf("\n-------------------------------------------------------------------"
+           "--------------------------------------------\n");
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (!tasks[k].ok) {
+            continue;
+        }
+        printf("%-36s", policy_ops[k].name);
+        for (int c = 1; c <= PRIORITY_CLASSES; c++) {
+            const LatencyHistogram* wait = &tasks[k].latency->wait[c];
+            if (wait->total == 0) {
+                printf(" | %-21s", "-");
+                continue;
+            }
+            char cell[48];
+            snprintf(cell, sizeof(cell), "%lld / %lld",
+                     histogramPercentile(&wait, 1, 0.99), wait->max);
+            printf(" | %-21s", cell);
+        }
+        printf("\n");
+    }
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        free(tasks[k].latency);
+    }
+}
+
+// --- Worker Thread Pool ---
+
+// The worker running on this thread, or NULL outside the pool
+_Thread_local PoolWorker* current_worker = NULL;
+_Thread_local Rng outside_rng; // Random stream for threads outside the pool
+
+/**
+ * @brief Returns the calling thread's random stream. Each worker owns
+ * one, so tasks can draw numbers without sharing state.
+ */
+Rng* workerRng() {
+    return current_worker != NULL ? &current_worker->rng : &outside_rng;
+}
+
+int dequePushBack(WorkDeque* deque, PoolTask task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->size == deque->capacity) {
+        int capacity = deque->capacity > 0 ? deque->capacity * 2 : 64;
+        PoolTask* items = malloc((size_t)capacity * sizeof(PoolTask));
+        if (items == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+        for (int i = 0; i < deque->size; i++) {
+            items[i] = deque->items[(deque->head + i) % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+    deque->items[(deque->head + deque->size) % deque->capacity] = task;
+    deque->size++;
+    pthread_mutex_unlock(&deque->lock);
+    return 1;
+}
+
+// The owner works newest-first, which keeps its data warm in cache.
+int dequePopBack(WorkDeque* deque, PoolTask* task) {
+    pthread_mutex_lock(&deque->lock);
+    int found = (deque->size > 0);
+    if (found) {
+        deque->size--;
+        *task = deque->items[(deque->head + deque->size) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Thieves take the oldest task, which is furthest from the owner's end.
+int dequePopFront(WorkDeque* deque, PoolTask* task) {
+    pthread_mutex_lock(&deque->lock);
+    int found = (deque->size > 0);
+    if (found) {
+        *task = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->size--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+/**
+ * @brief Tries every other worker's deque once, starting from a random
+ * victim so that thieves spread out.
+ */
+int stealTask(PoolWorker* self, PoolTask* task) {
+    ThreadPool* pool = self->pool;
+    int start = (int)(rngNext(&self->rng) % (uint64_t)pool->worker_slots);
+    for (int i = 0; i < pool->worker_slots; i++) {
+        PoolWorker* victim = &pool->workers[(start + i) % pool->worker_slots];
+        if (victim != self && dequePopFront(&victim->deque, task)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void* threadPoolWorker(void* arg) {
+    PoolWorker* self = arg;
+    ThreadPool* pool = self->pool;
+    current_worker = self;
+
+    for (;;) {
+        PoolTask task;
+        if (dequePopBack(&self->deque, &task) || stealTask(self, &task)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            task.fn(task.arg);
+            if (atomic_fetch_sub(&pool->unfinished, 1) == 1) {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_broadcast(&pool->work_done);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        int done = (atomic_load(&pool->queued) == 0 && pool->stopping);
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            break;
+        }
+    }
+    arenaRelease(runArena());
+    return NULL;
+}
+
+/**
+ * @brief Starts `threads` worker threads, each with its own deque and
+ * its own random stream.
+ * @return 1 on success, 0 if no thread could be started.
+ */
+int threadPoolInit(ThreadPool* pool, int threads) {
+    memset(pool, 0, sizeof(*pool));
+    pool->workers = calloc((size_t)threads, sizeof(PoolWorker));
+    if (pool->workers == NULL) {
+        return 0;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->unfinished, 0);
+    atomic_init(&pool->next_worker, 0);
+
+    // Workers steal across every slot as soon as they start, so the slot
+    // count must be final before the first thread runs.
+    pool->worker_slots = threads;
+    for (int t = 0; t < threads; t++) {
+        PoolWorker* worker = &pool->workers[t];
+        worker->pool = pool;
+        worker->index = t;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        rngSeed(&worker->rng, 0x5eed0000u + (uint64_t)t);
+    }
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&pool->workers[t].thread, NULL, threadPoolWorker,
+                           &pool->workers[t]) != 0) {
+            break;
+        }
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        threadPoolDestroy(pool);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Queues `fn(arg)` to run on a worker. Tasks submitted from a
+ * worker go on its own deque; others are dealt round-robin, and idle
+ * workers steal whatever is left unbalanced.
+ * @return 1 if queued, 0 if memory could not be allocated.
+ */
+int threadPoolSubmit(ThreadPool* pool, TaskFn fn, void* arg) {
+    PoolWorker* target = current_worker;
+    if (target == NULL || target->pool != pool) {
+        int next = atomic_fetch_add(&pool->next_worker, 1);
+        target = &pool->workers[(unsigned)next % (unsigned)pool->thread_count];
+    }
+
+    atomic_fetch_add(&pool->unfinished, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    if (!dequePushBack(&target->deque, (PoolTask){ fn, arg })) {
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_sub(&pool->unfinished, 1);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+/**
+ * @brief Blocks until every submitted task has finished.
+ */
+void threadPoolWait(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->unfinished) > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Lets the workers finish queued tasks, then joins them.
+ */
+void threadPoolDestroy(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 0; t < pool->thread_count; t++) {
+        pthread_join(pool->workers[t].thread, NULL);
+    }
+    for (int t = 0; pool->workers != NULL && t < pool->worker_slots; t++) {
+        pthread_mutex_destroy(&pool->workers[t].deque.lock);
+        free(pool->workers[t].deque.items);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->worker_slots = 0;
+    pool->thread_count = 0;
+}
+
+/**
+ * @brief Returns the shared worker pool, starting it on first use with
+ * --threads workers (default: one per online core). Returns NULL if no
+ * thread could be started, in which case callers run work inline.
+ */
+ThreadPool* getWorkerPool() {
+    if (worker_pool_started) {
+        return &worker_pool;
+    }
+    int threads = worker_thread_count;
+    if (threads < 1) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cores > 0) ? (int)cores : 1;
+    }
+    if (!threadPoolInit(&worker_pool, threads)) {
+        return NULL;
+    }
+    worker_pool_started = 1;
+    return &worker_pool;
+}
+
+void shutdownWorkerPool() {
+    if (worker_pool_started) {
+        threadPoolDestroy(&worker_pool);
+        worker_pool_started = 0;
+    }
+}
+
+// --- Random Numbers and Synthetic Workloads ---
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Seeds a generator; equal seeds give equal streams.
+ */
+void rngSeed(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+// xoshiro256**: fast, small state, and good enough for simulation.
+uint64_t rngNext(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Uniform double in [0, 1)
+static inline double rngUniform(Rng* rng) {
+    return (double)(rngNext(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Exponential with the given mean
+static inline double rngExponential(Rng* rng, double mean) {
+    return -mean * log(1.0 - rngUniform(rng));
+}
+
+// Standard normal, by Box-Muller
+static inline double rngNormal(Rng* rng) {
+    double u = 1.0 - rngUniform(rng);
+    double v = rngUniform(rng);
+    return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+/**
+ * @brief Draws one page count (at least 1) from `dist` with the given
+ * mean.
+ */
+int drawPageCount(Rng* rng, SizeDist dist, double mean) {
+    double pages;
+    switch (dist) {
+        case SIZE_UNIFORM:
+            pages = 1.0 + floor(rngUniform(rng) * (2.0 * mean - 1.0));
+            break;
+        case SIZE_LOGNORMAL:
+            // sigma = 1, so mu = ln(mean) - 1/2 keeps the requested mean
+            pages = ceil(exp(log(mean) - 0.5 + rngNormal(rng)));
+            break;
+        case SIZE_PARETO: {
+            // Inverse CDF, with the scale chosen so the mean is `mean`
+            double scale = mean * (PARETO_SHAPE - 1.0) / PARETO_SHAPE;
+            pages = ceil(scale * exp(-log(1.0 - rngUniform(rng)) / PARETO_SHAPE));
+            break;
+        }
+        default:
+            pages = ceil(rngExponential(rng, mean));
+            break;
+    }
+    if (pages < 1.0) {
+        return 1;
+    }
+    return pages > INT_MAX ? INT_MAX : (int)pages;
+}
+
+/**
+ * @brief Generates `count` jobs into `jobs`, numbered from `first_id`,
+ * with arrival times measured from 0. Arrivals follow `spec->arrivals`
+ * at the rate that offers `spec->load` per printer; priorities follow
+ * `spec->class_weights`.
+ *
+ * Bursty arrivals come in geometric bursts of BURST_MEAN_JOBS jobs,
+ * spaced BURST_GAP_SCALE times the mean gap apart. The idle gap before
+ * each burst is stretched so that the long-run rate, and so the offered
+ * load, matches the Poisson process.
+ *
+ * @return The clock after the last arrival, or -1 if an arrival time
+ * would overflow an int.
+ */
+double generateJobBlock(Rng* rng, const WorkloadSpec* spec, PrintJob jobs[],
+                        int count, int first_id) {
+    double mean_gap = spec->mean_pages / (spec->load * spec->printers);
+    double burst_gap = mean_gap * BURST_GAP_SCALE;
+    double idle_gap = mean_gap * BURST_MEAN_JOBS - burst_gap * (BURST_MEAN_JOBS - 1.0);
+
+    // Class cut-offs on the raw 64-bit draw, so picking a class needs no
+    // floating point
+    const int* w = spec->class_weights;
+    double total = (double)w[0] + w[1] + w[2];
+    uint64_t cut1 = (uint64_t)(w[0] / total * 18446744073709549568.0);
+    uint64_t cut2 = (uint64_t)((w[0] + w[1]) / total * 18446744073709549568.0);
+    if (w[1] + w[2] == 0) {
+        cut1 = UINT64_MAX;
+    }
+    if (w[2] == 0) {
+        cut2 = UINT64_MAX;
+    }
+
+    double clock = 0.0;
+    for (int i = 0; i < count; i++) {
+        if (spec->arrivals == ARRIVAL_BURSTY) {
+            int new_burst = (rngUniform(rng) < 1.0 / BURST_MEAN_JOBS);
+            clock += rngExponential(rng, new_burst ? idle_gap : burst_gap);
+        } else {
+            clock += rngExponential(rng, mean_gap);
+        }
+        if (clock >= INT_MAX) {
+            return -1.0;
+        }
+        uint64_t cls = rngNext(rng);
+        jobs[i].job_id = first_id + i;
+        jobs[i].page_count = drawPageCount(rng, spec->sizes, spec->mean_pages);
+        jobs[i].priority = (cls < cut1) ? 1 : (cls < cut2) ? 2 : 3;
+        jobs[i].arrival_time = (int)clock;
+    }
+    return clock;
+}
+
+/**
+ * @brief Fills `jobs` with one synthetic workload of `spec->jobs` jobs,
+ * drawn serially from `rng`.
+ * @return 1 on success, 0 if the arrival times overflow an int.
+ */
+int generateWorkload(Rng* rng, const WorkloadSpec* spec, PrintJob jobs[]) {
+    return generateJobBlock(rng, spec, jobs, spec->jobs, 1) >= 0.0;
+}
+
+void runGenerateTask(void* arg) {
+    GenerateTask* task = arg;
+    Rng rng;
+    rngSeed(&rng, task->seed);
+    task->span = generateJobBlock(&rng, task->spec, task->jobs, task->count,
+                                  task->first_id);
+}
+
+/**
+ * @brief Generates `spec->jobs` jobs into `jobs` on the worker pool.
+ *
+ * The output is cut into GENERATOR_CHUNK-job chunks, each drawn from its
+ * own stream seeded from `seed` and the chunk's index, so the jobs
+ * depend only on the seed and not on the thread count. Every chunk
+ * starts its clock at 0; one serial pass then shifts each chunk by the
+ * whole time units spanned by the chunks before it.
+ *
+ * @return 1 on success, 0 if out of memory or the arrival times
+ * overflow an int.
+ */
+int generateJobs(const WorkloadSpec* spec, uint64_t seed, PrintJob jobs[], int first_id) {
+    int chunks = (int)(((long long)spec->jobs + GENERATOR_CHUNK - 1) / GENERATOR_CHUNK);
+    GenerateTask* tasks = malloc((size_t)chunks * sizeof(GenerateTask));
+    if (tasks == NULL) {
+        return 0;
+    }
+
+    ThreadPool* pool = (chunks > 1) ? getWorkerPool() : NULL;
+    uint64_t seed_state = seed;
+    for (int c = 0; c < chunks; c++) {
+        GenerateTask* task = &tasks[c];
+        int offset = c * GENERATOR_CHUNK;
+        task->spec = spec;
+        task->jobs = jobs + offset;
+        task->count = (spec->jobs - offset < GENERATOR_CHUNK) ? spec->jobs - offset
+                                                              : GENERATOR_CHUNK;
+        task->first_id = first_id + offset;
+        task->seed = splitmix64(&seed_state);
+        if (pool == NULL || !threadPoolSubmit(pool, runGenerateTask, task)) {
+            runGenerateTask(task);
+        }
+    }
+    if (pool != NULL) {
+        threadPoolWait(pool);
+    }
+
+    int ok = 1;
+    long long clock = 0;
+    for (int c = 0; ok && c < chunks; c++) {
+        const GenerateTask* task = &tasks[c];
+        if (task->span < 0.0 || clock + (long long)task->span >= INT_MAX) {
+            ok = 0;
+            break;
+        }
+        if (clock > 0) {
+            int shift = (int)clock;
+            PrintJob* chunk = task->jobs;
+            for (int i = 0; i < task->count; i++) {
+                chunk[i].arrival_time += shift;
+            }
+        }
+        clock += (long long)task->span;
+    }
+    free(tasks);
+    return ok;
+}
+
+/**
+ * @brief Appends `spec->jobs` generated jobs to the job store in one
+ * bulk fill, numbered from next_job_id.
+ * @return 1 on success, 0 if out of memory or the workload does not fit
+ * in int arrival times or job ids.
+ */
+int generateIntoJobStore(const WorkloadSpec* spec, uint64_t seed) {
+    compactJobQueue();
+    if (spec->jobs > INT_MAX - job_store_size || spec->jobs > INT_MAX - next_job_id ||
+        !reserveJobs(&job_queue, &job_capacity, job_store_size + spec->jobs)) {
+        return 0;
+    }
+    if (!generateJobs(spec, seed, &job_queue[job_store_size], next_job_id)) {
+        return 0;
+    }
+    countQueueJobs(&job_queue[job_store_size], spec->jobs, 1);
+    job_store_size += spec->jobs;
+    job_count += spec->jobs;
+    counterMax(hotCounters(), job_count);
+    next_job_id += spec->jobs;
+    invalidateQueueIndexes();
+    return 1;
+}
+
+/**
+ * @brief Runs --generate: synthesizes the requested jobs into the job
+ * store, then writes them as a binary trace or simulates them like a
+ * loaded trace.
+ * @return 0 on success, 1 on failure (for use as an exit status).
+ */
+int runGenerator(const SpoolOptions* options) {
+    const SweepConfig* config = &options->sweep_config;
+    WorkloadSpec spec;
+    spec.load = config->loads[0];
+    spec.printers = printer_count;
+    spec.sizes = config->sizes[0];
+    spec.mean_pages = config->mean_pages;
+    spec.arrivals = config->arrivals;
+    memcpy(spec.class_weights, config->class_weights, sizeof(spec.class_weights));
+    spec.jobs = options->generate_jobs;
+
+    double started = nowSeconds();
+    if (!generateIntoJobStore(&spec, config->seed)) {
+        fprintf(stderr, "Error: Cannot generate %d jobs (out of memory, or arrival "
+                "times overflow; try a higher --loads).\n", spec.jobs);
+        return 1;
+    }
+    double elapsed = nowSeconds() - started;
+    printf("Generated %d jobs (%s pages, %s arrivals) in %.3f s, %.1f M jobs/s.\n",
+           spec.jobs, size_dist_names[spec.sizes], arrival_model_names[spec.arrivals],
+           elapsed, elapsed > 0.0 ? spec.jobs / elapsed / 1e6 : 0.0);
+
+    if (options->write_trace_path != NULL) {
+        if (!writeBinaryTrace(options->write_trace_path, job_queue, job_count)) {
+            return 1;
+        }
+        printf("Wrote %d jobs to %s.\n", job_count, options->write_trace_path);
+        return 0;
+    }
+    runTraceJobs(job_queue, job_count, options);
+    return 0;
+}
+
+// --- Parameter Sweep ---
+
+void runSweepTask(void* arg) {
+    SweepTask* task = arg;
+    int n = task->spec.jobs;
+    PrintJob* jobs = malloc((size_t)n * sizeof(PrintJob));
+    PrintJob* order = malloc((size_t)n * sizeof(PrintJob));
+
+    // Reseeding the worker's own stream from the task's seed makes the
+    // results independent of which thread ran the task.
+    Rng* rng = workerRng();
+    rngSeed(rng, task->seed);
+    task->ok = (jobs != NULL && order != NULL && generateWorkload(rng, &task->spec, jobs));
+
+    for (int k = 0; task->ok && k < POLICY_COUNT; k++) {
+        if (task->policy != -1 && task->policy != k) {
+            continue;
+        }
+        SimStats stats;
+        SimResult result;
+        long long* completion = NULL;
+        initSimStats(&stats, task->spec.printers);
+        if (!runPolicy(jobs, n, (SchedPolicy)k, order, &completion, &stats)) {
+            task->ok = 0;
+            break;
+        }
+        summarizeRun(order, completion, n, &stats, &result, NULL);
+        task->avg_wait[k] = result.avg_wait_time;
+        task->avg_turnaround[k] = result.avg_turnaround_time;
+        free(completion);
+    }
+    free(order);
+    free(jobs);
+}
+
+/**
+ * @brief Half-width multiplier of a two-sided 95% Student t interval.
+ */
+double tCritical95(int degrees) {
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degrees < 1) {
+        return 0.0;
+    }
+    return degrees <= 30 ? table[degrees - 1] : 1.960;
+}
+
+/**
+ * @brief Mean and 95% confidence half-width of `n` samples.
+ */
+void confidenceInterval(const double samples[], int n, double* mean, double* half_width) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    *mean = sum / n;
+    double squares = 0.0;
+    for (int i = 0; i < n; i++) {
+        double d = samples[i] - *mean;
+        squares += d * d;
+    }
+    *half_width = n > 1 ? tCritical95(n - 1) * sqrt(squares / (n - 1) / n) : 0.0;
+}
+
+/**
+ * @brief Runs every point of the load x fleet size x size distribution
+ * grid, `replicates` times each, and prints 95% confidence intervals on
+ * average wait and turnaround time per policy.
+ *
+ * Every replicate is one task on the work-stealing pool with its own
+ * seed, derived from --seed, so a sweep is reproducible whatever the
+ * thread count. All policies of a replicate share its workload.
+ *
+ * @return 0 on success, 1 on failure (for use as an exit status).
+ */
+int runSweep(const SweepConfig* config, int policy) {
+    int points = config->load_count * config->fleet_count * config->size_count;
+    int total = points * config->replicates;
+    SweepTask* tasks = calloc((size_t)total, sizeof(SweepTask));
+    if (tasks == NULL) {
+        fprintf(stderr, "Error: Out of memory. Cannot run sweep.\n");
+        return 1;
+    }
+
+    double* samples = malloc((size_t)config->replicates * 2 * sizeof(double));
+    if (samples == NULL) {
+        free(tasks);
+        fprintf(stderr, "Error: Out of memory. Cannot run sweep.\n");
+        return 1;
+    }
+
+    ThreadPool* pool = getWorkerPool();
+    double started = nowSeconds();
+    uint64_t seed_state = config->seed;
+    for (int t = 0; t < total; t++) {
+        int point = t / config->replicates;
+        SweepTask* task = &tasks[t];
+        task->spec.load = config->loads[point / (config->fleet_count * config->size_count)];
+        task->spec.printers = config->fleets[(point / config->size_count) % config->fleet_count];
+        task->spec.sizes = config->sizes[point % config->size_count];
+        task->spec.mean_pages = config->mean_pages;
+        task->spec.arrivals = config->arrivals;
+        memcpy(task->spec.class_weights, config->class_weights,
+               sizeof(task->spec.class_weights));
+        task->spec.jobs = config->jobs;
+        task->seed = splitmix64(&seed_state);
+        task->policy = policy;
+        if (pool == NULL || !threadPoolSubmit(pool, runSweepTask, task)) {
+            runSweepTask(task);
+        }
+    }
+    if (pool != NULL) {
+        threadPoolWait(pool);
+    }
+
+    printf("\n--- Sweep: %d points x %d replicates x %d jobs, %.3f s ---\n",
+           points, config->replicates, config->jobs, nowSeconds() - started);
+    printf("Average wait and turnaround with 95%% confidence intervals\n");
+    printf("%-5s | %-8s | %-11s | %-36s | %-24s | %-24s\n",
+           "Load", "Printers", "Sizes", "Policy", "Avg Wait", "Avg Turnaround");
+    printf("-------------------------------------------------------------------"
+           "---------------------------------------------------------\n");
+
+    int status = 0;
+    for (int point = 0; point < points; point++) {
+        SweepTask* first = &tasks[point * config->replicates];
+        int ok = 1;
+        for (int r = 0; r < config->replicates; r++) {
+            ok = ok && first[r].ok;
+        }
+        for (int k = 0; k < POLICY_COUNT; k++) {
+            if (policy != -1 && policy != k) {
+                continue;
+            }
+            printf("%-5.2f | %-8d | %-11s | %-36s | ", first->spec.load,
+                   first->spec.printers, size_dist_names[first->spec.sizes],
+                   policy_ops[k].name);
+            if (!ok) {
+                printf("Error: workload could not be generated\n");
+                status = 1;
+                continue;
+            }
+            double* waits = samples;
+            double* turnarounds = samples + config->replicates;
+            for (int r = 0; r < config->replicates; r++) {
+                waits[r] = first[r].avg_wait[k];
+                turnarounds[r] = first[r].avg_turnaround[k];
+            }
+            double wait_mean, wait_half, turn_mean, turn_half;
+            confidenceInterval(waits, config->replicates, &wait_mean, &wait_half);
+            confidenceInterval(turnarounds, config->replicates, &turn_mean, &turn_half);
+            printf("%11.2f +- %-9.2f | %11.2f +- %-9.2f\n",
+                   wait_mean, wait_half, turn_mean, turn_half);
+        }
+    }
+
+    free(samples);
+    free(tasks);
+    return status;
+}
+
+/**
+ * @brief Prints per-printer utilization and aggregate throughput of a
+ * multi-printer run.
+ */
+void printPrinterReport(const SimStats* stats, int count) {
+    long long total_busy = 0;
+    printf("\nPrinter | Jobs     | Busy Time    | Utilization\n");
+    printf("------------------------------------------------\n");
+    for (int p = 0; p < stats->printers; p++) {
+        double utilization = stats->makespan > 0
+            ? 100.0 * stats->busy_time[p] / stats->makespan : 0.0;
+        printf("%-7d | %-8d | %-12lld | %6.2f%%\n",
+               p + 1, stats->jobs_printed[p], stats->busy_time[p], utilization);
+        total_busy += stats->busy_time[p];
+    }
+    printf("------------------------------------------------\n");
+    if (stats->makespan > 0) {
+        printf("Fleet Utilization:        %.2f%%\n",
+               100.0 * total_busy / ((double)stats->makespan * stats->printers));
+        printf("Aggregate Throughput:     %.4f jobs per time unit\n",
+               (double)count / stats->makespan);
+    }
+}
+
+// --- Benchmark Harness ---
+
+/**
+ * @brief Resets the process's peak resident set (Linux 4.0+), so the
+ * next peakRssKb() reading covers one benchmark only.
+ * @return 1 if reset, 0 if peaks can only grow (then they are cumulative).
+ */
+static int resetPeakRss() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    int ok = (write(fd, "5", 1) == 1);
+    close(fd);
+    return ok;
+}
+
+// Peak resident set in KiB, from /proc where available
+static long peakRssKb() {
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status != NULL) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), status) != NULL) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+        fclose(status);
+        if (kb >= 0) {
+            return kb;
+        }
+    }
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+}
+
+// Empties the live queue without freeing it, between ingestion runs
+static void resetJobStore() {
+    QueueView view;
+    readQueueCounters(&view);
+    QueueView delta;
+    memset(&delta, 0, sizeof(delta));
+    delta.depth = -view.depth;
+    delta.pages = -view.pages;
+    for (int k = 0; k <= PRIORITY_CLASSES; k++) {
+        delta.class_depth[k] = -view.class_depth[k];
+        delta.class_pages[k] = -view.class_pages[k];
+    }
+    delta.removed = view.depth;
+    publishQueueDelta(&delta);
+    job_count = 0;
+    job_store_size = 0;
+    queue_run_count = 0;
+    queue_head = 0;
+    invalidateQueueIndexes();
+}
+
+static void benchCopyJobs(BenchContext* context) {
+    memcpy(context->work, context->jobs, (size_t)context->count * sizeof(PrintJob));
+}
+
+static int benchSortPagesIntrosort(BenchContext* context) {
+    sortJobsByPages(context->work, context->count);
+    return 1;
+}
+
+static int benchSortPagesRadix(BenchContext* context) {
+    return radixSortByPages(context->work, context->count);
+}
+
+static int benchSortPriorityIntrosort(BenchContext* context) {
+    sortJobsByPriority(context->work, context->count);
+    return 1;
+}
+
+static int benchSortPriorityCounting(BenchContext* context) {
+    return countingSortByPriority(context->work, context->count);
+}
+
+static int benchSortPagesParallel(BenchContext* context) {
+    ThreadPool* pool = getWorkerPool();
+    return pool != NULL && parallelIntegerSort(pool, context->work, context->count,
+                                               POLICY_SJF);
+}
+
+static int benchSortPriorityParallel(BenchContext* context) {
+    ThreadPool* pool = getWorkerPool();
+    return pool != NULL && parallelIntegerSort(pool, context->work, context->count,
+                                               POLICY_PRIORITY);
+}
+
+static int benchSimulate(BenchContext* context) {
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+    long long* completion = NULL;
+    if (!runPolicy(context->jobs, context->count, context->policy, context->work,
+                   &completion, &stats)) {
+        return 0;
+    }
+    free(completion);
+    return 1;
+}
+
+static int benchPackJobs(BenchContext* context) {
+    PackedJobs packed;
+    int ok = packJobs(context->jobs, context->count, &packed);
+    freePackedJobs(&packed);
+    return ok;
+}
+
+static int benchSimulatePacked(BenchContext* context) {
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+    long long* completion = NULL;
+    if (!runPackedPolicy(&context->packed, context->policy, context->packed_order,
+                         &completion, &stats)) {
+        return 0;
+    }
+    free(completion);
+    return 1;
+}
+
+static int benchMetrics(BenchContext* context) {
+    SimStats stats;
+    initSimStats(&stats, 1);
+    SimResult result;
+    summarizeRun(context->jobs, NULL, context->count, &stats, &result, NULL);
+    return 1;
+}
+
+static int benchMetricsLatency(BenchContext* context) {
+    SimStats stats;
+    initSimStats(&stats, 1);
+    SimResult result;
+    summarizeRun(context->jobs, NULL, context->count, &stats, &result, context->latency);
+    return 1;
+}
+
+static int benchOnlineDispatch(BenchContext* context) {
+    if (!appendJobs(context->jobs, context->count)) {
+        return 0;
+    }
+    PrintJob job;
+    while (job_count > 0) {
+        if (!dispatchJob(POLICY_SJF, &job)) {
+            return 0;
+        }
+    }
+    resetJobStore();
+    return 1;
+}
+
+static int benchIngestCsv(BenchContext* context) {
+    int loaded = loadTraceFile(context->csv_path);
+    resetJobStore();
+    return loaded == context->count;
+}
+
+static int benchIngestBinary(BenchContext* context) {
+    MappedTrace trace;
+    if (!mapBinaryTrace(context->binary_path, &trace)) {
+        return 0;
+    }
+    // Touch every record, as a replay would
+    long long pages = 0;
+    for (int i = 0; i < trace.count; i++) {
+        pages += trace.jobs[i].page_count;
+    }
+    int ok = (trace.count == context->count && pages > 0);
+    unmapBinaryTrace(&trace);
+    return ok;
+}
+
+// The timed cases, in report order. Simulation cases run once per policy.
+static const BenchCase bench_cases[] = {
+    { "sort_pages_introsort", benchCopyJobs, benchSortPagesIntrosort, 0 },
+    { "sort_pages_radix", benchCopyJobs, benchSortPagesRadix, 0 },
+    { "sort_priority_introsort", benchCopyJobs, benchSortPriorityIntrosort, 0 },
+    { "sort_priority_counting", benchCopyJobs, benchSortPriorityCounting, 0 },
+    { "sort_pages_parallel", benchCopyJobs, benchSortPagesParallel, 0 },
+    { "sort_priority_parallel", benchCopyJobs, benchSortPriorityParallel, 0 },
+    { "simulate", NULL, benchSimulate, 1 },
+    { "pack_jobs", NULL, benchPackJobs, 0 },
+    { "simulate_packed", NULL, benchSimulatePacked, 2 },
+    { "metrics", NULL, benchMetrics, 0 },
+    { "metrics_latency", NULL, benchMetricsLatency, 0 },
+    { "online_dispatch_sjf", NULL, benchOnlineDispatch, 0 },
+    { "ingest_csv", NULL, benchIngestCsv, 0 },
+    { "ingest_binary", NULL, benchIngestBinary, 0 }
+};
+
+// Creates an empty temporary file, named in `path`, under $TMPDIR or /tmp
+static int makeTempFile(char* path, size_t size) {
+    const char* dir = getenv("TMPDIR");
+    snprintf(path, size, "%s/spool-bench-XXXXXX", dir != NULL ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return 0;
+    }
+    close(fd);
+    return 1;
+}
+
+/**
+ * @brief Writes `jobs` to new temporary files, as a CSV trace in
+ * `csv_path` and as a binary trace in `binary_path`, for the ingestion
+ * cases.
+ * @return 1 on success, 0 on an I/O error (with nothing left behind).
+ */
+static int writeBenchTraces(const PrintJob jobs[], int count, BenchContext* context) {
+    if (!makeTempFile(context->csv_path, sizeof(context->csv_path))) {
+        return 0;
+    }
+    FILE* file = fopen(context->csv_path, "w");
+    int ok = (file != NULL);
+    for (int i = 0; ok && i < count; i++) {
+        ok = fprintf(file, "%d,%d,%d,%d\n", jobs[i].job_id, jobs[i].page_count,
+                     jobs[i].priority, jobs[i].arrival_time) > 0;
+    }
+    if (file != NULL && fclose(file) != 0) {
+        ok = 0;
+    }
+    if (ok && makeTempFile(context->binary_path, sizeof(context->binary_path))) {
+        if (writeBinaryTrace(context->binary_path, jobs, count)) {
+            return 1;
+        }
+        unlink(context->binary_path);
+    }
+    unlink(context->csv_path);
+    return 0;
+}
+
+/**
+ * @brief Times `bench` on the workload in `context`: `warmup` untimed
+ * runs, then `runs` timed ones, and prints one JSON result object.
+ * @return 1 on success, 0 if a run failed.
+ */
+static int runBenchCase(const BenchCase* bench, BenchContext* context,
+                        const BenchConfig* config, const char* dist, int first) {
+    double times[MAX_BENCH_RUNS];
+    int cumulative_rss = !resetPeakRss();
+    for (int r = 0; r < config->warmup + config->runs; r++) {
+        if (bench->prepare != NULL) {
+            bench->prepare(context);
+        }
+        double started = nowSeconds();
+        if (!bench->run(context)) {
+            return 0;
+        }
+        double elapsed = nowSeconds() - started;
+        if (r >= config->warmup) {
+            times[r - config->warmup] = elapsed;
+        }
+    }
+
+    // Insertion sort of the handful of run times for the median
+    double sum = 0.0;
+    for (int i = 0; i < config->runs; i++) {
+        double t = times[i];
+        int j = i;
+        for (; j > 0 && times[j - 1] > t; j--) {
+            times[j] = times[j - 1];
+        }
+        times[j] = t;
+        sum += t;
+    }
+    double median = (config->runs % 2 == 1)
+        ? times[config->runs / 2]
+        : 0.5 * (times[config->runs / 2 - 1] + times[config->runs / 2]);
+
+    char name[64];
+    if (bench->per_policy) {
+        snprintf(name, sizeof(name), "%s_%s", bench->name, policy_ops[context->policy].key);
+    } else {
+        snprintf(name, sizeof(name), "%s", bench->name);
+    }
+    double ns = 1e9 / context->count;
+    printf("%s    {\"bench\": \"%s\", \"dist\": \"%s\", \"jobs\": %d, \"runs\": %d, "
+           "\"ns_per_job_median\": %.3f, \"ns_per_job_min\": %.3f, "
+           "\"ns_per_job_max\": %.3f, \"ns_per_job_mean\": %.3f, "
+           "\"jobs_per_sec\": %.0f, \"peak_rss_kb\": %ld, \"rss_cumulative\": %s}",
+           first ? "" : ",\n", name, dist, context->count, config->runs,
+           median * ns, times[0] * ns, times[config->runs - 1] * ns,
+           sum / config->runs * ns, median > 0.0 ? context->count / median : 0.0,
+           peakRssKb(), cumulative_rss ? "true" : "false");
+    fflush(stdout);
+    fprintf(stderr, "  %-26s %-11s %10d jobs  %9.2f ns/job\n",
+            name, dist, context->count, median * ns);
+    return 1;
+}
+
+/**
+ * @brief Runs every benchmark case at each --bench-jobs size and
+ * --sizes distribution, printing the results as one JSON document on
+ * standard output (progress goes to standard error).
+ * @return 0 on success, 1 on failure (for use as an exit status).
+ */
+int runBench(const SweepConfig* sweep, const BenchConfig* config) {
+    const char* simd = "scalar";
+#if defined(METRICS_SIMD_AVX2)
+    simd = "avx2";
+#elif defined(METRICS_SIMD_SSE42)
+    simd = "sse4.2";
+#elif defined(METRICS_SIMD_NEON)
+    simd = "neon";
+#endif
+    printf("{\n  \"build\": {\"compiler\": \"%s\", \"simd\": \"%s\"},\n",
+#if defined(__VERSION__)
+           __VERSION__,
+#else
+           "unknown",
+#endif
+           simd);
+    printf("  \"config\": {\"runs\": %d, \"warmup\": %d, \"seed\": %llu, "
+           "\"mean_pages\": %.2f, \"load\": %.3f, \"printers\": %d, "
+           "\"arrivals\": \"%s\"},\n  \"results\": [\n",
+           config->runs, config->warmup, (unsigned long long)sweep->seed,
+           sweep->mean_pages, sweep->loads[0], printer_count,
+           arrival_model_names[sweep->arrivals]);
+
+    int status = 0;
+    int first = 1;
+    for (int n = 0; n < config->job_count && status == 0; n++) {
+        for (int d = 0; d < sweep->size_count && status == 0; d++) {
+            WorkloadSpec spec;
+            spec.load = sweep->loads[0];
+            spec.printers = printer_count;
+            spec.sizes = sweep->sizes[d];
+            spec.mean_pages = sweep->mean_pages;
+            spec.arrivals = sweep->arrivals;
+            memcpy(spec.class_weights, sweep->class_weights, sizeof(spec.class_weights));
+            spec.jobs = config->jobs[n];
+
+            BenchContext context;
+            memset(&context, 0, sizeof(context));
+            context.count = spec.jobs;
+            PrintJob* jobs = malloc((size_t)spec.jobs * sizeof(PrintJob) + 1);
+            context.work = malloc((size_t)spec.jobs * sizeof(PrintJob) + 1);
+            context.latency = malloc(sizeof(LatencyStats));
+            if (jobs == NULL || context.work == NULL || context.latency == NULL ||
+                !generateJobs(&spec, sweep->seed, jobs, 1)) {
+                fprintf(stderr, "Error: Cannot generate %d jobs.\n", spec.jobs);
+                status = 1;
+            }
+            context.jobs = jobs;
+            int have_traces = 0;
+            if (status == 0 && jobsPackable(jobs, spec.jobs)) {
+                context.packed_order = malloc((size_t)spec.jobs * sizeof(int));
+                if (context.packed_order == NULL ||
+                    !packJobs(jobs, spec.jobs, &context.packed)) {
+                    fprintf(stderr, "Error: Cannot pack %d jobs.\n", spec.jobs);
+                    status = 1;
+                }
+            }
+            if (status == 0) {
+                have_traces = writeBenchTraces(jobs, spec.jobs, &context);
+                if (!have_traces) {
+                    fprintf(stderr, "Error: Cannot write the ingestion traces.\n");
+                    status = 1;
+                }
+            }
+
+            const char* dist = size_dist_names[spec.sizes];
+            int cases = (int)(sizeof(bench_cases) / sizeof(bench_cases[0]));
+            for (int c = 0; c < cases && status == 0; c++) {
+                const BenchCase* bench = &bench_cases[c];
+                int policies = bench->per_policy ? POLICY_COUNT : 1;
+                for (int k = 0; k < policies && status == 0; k++) {
+                    context.policy = (SchedPolicy)k;
+                    if (bench->per_policy == 2 &&
+                        (context.packed.words == NULL ||
+                         !packedPolicyFits(&context.packed, context.policy))) {
+                        continue; // These jobs or this policy need the wide layout
+                    }
+                    if (!runBenchCase(bench, &context, config, dist, first)) {
+                        fprintf(stderr, "Error: Benchmark %s failed (out of memory?).\n",
+                                bench->name);
+                        status = 1;
+                    }
+                    first = 0;
+                }
+            }
+
+            if (have_traces) {
+                unlink(context.csv_path);
+                unlink(context.binary_path);
+            }
+            free(jobs);
+            free(context.work);
+            free(context.latency);
+            freePackedJobs(&context.packed);
+            free(context.packed_order);
+        }
+    }
+    printf("\n  ]\n}\n");
+    return status;
+}
+
+// --- Job Sorting ---
+
+// Sifts jobs[k] down the max-heap jobs[0..n) ordered by `policy`.
+static ALWAYS_INLINE void jobHeapSiftDown(PrintJob jobs[], int n, int k,
+                                          SchedPolicy policy) {
+    PrintJob moving = jobs[k];
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && jobBefore(policy, &jobs[child], &jobs[child + 1])) {
+            child++;
+        }
+        if (!jobBefore(policy, &moving, &jobs[child])) {
+            break;
+        }
+        jobs[k] = jobs[child];
+        k = child;
+    }
+    jobs[k] = moving;
+}
+
+static ALWAYS_INLINE void swapJobs(PrintJob* a, PrintJob* b) {
+    PrintJob tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/**
+ * @brief Introsort of `jobs` into `policy`'s dispatch order: quicksort
+ * on a median-of-three pivot, heapsort for any range that recurses too
+ * deep, and one insertion pass over the ranges it leaves of at most
+ * INSERTION_SORT_MAX jobs. Written without recursion so that it inlines
+ * with `policy` constant, every comparison becoming the key test itself
+ * where qsort would make an indirect call.
+ */
+static ALWAYS_INLINE void sortJobsFor(PrintJob jobs[], int count, SchedPolicy policy) {
+    SortRange stack[64]; // Larger halves wait here
+    int top = 0;
+    int lo = 0;
+    int hi = count;
+    int depth = 2 * (32 - __builtin_clz((unsigned)count | 1));
+    for (;;) {
+        while (hi - lo > INSERTION_SORT_MAX) {
+            if (depth == 0) {
+                int n = hi - lo;
+                for (int k = n / 2 - 1; k >= 0; k--) {
+                    jobHeapSiftDown(jobs + lo, n, k, policy);
+                }
+                for (int end = n - 1; end > 0; end--) {
+                    swapJobs(&jobs[lo], &jobs[lo + end]);
+                    jobHeapSiftDown(jobs + lo, end, 0, policy);
+                }
+                break;
+            }
+            depth--;
+
+            // Median of three to jobs[lo], where it bounds both scans
+            int mid = lo + (hi - lo) / 2;
+            if (jobBefore(policy, &jobs[mid], &jobs[lo])) {
+                swapJobs(&jobs[mid], &jobs[lo]);
+            }
+            if (jobBefore(policy, &jobs[hi - 1], &jobs[mid])) {
+                swapJobs(&jobs[hi - 1], &jobs[mid]);
+                if (jobBefore(policy, &jobs[mid], &jobs[lo])) {
+                    swapJobs(&jobs[mid], &jobs[lo]);
+                }
+            }
+            swapJobs(&jobs[lo], &jobs[mid]);
+            PrintJob pivot = jobs[lo];
+
+            int i = lo - 1;
+            int j = hi;
+            for (;;) {
+                do {
+                    i++;
+                } while (jobBefore(policy, &jobs[i], &pivot));
+                do {
+                    j--;
+                } while (jobBefore(policy, &pivot, &jobs[j]));
+                if (i >= j) {
+                    break;
+                }
+                swapJobs(&jobs[i], &jobs[j]);
+            }
+
+            // Keep the smaller half; the stack then stays O(log n) deep
+            int split = j + 1;
+            if (split - lo < hi - split) {
+                stack[top++] = (SortRange){ split, hi, depth };
+                hi = split;
+            } else {
+                stack[top++] = (SortRange){ lo, split, depth };
+                lo = split;
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        top--;
+        lo = stack[top].lo;
+        hi = stack[top].hi;
+        depth = stack[top].depth;
+    }
+
+    for (int i = 1; i < count; i++) {
+        PrintJob moving = jobs[i];
+        int k = i;
+        while (k > 0 && jobBefore(policy, &moving, &jobs[k - 1])) {
+            jobs[k] = jobs[k - 1];
+            k--;
+        }
+        jobs[k] = moving;
+    }
+}
+
+void sortJobsByArrival(PrintJob jobs[], int count) {
+    uint64_t started = nowNanos();
+    sortJobsFor(jobs, count, POLICY_FCFS);
+    countSortTime(POLICY_FCFS, count, started);
+}
+
+void sortJobsByPages(PrintJob jobs[], int count) {
+    sortJobsFor(jobs, count, POLICY_SJF);
+}
+
+void sortJobsByPriority(PrintJob jobs[], int count) {
+    sortJobsFor(jobs, count, POLICY_PRIORITY);
+}
+
+/**
+ * @brief Stable counting sort of `jobs` by priority. Priorities span
+ * only a handful of values, so this is one counting pass and one
+ * scatter pass; stability keeps equal priorities in their input order.
+ * @return 1 if sorted, 0 (jobs untouched) if the priorities span more
+ * than COUNTING_SORT_MAX_RANGE values or memory ran out.
+ */
+int countingSortByPriority(PrintJob jobs[], int count) {
+    int lo = jobs[0].priority;
+    int hi = lo;
+    for (int i = 1; i < count; i++) {
+        if (jobs[i].priority < lo) {
+            lo = jobs[i].priority;
+        } else if (jobs[i].priority > hi) {
+            hi = jobs[i].priority;
+        }
+    }
+    long long range = (long long)hi - lo + 1;
+    if (range > COUNTING_SORT_MAX_RANGE) {
+        return 0;
+    }
+
+    int* start = calloc((size_t)range + 1, sizeof(int));
+    PrintJob* sorted = malloc((size_t)count * sizeof(PrintJob));
+    if (start == NULL || sorted == NULL) {
+        free(start);
+        free(sorted);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        start[jobs[i].priority - lo + 1]++;
+    }
+    for (long long k = 1; k <= range; k++) {
+        start[k] += start[k - 1];
+    }
+    for (int i = 0; i < count; i++) {
+        sorted[start[jobs[i].priority - lo]++] = jobs[i];
+    }
+    memcpy(jobs, sorted, (size_t)count * sizeof(PrintJob));
+    free(sorted);
+    free(start);
+    return 1;
+}
+
+/**
+ * @brief Stable LSD radix sort of `jobs` by page_count, RADIX_BITS bits
+ * per pass. Keys are taken relative to the smallest page count, and the
+ * histograms of every pass are built in one read, so typical page
+ * counts (under 2048 apart) need a single scatter pass.
+ * @return 1 if sorted, 0 (jobs untouched) if memory ran out.
+ */
+int radixSortByPages(PrintJob jobs[], int count) {
+    int lo = jobs[0].page_count;
+    int hi = lo;
+    for (int i = 1; i < count; i++) {
+        if (jobs[i].page_count < lo) {
+            lo = jobs[i].page_count;
+        } else if (jobs[i].page_count > hi) {
+            hi = jobs[i].page_count;
+        }
+    }
+    uint32_t max_key = (uint32_t)hi - (uint32_t)lo;
+    int passes = 0;
+    while (passes * RADIX_BITS < 32 && (max_key >> (passes * RADIX_BITS)) != 0) {
+        passes++;
+    }
+    if (passes == 0) {
+        return 1; // Every job has the same page count
+    }
+
+    int (*counts)[RADIX_BUCKETS] = calloc((size_t)passes, sizeof(*counts));
+    PrintJob* buffer = malloc((size_t)count * sizeof(PrintJob));
+    if (counts == NULL || buffer == NULL) {
+        free(counts);
+        free(buffer);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        uint32_t key = (uint32_t)jobs[i].page_count - (uint32_t)lo;
+        for (int p = 0; p < passes; p++) {
+            counts[p][(key >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    PrintJob* src = jobs;
+    PrintJob* dst = buffer;
+    for (int p = 0; p < passes; p++) {
+        int shift = p * RADIX_BITS;
+        int* bucket = counts[p];
+        if (bucket[((uint32_t)src[0].page_count - (uint32_t)lo) >> shift &
+                   (RADIX_BUCKETS - 1)] == count) {
+            continue; // All keys share this digit
+        }
+        int offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            int n = bucket[b];
+            bucket[b] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < count; i++) {
+            uint32_t key = (uint32_t)src[i].page_count - (uint32_t)lo;
+            dst[bucket[(key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+        PrintJob* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != jobs) {
+        memcpy(jobs, src, (size_t)count * sizeof(PrintJob));
+    }
+    free(buffer);
+    free(counts);
+    return 1;
+}
+
+/**
+ * @brief Sorts `jobs` into the dispatch order of SJF or Priority when
+ * every job is waiting at once. Both keys are small integers, so large
+ * inputs take a stable integer sort instead of a comparison sort. The
+ * priority sort is stable, so it gives the job_id tie-break when the
+ * jobs arrive in job_id order (as traces and the job store do);
+ * otherwise, and for small or unusual inputs, the specialised introsort
+ * remains the fallback. From PARALLEL_MIN_JOBS jobs, outside the worker
+ * pool, the integer sort is split across the pool.
+ */
+void sortForPolicy(PrintJob jobs[], int count, SchedPolicy policy) {
+    uint64_t started = nowNanos();
+    ThreadPool* pool = parallelPool(count);
+    if (pool != NULL && parallelIntegerSort(pool, jobs, count, policy)) {
+        // Sorted across the pool
+    } else if (policy == POLICY_SJF) {
+        if (count < INTEGER_SORT_MIN || !radixSortByPages(jobs, count)) {
+            sortJobsByPages(jobs, count);
+        }
+    } else {
+        int ids_ascending = 1;
+        for (int i = 1; i < count && ids_ascending; i++) {
+            ids_ascending = (jobs[i - 1].job_id < jobs[i].job_id);
+        }
+        if (count < INTEGER_SORT_MIN || !ids_ascending ||
+            !countingSortByPriority(jobs, count)) {
+            sortJobsByPriority(jobs, count);
+        }
+    }
+    countSortTime(policy, count, started);
+}
+
+// --- Parallel Sorting ---
+
+/**
+ * @brief Returns the worker pool when a sort or metrics scan of `count`
+ * jobs is worth splitting across it: PARALLEL_MIN_JOBS jobs or more,
+ * more than one worker, and a caller outside the pool. Pool tasks
+ * (--compare, --sweep) already keep every worker busy, and could not
+ * wait on the pool from inside it.
+ * @return The pool, or NULL to stay on the calling thread.
+ */
+ThreadPool* parallelPool(int count) {
+    if (count < PARALLEL_MIN_JOBS || current_worker != NULL) {
+        return NULL;
+    }
+    ThreadPool* pool = getWorkerPool();
+    return (pool != NULL && pool->thread_count > 1) ? pool : NULL;
+}
+
+/**
+ * @brief Runs `fn` on each of the `n` task structs of `size` bytes at
+ * `tasks` on `pool`, and waits for them all. A task the pool cannot
+ * queue runs here instead.
+ */
+void runParallelTasks(ThreadPool* pool, TaskFn fn, void* tasks, size_t size, int n) {
+    char* task = tasks;
+    for (int t = 0; t < n; t++, task += size) {
+        if (!threadPoolSubmit(pool, fn, task)) {
+            fn(task);
+        }
+    }
+    threadPoolWait(pool);
+}
+
+static ALWAYS_INLINE int integerSortKey(const PrintJob* job, SchedPolicy policy) {
+    return (policy == POLICY_SJF) ? job->page_count : job->priority;
+}
+
+void runSortRangeTask(void* arg) {
+    SortTask* task = arg;
+    const PrintJob* src = task->src;
+    int lo = integerSortKey(&src[task->lo], task->policy);
+    int hi = lo;
+    int ascending = (task->lo == 0 || src[task->lo - 1].job_id < src[task->lo].job_id);
+    for (int i = task->lo + 1; i < task->hi; i++) {
+        int key = integerSortKey(&src[i], task->policy);
+        if (key < lo) {
+            lo = key;
+        } else if (key > hi) {
+            hi = key;
+        }
+        ascending &= (src[i - 1].job_id < src[i].job_id);
+    }
+    task->key_min = lo;
+    task->key_max = hi;
+    task->ascending = ascending;
+}
+
+void runSortCountTask(void* arg) {
+    SortTask* task = arg;
+    int* counts = task->counts;
+    memset(counts, 0, RADIX_BUCKETS * sizeof(int));
+    for (int i = task->lo; i < task->hi; i++) {
+        uint32_t key = (uint32_t)integerSortKey(&task->src[i], task->policy) - task->base;
+        counts[(key >> task->shift) & (RADIX_BUCKETS - 1)]++;
+    }
+}
+
+void runSortScatterTask(void* arg) {
+    SortTask* task = arg;
+    int* offsets = task->counts;
+    for (int i = task->lo; i < task->hi; i++) {
+        uint32_t key = (uint32_t)integerSortKey(&task->src[i], task->policy) - task->base;
+        task->dst[offsets[(key >> task->shift) & (RADIX_BUCKETS - 1)]++] = task->src[i];
+    }
+}
+
+void runSortCopyTask(void* arg) {
+    SortTask* task = arg;
+    memcpy(task->dst + task->lo, task->src + task->lo,
+           (size_t)(task->hi - task->lo) * sizeof(PrintJob));
+}
+
+/**
+ * @brief Stable LSD radix sort of `jobs` by page_count (POLICY_SJF) or
+ * priority (otherwise), RADIX_BITS bits per pass, on `pool`. Every
+ * worker owns one slice of the input: it counts its slice's digits, and
+ * the offsets then place each worker's jobs of a digit after those of
+ * the workers before it, so the scatter runs in parallel and stays
+ * stable. The order is exactly that of radixSortByPages() and
+ * countingSortByPriority().
+ * @return 1 if sorted, 0 (jobs untouched) if memory ran out, or if
+ * sorting by priority and the job_ids do not ascend, so that stability
+ * would not give the job_id tie-break.
+ */
+int parallelIntegerSort(ThreadPool* pool, PrintJob jobs[], int count, SchedPolicy policy) {
+    if (count < 1) {
+        return 1;
+    }
+    int parts = (pool->thread_count < count) ? pool->thread_count : count;
+    SortTask* tasks = malloc((size_t)parts * sizeof(SortTask));
+    int* counts = malloc((size_t)parts * RADIX_BUCKETS * sizeof(int));
+    PrintJob* buffer = malloc((size_t)count * sizeof(PrintJob));
+    if (tasks == NULL || counts == NULL || buffer == NULL) {
+        free(tasks);
+        free(counts);
+        free(buffer);
+        return 0;
+    }
+    for (int t = 0; t < parts; t++) {
+        SortTask* task = &tasks[t];
+        memset(task, 0, sizeof(*task));
+        task->src = jobs;
+        task->lo = (int)((long long)count * t / parts);
+        task->hi = (int)((long long)count * (t + 1) / parts);
+        task->policy = policy;
+        task->counts = counts + (size_t)t * RADIX_BUCKETS;
+    }
+
+    runParallelTasks(pool, runSortRangeTask, tasks, sizeof(SortTask), parts);
+    int lo = tasks[0].key_min;
+    int hi = tasks[0].key_max;
+    int ok = 1;
+    for (int t = 0; t < parts; t++) {
+        lo = (tasks[t].key_min < lo) ? tasks[t].key_min : lo;
+        hi = (tasks[t].key_max > hi) ? tasks[t].key_max : hi;
+        ok &= (policy == POLICY_SJF || tasks[t].ascending);
+    }
+    uint32_t max_key = (uint32_t)hi - (uint32_t)lo;
+    int passes = 0;
+    while (passes * RADIX_BITS < 32 && (max_key >> (passes * RADIX_BITS)) != 0) {
+        passes++;
+    }
+
+    PrintJob* src = jobs;
+    PrintJob* dst = buffer;
+    for (int p = 0; ok && p < passes; p++) {
+        for (int t = 0; t < parts; t++) {
+            tasks[t].src = src;
+            tasks[t].dst = dst;
+            tasks[t].base = (uint32_t)lo;
+            tasks[t].shift = p * RADIX_BITS;
+        }
+        runParallelTasks(pool, runSortCountTask, tasks, sizeof(SortTask), parts);
+
+        // Digit-major, then slice order: equal digits keep their input order
+        int offset = 0;
+        int one_digit = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            int start = offset;
+            for (int t = 0; t < parts; t++) {
+                int n = tasks[t].counts[b];
+                tasks[t].counts[b] = offset;
+                offset += n;
+            }
+            one_digit |= (offset - start == count);
+        }
+        if (one_digit) {
+            continue; // All keys share this digit
+        }
+        runParallelTasks(pool, runSortScatterTask, tasks, sizeof(SortTask), parts);
+        PrintJob* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (ok && src != jobs) {
+        for (int t = 0; t < parts; t++) {
+            tasks[t].src = src;
+            tasks[t].dst = jobs;
+        }
+        runParallelTasks(pool, runSortCopyTask, tasks, sizeof(SortTask), parts);
+    }
+    free(buffer);
+    free(counts);
+    free(tasks);
+    return ok;
+}
+
+// --- Discrete-Event Simulation Engine ---
+
+/**
+ * @brief Resets `stats` for a run on `printers` printers.
+ */
+void initSimStats(SimStats* stats, int printers) {
+    memset(stats, 0, sizeof(*stats));
+    stats->printers = printers;
+}
+
+/**
+ * @brief Adds an event to the queue, growing it in the run arena if
+ * needed.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int eventPush(EventQueue* events, SimEvent event) {
+    if (events->size == events->capacity) {
+        int capacity = events->capacity > 0 ? events->capacity * 2 : 8;
+        SimEvent* items = arenaGrow(runArena(), events->items,
+                                    (size_t)events->capacity * sizeof(SimEvent),
+                                    (size_t)capacity * sizeof(SimEvent));
+        if (items == NULL) {
+            return 0;
+        }
+        events->items = items;
+        events->capacity = capacity;
+    }
+
+    int k = events->size++;
+    while (k > 0) {
+        int parent = (k - 1) / 2;
+        SimEvent* up = &events->items[parent];
+        if (up->time < event.time ||
+            (up->time == event.time && up->type <= event.type)) {
+            break;
+        }
+        events->items[k] = *up;
+        k = parent;
+    }
+    events->items[k] = event;
+    return 1;
+}
+
+SimEvent eventPop(EventQueue* events) {
+    SimEvent top = events->items[0];
+    SimEvent last = events->items[--events->size];
+    int k = 0;
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= events->size) {
+            break;
+        }
+        SimEvent* c = &events->items[child];
+        if (child + 1 < events->size) {
+            SimEvent* r = &events->items[child + 1];
+            if (r->time < c->time || (r->time == c->time && r->type < c->type)) {
+                child++;
+                c = r;
+            }
+        }
+        if (last.time < c->time || (last.time == c->time && last.type <= c->type)) {
+            break;
+        }
+        events->items[k] = *c;
+        k = child;
+    }
+    events->items[k] = last;
+    return top;
+}
+
+// --- Printer Pool ---
+
+static inline int printerBefore(const PrinterPool* pool, int a, int b) {
+    if (pool->free_at[a] != pool->free_at[b]) {
+        return pool->free_at[a] < pool->free_at[b];
+    }
+    return a < b;
+}
+
+/**
+ * @brief Sets up a pool of `printers` printers, all free at time 0, in
+ * the run arena.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int initPrinterPool(PrinterPool* pool, int printers) {
+    Arena* arena = runArena();
+    pool->heap = arenaAlloc(arena, (size_t)printers * sizeof(int));
+    pool->free_at = arenaCalloc(arena, (size_t)printers, sizeof(long long));
+    if (pool->heap == NULL || pool->free_at == NULL) {
+        return 0;
+    }
+    for (int p = 0; p < printers; p++) {
+        pool->heap[p] = p; // Equal free times: already a valid heap
+    }
+    pool->size = printers;
+    return 1;
+}
+
+/**
+ * @brief Returns a printer to the pool; it becomes free at `free_at`.
+ */
+void printerPush(PrinterPool* pool, int printer, long long free_at) {
+    pool->free_at[printer] = free_at;
+    int k = pool->size++;
+    while (k > 0) {
+        int parent = (k - 1) / 2;
+        if (!printerBefore(pool, printer, pool->heap[parent])) {
+            break;
+        }
+        pool->heap[k] = pool->heap[parent];
+        k = parent;
+    }
+    pool->heap[k] = printer;
+}
+
+/**
+ * @brief Takes the printer that is free earliest out of the pool.
+ */
+int printerPop(PrinterPool* pool) {
+    int top = pool->heap[0];
+    int last = pool->heap[--pool->size];
+    int k = 0;
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= pool->size) {
+            break;
+        }
+        if (child + 1 < pool->size &&
+            printerBefore(pool, pool->heap[child + 1], pool->heap[child])) {
+            child++;
+        }
+        if (!printerBefore(pool, pool->heap[child], last)) {
+            break;
+        }
+        pool->heap[k] = pool->heap[child];
+        k = child;
+    }
+    pool->heap[k] = last;
+    return top;
+}
+
+/**
+ * @brief Hands out jobs in a fixed order to whichever printer frees up
+ * first, using the pool's min-heap of printer free times. Each job
+ * starts when both it and its printer are available.
+ *
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int assignPrinters(const PrintJob order[], int count, long long completion[],
+                   SimStats* stats) {
+    PrinterPool pool;
+    if (!initPrinterPool(&pool, stats->printers)) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        int printer = printerPop(&pool);
+        long long start = pool.free_at[printer];
+        if (start < order[i].arrival_time) {
+            start = order[i].arrival_time;
+        }
+        completion[i] = start + order[i].page_count;
+        stats->busy_time[printer] += order[i].page_count;
+        stats->jobs_printed[printer]++;
+        if (completion[i] > stats->makespan) {
+            stats->makespan = completion[i];
+        }
+        printerPush(&pool, printer, completion[i]);
+    }
+    return 1;
+}
+
+// --- Policy Simulators ---
+
+/**
+ * @brief Sort key of a job under aging. Its effective priority after
+ * waiting w is priority - w / aging_interval, so comparing two jobs at
+ * any common time `now` reduces to comparing
+ * arrival_time + aging_interval * priority: `now` cancels out. The key
+ * never changes while a job waits, so the ready heap never needs
+ * re-sorting as jobs age; it is a deadline, one aging_interval per
+ * priority level after arrival.
+ */
+static inline long long agingKey(const PrintJob* job) {
+    return job->arrival_time + (long long)aging_interval * job->priority;
+}
+
+// Returns 1 if simulated job `a` must run before `b` under `policy`.
+static ALWAYS_INLINE int readyBefore(SchedPolicy policy, const SimJob* a, const SimJob* b) {
+    switch (policy) {
+        case POLICY_AGING: {
+            long long key_a = agingKey(&a->job);
+            long long key_b = agingKey(&b->job);
+            if (key_a != key_b) {
+                return key_a < key_b;
+            }
+            return jobBefore(POLICY_FCFS, &a->job, &b->job);
+        }
+        case POLICY_SRTF:
+            if (a->remaining != b->remaining) {
+                return a->remaining < b->remaining;
+            }
+            return a->job.job_id < b->job.job_id;
+        case POLICY_PREEMPTIVE_PRIORITY:
+            return jobBefore(POLICY_PRIORITY, &a->job, &b->job);
+        default:
+            return jobBefore(policy, &a->job, &b->job);
+    }
+}
+
+static ALWAYS_INLINE void readyPush(ReadyQueue* ready, SchedPolicy policy,
+                                    const SimJob* job) {
+    int k = ready->size++;
+    while (k > 0) {
+        int parent = (k - 1) / 2;
+        if (!readyBefore(policy, job, &ready->items[parent])) {
+            break;
+        }
+        ready->items[k] = ready->items[parent];
+        k = parent;
+    }
+    ready->items[k] = *job;
+}
+
+static ALWAYS_INLINE SimJob readyPop(ReadyQueue* ready, SchedPolicy policy) {
+    SimJob top = ready->items[0];
+    SimJob last = ready->items[--ready->size];
+    int k = 0;
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= ready->size) {
+            break;
+        }
+        if (child + 1 < ready->size &&
+            readyBefore(policy, &ready->items[child + 1], &ready->items[child])) {
+            child++;
+        }
+        if (!readyBefore(policy, &ready->items[child], &last)) {
+            break;
+        }
+        ready->items[k] = ready->items[child];
+        k = child;
+    }
+    ready->items[k] = last;
+    return top;
+}
+
+// Arrival time of job `i` of an event loop's jobs
+static ALWAYS_INLINE long long loopArrival(int packed, const LoopJobs* jobs, int i) {
+    return packed ? packedArrival(jobs->packed->words[i]) : jobs->order[i].arrival_time;
+}
+
+// Queues job `i` of an event loop's jobs on `ready` as it arrives
+static ALWAYS_INLINE void loopArrive(SchedPolicy policy, int packed, const LoopJobs* jobs,
+                                     int i, ReadyQueue* ready) {
+    if (packed) {
+        packedReadyPush(ready->keys, &ready->size,
+                        packedReadyKey(policy, jobs->packed->words[i], i));
+    } else {
+        SimJob arrived = { jobs->order[i], jobs->order[i].page_count };
+        readyPush(ready, policy, &arrived);
+    }
+}
+
+// Takes the best job off `ready` as dispatch number `slot`, writes it to
+// the loop's output and returns its pages
+static ALWAYS_INLINE int loopDispatch(SchedPolicy policy, int packed, LoopJobs* jobs,
+                                      ReadyQueue* ready, int slot) {
+    if (packed) {
+        int next = (int)(uint32_t)packedReadyPop(ready->keys, &ready->size);
+        jobs->order_index[slot] = next;
+        return packedPages(jobs->packed->words[next]);
+    }
+    // Slot `slot` has always been read already: a job must arrive
+    // before it can be dispatched.
+    SimJob next = readyPop(ready, policy);
+    jobs->order[slot] = next.job;
+    return next.job.page_count;
+}
+
+/**
+ * @brief The event loop of every simulator that prints whole jobs in
+ * ready-heap order: scheduleJobs(), its sharded form and the packed
+ * simulators all run this one loop, inlined with their policy, layout
+ * and (for an unsharded run, 1) shard count as constants.
+ *
+ * Events (arrivals and completions) are processed in time order. Only
+ * the next arrival is ever held in the event queue, so it stays at most
+ * printers + 1 deep. Once every event at the current time has been
+ * handled, each shard's idle printers, earliest-freed first, take its
+ * own best waiting jobs; printer p belongs to shard p % shards, and a
+ * job waits on shard shardOf(its id). Then, with `steal`, a shard whose
+ * queue is empty and a printer idle takes the job that the shard with
+ * the most waiting would have dispatched next, and starts it steal_cost
+ * later. A steal touches only the two shards involved.
+ *
+ * @param packed 1 for LoopJobs in the packed layout, 0 for wide jobs.
+ * @param jobs The jobs, in arrival order; the dispatch order is written
+ * back through them.
+ * @param shard The shards, each with room in its ready queue for its
+ * home jobs, and its printers.
+ * @param completion Output: completion time of each dispatched job. May
+ * be NULL on a single unsharded printer, where jobs print back to back.
+ * @param stats Out: per-printer statistics and the jobs stolen, only
+ * filled in when `completion` is given.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+static ALWAYS_INLINE int runEventLoop(SchedPolicy policy, int packed, LoopJobs* jobs,
+                                      Shard shard[], int shards, int steal,
+                                      long long completion[], SimStats* stats) {
+    int count = jobs->count;
+    EventQueue events = { NULL, 0, 0 };
+    int dispatched = 0; // Jobs written to the dispatch order so far
+    int ok = eventPush(&events, (SimEvent){ loopArrival(packed, jobs, 0), EVENT_ARRIVAL, 0, -1 });
+
+    while (ok && events.size > 0) {
+        SimEvent event = eventPop(&events);
+        long long clock = event.time;
+
+        if (event.type == EVENT_ARRIVAL) {
+            int home = 0;
+            if (shards > 1) {
+                int job_id = packed ? packedJobId(jobs->packed, event.job)
+                                    : jobs->order[event.job].job_id;
+                home = shardOf(job_id, shards);
+            }
+            loopArrive(policy, packed, jobs, event.job, &shard[home].ready);
+            int next_arrival = event.job + 1;
+            if (next_arrival < count) {
+                ok = eventPush(&events, (SimEvent){ loopArrival(packed, jobs, next_arrival),
+                                                    EVENT_ARRIVAL, next_arrival, -1 });
+            }
+        } else {
+            printerPush(&shard[event.printer % shards].idle, event.printer / shards, clock);
+        }
+
+        // Dispatch only after every event at this instant is handled:
+        // first each shard from its own queue, then the idle ones steal
+        if (events.size > 0 && events.items[0].time == clock) {
+            continue;
+        }
+        for (int pass = 0; pass < (steal ? 2 : 1); pass++) {
+            for (int s = 0; ok && s < shards; s++) {
+                Shard* thief = &shard[s];
+                while (ok && thief->idle.size > 0) {
+                    Shard* from = (pass == 0) ? thief : deepestShard(shard, shards);
+                    if (from == NULL || from->ready.size == 0) {
+                        break;
+                    }
+                    long long start = clock;
+                    if (from != thief) {
+                        start += steal_cost;
+                        stats->jobs_stolen++;
+                    }
+                    int printer = printerPop(&thief->idle) * shards + s;
+                    int pages = loopDispatch(policy, packed, jobs, &from->ready, dispatched);
+                    long long done = start + pages;
+                    if (completion != NULL) {
+                        completion[dispatched] = done;
+                        stats->busy_time[printer] += pages;
+                        stats->jobs_printed[printer]++;
+                        if (done > stats->makespan) {
+                            stats->makespan = done;
+                        }
+                    }
+                    dispatched++;
+                    ok = eventPush(&events, (SimEvent){ done, EVENT_COMPLETION, -1, printer });
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Runs the discrete-event simulation of `stats->printers`
+ * printers and writes the jobs to `order` in the sequence `policy`
+ * dispatches them.
+ *
+ * The jobs run through runEventLoop() as one shard: once every event at
+ * the current time has been handled, each idle printer, earliest-freed
+ * first, takes the best waiting job according to the policy. Each event
+ * costs O(log n) at most, for the ready-queue update.
+ *
+ * Two shortcuts skip the event loop: FCFS always dispatches in arrival
+ * order, and when every job arrives at the same time the dispatch order
+ * is simply the jobs sorted by the policy's key. Either way the fixed
+ * order is then spread over the printers by assignPrinters().
+ *
+ * @param jobs The jobs to schedule (not modified).
+ * @param count The number of jobs.
+ * @param policy The dispatch policy.
+ * @param order Output array with room for `count` jobs.
+ * @param completion Output: completion time of each job in `order`. May
+ * be NULL on a single printer, where jobs print back to back.
+ * @param stats In: the printer count. Out: per-printer statistics, only
+ * filled in when `completion` is given.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+static ALWAYS_INLINE int scheduleJobs(const PrintJob jobs[], int count, SchedPolicy policy,
+                                      PrintJob order[], long long completion[],
+                                      SimStats* stats) {
+    if (order != jobs) {
+        memcpy(order, jobs, (size_t)count * sizeof(PrintJob));
+    }
+    if (count == 0) {
+        return 1;
+    }
+
+    int same_arrival = 1;
+    for (int i = 1; i < count && same_arrival; i++) {
+        same_arrival = (order[i].arrival_time == order[0].arrival_time);
+    }
+    int fixed_order = 1;
+    if (same_arrival && (policy == POLICY_SJF || policy == POLICY_PRIORITY)) {
+        sortForPolicy(order, count, policy);
+    } else if (same_arrival && policy == POLICY_AGING) {
+        // Equal arrivals age equally, leaving plain priority order
+        sortForPolicy(order, count, POLICY_PRIORITY);
+    } else {
+        // Arrival-ordered input for the event loop (and the FCFS answer)
+        if (!jobsInOrder(POLICY_FCFS, order, count)) {
+            sortJobsByArrival(order, count);
+        }
+        fixed_order = (policy == POLICY_FCFS);
+    }
+    if (fixed_order) {
+        return completion == NULL || assignPrinters(order, count, completion, stats);
+    }
+
+    Shard all = { .ready = { arenaAlloc(runArena(), (size_t)count * sizeof(SimJob)), 0, NULL } };
+    if (all.ready.items == NULL || !initPrinterPool(&all.idle, stats->printers)) {
+        return 0;
+    }
+    LoopJobs loop = { order, NULL, NULL, count };
+    return runEventLoop(policy, 0, &loop, &all, 1, 0, completion, stats);
+}
+
+/**
+ * @brief Runs the discrete-event simulation of `stats->printers`
+ * printers that can be interrupted between pages (SRTF or preemptive
+ * Priority).
+ *
+ * Whenever jobs arrive, idle printers are filled first. After that the
+ * best waiting job challenges the worst job currently printing; if it
+ * wins, the displaced job is put back with its remaining pages and that
+ * printer loses `context_switch_cost` time units before starting the
+ * newcomer. The ready heap makes each preemption O(log n), plus a scan
+ * of the printers for the weakest running job. A displaced job's old
+ * completion event is left in the event queue and recognised as stale
+ * by its slice stamp.
+ *
+ * @param jobs The jobs to schedule (not modified).
+ * @param count The number of jobs.
+ * @param policy POLICY_SRTF or POLICY_PREEMPTIVE_PRIORITY.
+ * @param order Output: the jobs in the order they complete.
+ * @param completion Output: completion time of each job in `order`.
+ * @param stats In: the printer count. Out: per-printer statistics and
+ * the number and cost of preemptions.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+static ALWAYS_INLINE int schedulePreemptive(const PrintJob jobs[], int count,
+                                            SchedPolicy policy, PrintJob order[],
+                                            long long completion[], SimStats* stats) {
+    if (order != jobs) {
+        memcpy(order, jobs, (size_t)count * sizeof(PrintJob));
+    }
+    if (count == 0) {
+        return 1;
+    }
+    if (!jobsInOrder(POLICY_FCFS, order, count)) {
+        sortJobsByArrival(order, count);
+    }
+
+    int printers = stats->printers;
+    Arena* arena = runArena();
+    ReadyQueue ready = { arenaAlloc(arena, (size_t)count * sizeof(SimJob)), 0, NULL };
+    EventQueue events = { NULL, 0, 0 };
+    PrinterPool idle;
+    SimJob* running = arenaAlloc(arena, (size_t)printers * sizeof(SimJob));
+    long long* slice_start = arenaAlloc(arena, (size_t)printers * sizeof(long long));
+    int* slice_stamp = arenaCalloc(arena, (size_t)printers, sizeof(int));
+    int ok = (ready.items != NULL && running != NULL && slice_start != NULL &&
+              slice_stamp != NULL);
+    if (!ok || !initPrinterPool(&idle, printers)) {
+        return 0;
+    }
+
+    int done = 0; // Jobs written back to `order` so far
+    ok = eventPush(&events, (SimEvent){ order[0].arrival_time, EVENT_ARRIVAL, 0, -1 });
+
+    while (ok && events.size > 0) {
+        SimEvent event = eventPop(&events);
+        long long clock = event.time;
+
+        if (event.type == EVENT_ARRIVAL) {
+            SimJob arrived = { order[event.job], order[event.job].page_count };
+            readyPush(&ready, policy, &arrived);
+            int next_arrival = event.job + 1;
+            if (next_arrival < count) {
+                ok = eventPush(&events, (SimEvent){ order[next_arrival].arrival_time,
+                                                    EVENT_ARRIVAL, next_arrival, -1 });
+            }
+        } else if (event.job == slice_stamp[event.printer]) {
+            // Slot `done` has always been read already: a job must
+            // arrive before it can complete.
+            int p = event.printer;
+            order[done] = running[p].job;
+            completion[done] = clock;
+            done++;
+            stats->busy_time[p] += clock - slice_start[p];
+            stats->jobs_printed[p]++;
+            stats->makespan = clock;
+            slice_stamp[p]++; // Nothing is running on it any more
+            printerPush(&idle, p, clock);
+        }
+
+        // Decide only after every event at this instant is handled
+        if (events.size > 0 && events.items[0].time == clock) {
+            continue;
+        }
+
+        while (ok && ready.size > 0) {
+            int printer;
+            long long switch_delay = 0;
+            if (idle.size > 0) {
+                printer = printerPop(&idle);
+            } else {
+                // Bring every running job's progress up to date and find
+                // the one the policy ranks last.
+                int worst = -1;
+                for (int p = 0; p < printers; p++) {
+                    if (clock > slice_start[p]) {
+                        running[p].remaining -= (int)(clock - slice_start[p]);
+                        stats->busy_time[p] += clock - slice_start[p];
+                        slice_start[p] = clock;
+                    }
+                    if (worst < 0 || readyBefore(policy, &running[worst], &running[p])) {
+                        worst = p;
+                    }
+                }
+                if (!readyBefore(policy, &ready.items[0], &running[worst])) {
+                    break;
+                }
+                printer = worst;
+                SimJob displaced = running[printer];
+                // The newcomer is popped before the displaced job goes
+                // back, so the two never trade places in one step.
+                running[printer] = readyPop(&ready, policy);
+                readyPush(&ready, policy, &displaced);
+                stats->preemptions++;
+                switch_delay = context_switch_cost;
+                slice_start[printer] = clock + switch_delay;
+                stats->switch_overhead += switch_delay;
+                stats->busy_time[printer] += switch_delay;
+                slice_stamp[printer]++;
+                ok = eventPush(&events, (SimEvent){
+                    slice_start[printer] + running[printer].remaining,
+                    EVENT_COMPLETION, slice_stamp[printer], printer });
+                continue;
+            }
+
+            running[printer] = readyPop(&ready, policy);
+            slice_start[printer] = clock;
+            slice_stamp[printer]++;
+            ok = eventPush(&events, (SimEvent){ clock + running[printer].remaining,
+                                                EVENT_COMPLETION, slice_stamp[printer],
+                                                printer });
+        }
+    }
 
-#define MAX_JOBS 100 // Maximum number of jobs in the queue
+    return ok;
+}
 
-// Structure to represent a single print job
-typedef struct {
-    int job_id;
-    int page_count; // Analogous to "Burst Time"
-    int priority;   // Lower number = higher priority
-} PrintJob;
+// Appends the job at arrival index `j` to queue `q`.
+static inline void sliceQueuePush(SliceQueues* queues, int q, int j) {
+    queues->next[j] = -1;
+    if (queues->head[q] < 0) {
+        queues->head[q] = j;
+        queues->nonempty |= 1u << q;
+    } else {
+        queues->next[queues->tail[q]] = j;
+    }
+    queues->tail[q] = j;
+}
 
-// --- Global Variables ---
-PrintJob job_queue[MAX_JOBS]; // This is our main job queue
-int job_count = 0;            // Number of jobs currently in the queue
-int next_job_id = 1;          // To assign unique IDs
+// Removes and returns the arrival index at the head of non-empty queue `q`.
+static inline int sliceQueuePop(SliceQueues* queues, int q) {
+    int j = queues->head[q];
+    queues->head[q] = queues->next[j];
+    if (queues->head[q] < 0) {
+        queues->nonempty &= ~(1u << q);
+    }
+    return j;
+}
 
-// --- Function Declarations ---
-void addJob();
-void runFCFS();
-void runSJF();
-void runPriority();
-void displayQueue();
-void calculateMetrics(PrintJob queue[], int count, const char* algorithmName);
+// Queue a job joins on arrival: the top MLFQ level, or its DRR class.
+static inline int sliceQueueOf(SchedPolicy policy, const PrintJob* job) {
+    if (policy == POLICY_MLFQ) {
+        return 0;
+    }
+    return (job->priority >= 1 && job->priority <= PRIORITY_CLASSES) ? job->priority : 0;
+}
 
-// --- qsort Comparator Functions ---
+/**
+ * @brief Picks the next job under deficit round robin. The class whose
+ * turn it is receives drr_quantum * weight pages of credit once per
+ * visit and sends head jobs while its credit covers them; then the
+ * turn passes on. A class that empties forfeits its credit. When a full
+ * round sends nothing, the rounds that would also send nothing are
+ * credited in one step, so a dispatch costs O(classes) however large
+ * the jobs are relative to the quantum.
+ *
+ * @return The arrival index of the job, to be printed whole. The queues
+ * must not be empty.
+ */
+static int drrPop(SliceQueues* queues) {
+    const int classes = PRIORITY_CLASSES + 1;
+    int passed = 0; // Turns passed on since anything was sent
+    for (;;) {
+        int c = queues->turn;
+        if (queues->head[c] >= 0) {
+            if (!queues->credited) {
+                queues->deficit[c] += (long long)drr_quantum * drr_weights[c];
+                queues->credited = 1;
+            }
+            int j = queues->head[c];
+            if (queues->jobs[j].remaining <= queues->deficit[c]) {
+                queues->deficit[c] -= queues->jobs[j].remaining;
+                sliceQueuePop(queues, c);
+                if (queues->head[c] < 0) {
+                    queues->deficit[c] = 0;
+                    queues->turn = (c + 1) % classes;
+                    queues->credited = 0;
+                }
+                return j;
+            }
+        }
+        queues->turn = (c + 1) % classes;
+        queues->credited = 0;
 
-// Comparator for Shortest Job First (SJF)
-// Sorts based on page_count (ascending)
-int compareSJF(const void* a, const void* b) {
-    PrintJob* jobA = (PrintJob*)a;
-    PrintJob* jobB = (PrintJob*)b;
-    return (jobA->page_count - jobB->page_count);
+        if (++passed == classes) {
+            // Every waiting class was credited this round and none could
+            // send: skip to the round in which the first one can.
+            long long rounds = LLONG_MAX;
+            for (int k = 0; k < classes; k++) {
+                if (queues->head[k] >= 0) {
+                    long long quantum = (long long)drr_quantum * drr_weights[k];
+                    long long short_by = queues->jobs[queues->head[k]].remaining -
+                                         queues->deficit[k];
+                    long long needed = (short_by + quantum - 1) / quantum;
+                    if (needed < rounds) {
+                        rounds = needed;
+                    }
+                }
+            }
+            for (int k = 0; k < classes && rounds > 1; k++) {
+                if (queues->head[k] >= 0) {
+                    queues->deficit[k] += (rounds - 1) * drr_quantum * drr_weights[k];
+                }
+            }
+            passed = 0;
+        }
+    }
 }
 
-// Comparator for Priority Scheduling
-// Sorts based on priority (ascending)
-// If priorities are equal, uses job_id (FCFS) as a tie-breaker
-int comparePriority(const void* a, const void* b) {
-    PrintJob* jobA = (PrintJob*)a;
-    PrintJob* jobB = (PrintJob*)b;
+/**
+ * @brief Runs the discrete-event simulation of `stats->printers`
+ * printers for the queue-based policies: MLFQ and deficit round robin.
+ *
+ * Under MLFQ every job arrives at the top level and idle printers serve
+ * the highest non-empty level, found from a bit mask in O(1). A job runs
+ * for at most its level's quantum (mlfq_quanta); if pages remain it
+ * drops one level, down to the last, and rejoins the tail of that queue.
+ * Arrivals wait for the next quantum boundary rather than interrupting a
+ * slice, so only quantum expiry preempts. A printer that then switches
+ * to a different job loses `context_switch_cost` first.
+ *
+ * Under DRR each priority class has its own FIFO and drrPop() shares
+ * the printers between the classes in proportion to drr_weights. Jobs
+ * print whole, so DRR never preempts.
+ *
+ * @param jobs The jobs to schedule (not modified).
+ * @param count The number of jobs.
+ * @param policy POLICY_MLFQ or POLICY_DRR.
+ * @param order Output: the jobs in the order they complete.
+ * @param completion Output: completion time of each job in `order`.
+ * @param stats In: the printer count. Out: per-printer statistics and
+ * the number and cost of preemptions.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+static ALWAYS_INLINE int scheduleSliced(const PrintJob jobs[], int count,
+                                        SchedPolicy policy, PrintJob order[],
+                                        long long completion[], SimStats* stats) {
+    if (order != jobs) {
+        memcpy(order, jobs, (size_t)count * sizeof(PrintJob));
+    }
+    if (count == 0) {
+        return 1;
+    }
+    if (!jobsInOrder(POLICY_FCFS, order, count)) {
+        sortJobsByArrival(order, count);
+    }
 
-    if (jobA->priority != jobB->priority) {
-        return (jobA->priority - jobB->priority);
-    } else {
-        // Tie-breaker: First-Come, First-Served
-        return (jobA->job_id - jobB->job_id);
+    int printers = stats->printers;
+    SliceQueues queues;
+    memset(&queues, 0, sizeof(queues));
+    for (int q = 0; q < MAX_MLFQ_LEVELS; q++) {
+        queues.head[q] = -1;
+    }
+    Arena* arena = runArena();
+    queues.jobs = arenaAlloc(arena, (size_t)count * sizeof(SimJob));
+    queues.next = arenaAlloc(arena, (size_t)count * sizeof(int));
+    EventQueue events = { NULL, 0, 0 };
+    PrinterPool idle;
+    int* running = arenaAlloc(arena, (size_t)printers * sizeof(int));  // Arrival index on each printer
+    int* level = arenaAlloc(arena, (size_t)printers * sizeof(int));    // Queue it was taken from
+    int* slice = arenaAlloc(arena, (size_t)printers * sizeof(int));    // Pages in its current slice
+    int* last_job = arenaAlloc(arena, (size_t)printers * sizeof(int)); // Unfinished job it last ran, or -1
+    int ok = (queues.jobs != NULL && queues.next != NULL && running != NULL &&
+              level != NULL && slice != NULL && last_job != NULL);
+    if (!ok || !initPrinterPool(&idle, printers)) {
+        return 0;
+    }
+    for (int p = 0; p < printers; p++) {
+        last_job[p] = -1;
     }
-}
 
+    int done = 0; // Jobs written back to `order` so far
+    ok = eventPush(&events, (SimEvent){ order[0].arrival_time, EVENT_ARRIVAL, 0, -1 });
 
-// --- Main Function ---
-int main() {
-    int choice = 0;
+    while (ok && events.size > 0) {
+        SimEvent event = eventPop(&events);
+        long long clock = event.time;
 
-    while (1) {
-        printf("\n--- Print Job Spooler Simulation ---\n");
-        printf("1. Add Print Job\n");
-        printf("2. Display Current Queue (Unsorted)\n");
-        printf("3. Run FCFS Simulation\n");
-        printf("4. Run SJF Simulation\n");
-        printf("5. Run Priority Simulation\n");
-        printf("6. Exit\n");
-        printf("--------------------------------------\n");
-        printf("Enter your choice: ");
+        if (event.type == EVENT_ARRIVAL) {
+            int j = event.job;
+            queues.jobs[j] = (SimJob){ order[j], order[j].page_count };
+            sliceQueuePush(&queues, sliceQueueOf(policy, &order[j]), j);
+            int next_arrival = j + 1;
+            if (next_arrival < count) {
+                ok = eventPush(&events, (SimEvent){ order[next_arrival].arrival_time,
+                                                    EVENT_ARRIVAL, next_arrival, -1 });
+            }
+        } else {
+            int p = event.printer;
+            int j = running[p];
+            queues.jobs[j].remaining -= slice[p];
+            stats->busy_time[p] += slice[p];
+            if (queues.jobs[j].remaining == 0) {
+                // Slot `done` has always been read already: a job must
+                // arrive before it can complete.
+                order[done] = queues.jobs[j].job;
+                completion[done] = clock;
+                done++;
+                stats->jobs_printed[p]++;
+                stats->makespan = clock;
+                last_job[p] = -1;
+            } else {
+                int demoted = level[p] + 1 < mlfq_levels ? level[p] + 1 : level[p];
+                sliceQueuePush(&queues, demoted, j);
+                last_job[p] = j;
+            }
+            printerPush(&idle, p, clock);
+        }
 
-        if (scanf("%d", &choice) != 1) {
-            // Clear invalid input
-            while (getchar() != '\n');
-            printf("Invalid input. Please enter a number.\n");
+        // Dispatch only after every event at this instant is handled
+        if (events.size > 0 && events.items[0].time == clock) {
             continue;
         }
+        while (ok && idle.size > 0 && queues.nonempty != 0) {
+            int p = printerPop(&idle);
+            int j;
+            if (policy == POLICY_MLFQ) {
+                level[p] = __builtin_ctz(queues.nonempty);
+                j = sliceQueuePop(&queues, level[p]);
+                int quantum = mlfq_quanta[level[p]];
+                slice[p] = queues.jobs[j].remaining < quantum
+                    ? queues.jobs[j].remaining : quantum;
+            } else {
+                j = drrPop(&queues);
+                level[p] = sliceQueueOf(policy, &queues.jobs[j].job);
+                slice[p] = queues.jobs[j].remaining;
+            }
+            running[p] = j;
 
-        switch (choice) {
-            case 1:
-                addJob();
-                break;
-            case 2:
-                displayQueue();
-                break;
-            case 3:
-                runFCFS();
-                break;
-            case 4:
-                runSJF();
-                break;
-            case 5:
-                runPriority();
-                break;
-            case 6:
-                printf("Exiting simulation. Goodbye!\n");
-                return 0;
-            default:
-                printf("Invalid choice. Please try again.\n");
+            long long start = clock;
+            if (last_job[p] >= 0 && last_job[p] != j) {
+                // The printer interrupted a job to take this one
+                stats->preemptions++;
+                stats->switch_overhead += context_switch_cost;
+                stats->busy_time[p] += context_switch_cost;
+                start += context_switch_cost;
+            }
+            last_job[p] = -1;
+            ok = eventPush(&events, (SimEvent){ start + slice[p], EVENT_COMPLETION,
+                                                -1, p });
         }
     }
 
-    return 0;
+    return ok;
 }
 
-// --- Function Implementations ---
+// Defines `fn`, the simulator `engine` specialised for `policy`. The
+// engine is inlined with the policy constant, so its heap comparisons
+// compile down to that policy's own key test with no switch or call.
+#define SPECIALIZE_SCHEDULER(fn, engine, policy)                            \
+    static int fn(const PrintJob jobs[], int count, PrintJob order[],       \
+                  long long completion[], SimStats* stats) {                \
+        return engine(jobs, count, policy, order, completion, stats);       \
+    }
+
+SPECIALIZE_SCHEDULER(scheduleFCFS, scheduleJobs, POLICY_FCFS)
+SPECIALIZE_SCHEDULER(scheduleSJF, scheduleJobs, POLICY_SJF)
+SPECIALIZE_SCHEDULER(schedulePriority, scheduleJobs, POLICY_PRIORITY)
+SPECIALIZE_SCHEDULER(scheduleAging, scheduleJobs, POLICY_AGING)
+SPECIALIZE_SCHEDULER(scheduleSRTF, schedulePreemptive, POLICY_SRTF)
+SPECIALIZE_SCHEDULER(schedulePreemptivePriority, schedulePreemptive,
+                     POLICY_PREEMPTIVE_PRIORITY)
+SPECIALIZE_SCHEDULER(scheduleMLFQ, scheduleSliced, POLICY_MLFQ)
+SPECIALIZE_SCHEDULER(scheduleDRR, scheduleSliced, POLICY_DRR)
+
+// --- Sharded Spools ---
 
 /**
- * @brief Adds a new job to the global job_queue.
- * Takes user input for page count and priority.
+ * @brief Number of shards a run of `policy` on `printers` printers is
+ * split into: --shards, capped at one printer per shard, for the
+ * policies that print whole jobs in heap order. The others drive their
+ * printers from a single queue, so they run as one shard.
  */
-void addJob() {
-    if (job_count >= MAX_JOBS) {
-        printf("Error: Print queue is full. Cannot add more jobs.\n");
-        return;
+int shardsInEffect(SchedPolicy policy, int printers) {
+    if (!policy_ops[policy].back_to_back) {
+        return 1;
     }
+    return shard_count < printers ? shard_count : printers;
+}
 
-    PrintJob newJob;
-    newJob.job_id = next_job_id++;
-
-    printf("  Enter Page Count (e.g., 50): ");
-    scanf("%d", &newJob.page_count);
+// Home shard of a job, spreading ids evenly by their hashed high bits
+static inline int shardOf(int job_id, int shards) {
+    uint32_t hash = (uint32_t)job_id * 2654435761u;
+    return (int)(((uint64_t)hash * (uint32_t)shards) >> 32);
+}
 
-    printf("  Enter Priority (1=Faculty, 2=Student, 3=Guest): ");
-    scanf("%d", &newJob.priority);
+// The shard with the most jobs waiting, or NULL if none has any
+static Shard* deepestShard(Shard shard[], int shards) {
+    Shard* deepest = NULL;
+    for (int s = 0; s < shards; s++) {
+        if (shard[s].ready.size > 0 &&
+            (deepest == NULL || shard[s].ready.size > deepest->ready.size)) {
+            deepest = &shard[s];
+        }
+    }
+    return deepest;
+}
 
-    if (newJob.page_count <= 0 || newJob.priority <= 0) {
-        printf("Error: Page count and priority must be positive.\n");
-        next_job_id--; // Roll back the ID
-        return;
+/**
+ * @brief Runs the discrete-event simulation of a spool split into
+ * `shards` shards, each with its own ready queue under `policy` and its
+ * own printers (printer p belongs to shard p % shards). Every job is
+ * queued on its home shard, by its id, and runEventLoop() dispatches
+ * them: each shard first from its own queue, then, with `steal`, from
+ * the deepest one - the cheapest job under SJF, the most urgent under
+ * Priority. Nothing is ever ranked across the whole spool.
+ *
+ * @param order Output: the jobs in the order they are dispatched.
+ * @param completion Output: completion time of each job in `order`.
+ * @param stats In: the printer count. Out: per-printer statistics and
+ * the jobs stolen.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int scheduleSharded(const PrintJob jobs[], int count, SchedPolicy policy, int shards,
+                    int steal, PrintJob order[], long long completion[], SimStats* stats) {
+    if (order != jobs) {
+        memcpy(order, jobs, (size_t)count * sizeof(PrintJob));
+    }
+    if (count == 0) {
+        return 1;
+    }
+    if (!jobsInOrder(POLICY_FCFS, order, count)) {
+        sortJobsByArrival(order, count);
     }
 
-    job_queue[job_count] = newJob;
-    job_count++;
+    Arena* arena = runArena();
+    Shard* shard = arenaCalloc(arena, (size_t)shards, sizeof(Shard));
+    if (shard == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        shard[shardOf(order[i].job_id, shards)].home++;
+    }
+    for (int s = 0; s < shards; s++) {
+        shard[s].ready.items = arenaAlloc(arena, (size_t)shard[s].home * sizeof(SimJob) + 1);
+        int printers = (stats->printers - s + shards - 1) / shards;
+        if (shard[s].ready.items == NULL || !initPrinterPool(&shard[s].idle, printers)) {
+            return 0;
+        }
+    }
 
-    printf("  Success: Added Job %d (%d pages, priority %d).\n",
-           newJob.job_id, newJob.page_count, newJob.priority);
+    LoopJobs loop = { order, NULL, NULL, count };
+    return runEventLoop(policy, 0, &loop, shard, shards, steal, completion, stats);
 }
 
 /**
- * @brief Displays all jobs currently in the queue in their arrival order.
+ * @brief Prints how a sharded run spread its jobs: each shard's printers,
+ * home jobs, jobs printed and utilization, the jobs stolen, and the
+ * average, p99 and maximum wait against the same shards without
+ * stealing.
  */
-void displayQueue() {
-    if (job_count == 0) {
-        printf("The print queue is currently empty.\n");
-        return;
+static void reportSharding(const PrintJob jobs[], int count, SchedPolicy policy,
+                           const SimStats* stats, const SimResult* result,
+                           const LatencyStats* latency) {
+    int shards = shardsInEffect(policy, stats->printers);
+    int home[MAX_PRINTERS] = { 0 };
+    for (int i = 0; i < count; i++) {
+        home[shardOf(jobs[i].job_id, shards)]++;
     }
+    printf("\nShard | Printers | Home Jobs  | Printed    | Utilization\n");
+    printf("--------------------------------------------------------\n");
+    for (int s = 0; s < shards; s++) {
+        int printers = 0;
+        int printed = 0;
+        long long busy = 0;
+        for (int p = s; p < stats->printers; p += shards) {
+            printers++;
+            printed += stats->jobs_printed[p];
+            busy += stats->busy_time[p];
+        }
+        double utilization = stats->makespan > 0
+            ? 100.0 * busy / ((double)stats->makespan * printers) : 0.0;
+        printf("%-5d | %-8d | %-10d | %-10d | %6.2f%%\n",
+               s + 1, printers, home[s], printed, utilization);
+    }
+    printf("--------------------------------------------------------\n");
+    printf("Jobs Stolen:              %d (%.2f%%, %d time units each)\n",
+           stats->jobs_stolen, count > 0 ? 100.0 * stats->jobs_stolen / count : 0.0,
+           steal_cost);
 
-    printf("\n--- Current Print Queue (FCFS Order) ---\n");
-    printf("Job ID | Page Count | Priority\n");
-    printf("----------------------------------\n");
-    for (int i = 0; i < job_count; i++) {
-        printf("%-6d | %-10d | %-8d\n",
-               job_queue[i].job_id,
-               job_queue[i].page_count,
-               job_queue[i].priority);
+    if (!shard_stealing || setup_cost > 0 || coalesce_pages > 0) {
+        return; // Nothing to set against, or runs that are not the jobs
+    }
+    const LatencyHistogram* waits[PRIORITY_CLASSES + 1];
+    for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+        waits[c] = &latency->wait[c];
+    }
+    long long p99 = histogramPercentile(waits, PRIORITY_CLASSES + 1, 0.99);
+
+    // The same shards left to themselves
+    SimStats alone;
+    initSimStats(&alone, stats->printers);
+    PrintJob* order = malloc((size_t)count * sizeof(PrintJob) + 1);
+    long long* completion = malloc((size_t)count * sizeof(long long) + 1);
+    LatencyStats* alone_latency = malloc(sizeof(LatencyStats));
+    int ok = (order != NULL && completion != NULL && alone_latency != NULL &&
+              scheduleSharded(jobs, count, policy, shards, 0, order, completion, &alone));
+    arenaReset(runArena());
+    if (ok) {
+        SimResult alone_result;
+        summarizeRun(order, completion, count, &alone, &alone_result, alone_latency);
+        for (int c = 0; c <= PRIORITY_CLASSES; c++) {
+            waits[c] = &alone_latency->wait[c];
+        }
+        printf("  Without stealing:       avg wait %.2f, p99 wait %lld, max wait %lld\n",
+               alone_result.avg_wait_time,
+               histogramPercentile(waits, PRIORITY_CLASSES + 1, 0.99),
+               alone_result.max_wait_time);
+        printf("  With stealing:          avg wait %.2f, p99 wait %lld, max wait %lld\n",
+               result->avg_wait_time, p99, result->max_wait_time);
+    } else {
+        printf("Error: Out of memory. Cannot compare against shards without stealing.\n");
     }
+    free(order);
+    free(completion);
+    free(alone_latency);
+}
+
+// --- Packed Jobs ---
+
+static inline int packedArrival(uint64_t word) {
+    return (int)(word & ((1u << PACKED_ARRIVAL_BITS) - 1));
+}
+
+static inline int packedPages(uint64_t word) {
+    return (int)((word >> PACKED_PAGE_SHIFT) & ((1u << PACKED_PAGE_BITS) - 1));
+}
+
+static inline int packedPriority(uint64_t word) {
+    return (int)((word >> PACKED_PRIORITY_SHIFT) & ((1u << PACKED_PRIORITY_BITS) - 1));
+}
+
+static inline int packedJobId(const PackedJobs* packed, int i) {
+    return packed->base_id + i + (int)(packed->words[i] >> PACKED_ID_SHIFT);
+}
+
+static inline void unpackJob(const PackedJobs* packed, int i, PrintJob* job) {
+    uint64_t word = packed->words[i];
+    job->job_id = packedJobId(packed, i);
+    job->page_count = packedPages(word);
+    job->priority = packedPriority(word);
+    job->arrival_time = packedArrival(word);
 }
 
 /**
- * @brief Runs the FCFS simulation.
- * It's the simplest: just processes the queue as-is.
+ * @brief Checks that `jobs` fit the packed layout: in FCFS order with
+ * ids rising, ids at most 2^14 - 1 past consecutive, page counts below
+ * 2^16 and priorities below 2^3. Anything else keeps the wide layout.
+ * @return 1 if the jobs can be packed, 0 if not.
  */
-void runFCFS() {
-    if (job_count == 0) {
-        printf("Cannot run simulation: The print queue is empty.\n");
-        return;
+int jobsPackable(const PrintJob jobs[], int count) {
+    if (count == 0) {
+        return 1;
+    }
+    int base_id = jobs[0].job_id;
+    for (int i = 0; i < count; i++) {
+        const PrintJob* job = &jobs[i];
+        long long delta = (long long)job->job_id - base_id - i;
+        if (job->page_count < 1 || job->page_count >= (1 << PACKED_PAGE_BITS) ||
+            job->priority < 0 || job->priority >= (1 << PACKED_PRIORITY_BITS) ||
+            delta < 0 || delta >= (1 << PACKED_ID_BITS) ||
+            (i > 0 && (job->arrival_time < jobs[i - 1].arrival_time ||
+                       job->job_id <= jobs[i - 1].job_id))) {
+            return 0;
+        }
     }
-    // FCFS processes the queue in its original order.
-    // No sorting is needed.
-    calculateMetrics(job_queue, job_count, "First-Come, First-Served (FCFS)");
+    return 1;
 }
 
 /**
- * @brief Runs the SJF simulation.
- * Creates a copy of the queue, sorts it by page_count,
- * and then calculates metrics.
+ * @brief Packs `jobs`, which must pass jobsPackable(), into `packed`.
+ * The id deltas only grow along the array, since ids rise at least one
+ * per job.
+ * @return 1 on success, 0 if memory could not be allocated.
  */
-void runSJF() {
-    if (job_count == 0) {
-        printf("Cannot run simulation: The print queue is empty.\n");
-        return;
+int packJobs(const PrintJob jobs[], int count, PackedJobs* packed) {
+    packed->words = malloc((size_t)count * sizeof(uint64_t) + 1);
+    packed->count = count;
+    packed->base_id = count > 0 ? jobs[0].job_id : 0;
+    if (packed->words == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t delta = (uint64_t)(jobs[i].job_id - packed->base_id - i);
+        packed->words[i] = (uint64_t)jobs[i].arrival_time |
+                           (uint64_t)jobs[i].page_count << PACKED_PAGE_SHIFT |
+                           (uint64_t)jobs[i].priority << PACKED_PRIORITY_SHIFT |
+                           delta << PACKED_ID_SHIFT;
     }
+    return 1;
+}
 
-    // 1. Create a temporary copy of the queue to sort
-    PrintJob temp_queue[MAX_JOBS];
-    memcpy(temp_queue, job_queue, job_count * sizeof(PrintJob));
+void freePackedJobs(PackedJobs* packed) {
+    free(packed->words);
+    packed->words = NULL;
+}
 
-    // 2. Sort the temporary queue using qsort with the SJF comparator
-    qsort(temp_queue, job_count, sizeof(PrintJob), compareSJF);
+/**
+ * @brief Checks that `policy` has a packed simulator and that its heap
+ * keys fit 32 bits for these jobs (aging adds aging_interval per
+ * priority level to the arrival time).
+ * @return 1 if runPackedPolicy() can run it, 0 to use the wide layout.
+ */
+int packedPolicyFits(const PackedJobs* packed, SchedPolicy policy) {
+    if (policy_ops[policy].schedule_packed == NULL) {
+        return 0;
+    }
+    if (policy == POLICY_AGING && packed->count > 0) {
+        long long last = packedArrival(packed->words[packed->count - 1]);
+        return last + (long long)aging_interval * ((1 << PACKED_PRIORITY_BITS) - 1) <=
+               (long long)UINT32_MAX;
+    }
+    return 1;
+}
 
-    // 3. Calculate metrics on the sorted queue
-    calculateMetrics(temp_queue, job_count, "Shortest Job First (SJF)");
+/**
+ * @brief Stable counting sort of job indexes by one packed field, read
+ * straight from the words. Equal keys keep index (so job_id) order.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+static int countingSortPacked(const PackedJobs* packed, int shift, int bits, int order[]) {
+    const uint64_t* words = packed->words;
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    int max_key = 0;
+    for (int i = 0; i < packed->count; i++) {
+        int key = (int)((words[i] >> shift) & mask);
+        if (key > max_key) {
+            max_key = key;
+        }
+    }
+    int* starts = arenaCalloc(runArena(), (size_t)max_key + 2, sizeof(int));
+    if (starts == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < packed->count; i++) {
+        starts[((words[i] >> shift) & mask) + 1]++;
+    }
+    for (int key = 1; key <= max_key; key++) {
+        starts[key] += starts[key - 1];
+    }
+    for (int i = 0; i < packed->count; i++) {
+        order[starts[(words[i] >> shift) & mask]++] = i;
+    }
+    return 1;
 }
 
 /**
- * @brief Runs the Priority simulation.
- * Creates a copy of the queue, sorts it by priority,
- * and then calculates metrics.
+ * @brief Hands out jobs in the fixed `order` to whichever printer frees
+ * up first, as assignPrinters() does for wide jobs.
+ * @return 1 on success, 0 if memory could not be allocated.
  */
-void runPriority() {
-    if (job_count == 0) {
-        printf("Cannot run simulation: The print queue is empty.\n");
-        return;
+static int assignPackedPrinters(const PackedJobs* packed, const int order[],
+                                long long completion[], SimStats* stats) {
+    PrinterPool pool;
+    if (!initPrinterPool(&pool, stats->printers)) {
+        return 0;
+    }
+    for (int i = 0; i < packed->count; i++) {
+        uint64_t word = packed->words[order[i]];
+        int printer = printerPop(&pool);
+        long long start = pool.free_at[printer];
+        if (start < packedArrival(word)) {
+            start = packedArrival(word);
+        }
+        completion[i] = start + packedPages(word);
+        stats->busy_time[printer] += packedPages(word);
+        stats->jobs_printed[printer]++;
+        if (completion[i] > stats->makespan) {
+            stats->makespan = completion[i];
+        }
+        printerPush(&pool, printer, completion[i]);
     }
+    return 1;
+}
 
-    // 1. Create a temporary copy
-    PrintJob temp_queue[MAX_JOBS];
-    memcpy(temp_queue, job_queue, job_count * sizeof(PrintJob));
+// Ready-heap entry of packed job `index`: the policy's key above the
+// index, so one integer compare gives the key and then the job_id order
+static ALWAYS_INLINE uint64_t packedReadyKey(SchedPolicy policy, uint64_t word, int index) {
+    uint64_t key;
+    switch (policy) {
+        case POLICY_SJF:
+            key = (uint64_t)packedPages(word);
+            break;
+        case POLICY_PRIORITY:
+            key = (uint64_t)packedPriority(word);
+            break;
+        default: // POLICY_AGING; packedPolicyFits() bounds it to 32 bits
+            key = (uint64_t)packedArrival(word) + (uint64_t)aging_interval * packedPriority(word);
+            break;
+    }
+    return key << 32 | (uint32_t)index;
+}
 
-    // 2. Sort the copy using qsort with the Priority comparator
-    qsort(temp_queue, job_count, sizeof(PrintJob), comparePriority);
+static inline void packedReadyPush(uint64_t heap[], int* size, uint64_t entry) {
+    int k = (*size)++;
+    while (k > 0 && entry < heap[(k - 1) / 2]) {
+        heap[k] = heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    heap[k] = entry;
+}
 
-    // 3. Calculate metrics on the sorted queue
-    calculateMetrics(temp_queue, job_count, "Priority Scheduling");
+static inline uint64_t packedReadyPop(uint64_t heap[], int* size) {
+    uint64_t top = heap[0];
+    uint64_t last = heap[--(*size)];
+    int k = 0;
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= *size) {
+            break;
+        }
+        if (child + 1 < *size && heap[child + 1] < heap[child]) {
+            child++;
+        }
+        if (last <= heap[child]) {
+            break;
+        }
+        heap[k] = heap[child];
+        k = child;
+    }
+    heap[k] = last;
+    return top;
 }
 
 /**
- * @brief The core logic engine. Calculates and prints performance
- * metrics for a given (potentially sorted) queue.
+ * @brief scheduleJobs() for packed jobs: the same shortcuts and the same
+ * runEventLoop(), but the ready heap holds one 8-byte key per job
+ * instead of a 20-byte job, the all-at-once sorts count the packed
+ * fields directly and the dispatch order comes out as 4-byte indexes.
+ * Nothing is unpacked into PrintJobs, and the result matches the wide
+ * simulator's.
  *
- * @param queue The array of print jobs to process.
- * @param count The number of jobs in the array.
- * @param algorithmName The name of the algorithm for display.
+ * @param jobs The packed jobs, in FCFS order.
+ * @param policy FCFS, SJF, Priority or Aging.
+ * @param order Output: the jobs' indexes in dispatch order.
+ * @param completion Output: completion time of each job in `order`. May
+ * be NULL on a single printer, where jobs print back to back.
+ * @param stats In: the printer count. Out: per-printer statistics, only
+ * filled in when `completion` is given.
+ * @return 1 on success, 0 if memory could not be allocated.
  */
-void calculateMetrics(PrintJob queue[], int count, const char* algorithmName) {
-    double total_wait_time = 0;
-    double total_turnaround_time = 0;
-    int current_time = 0; // Represents the printer's clock
+static ALWAYS_INLINE int schedulePacked(const PackedJobs* jobs, SchedPolicy policy,
+                                        int order[], long long completion[],
+                                        SimStats* stats) {
+    int count = jobs->count;
+    if (count == 0) {
+        return 1;
+    }
+    const uint64_t* words = jobs->words;
 
-    printf("\n--- Simulation Results: %s ---\n", algorithmName);
-    printf("Job ID | Pages | Priority | Wait Time | Turnaround Time\n");
-    printf("----------------------------------------------------------\n");
+    // Jobs are in arrival order, so the ends bound every arrival
+    int same_arrival = (packedArrival(words[0]) == packedArrival(words[count - 1]));
+    int fixed_order = 1;
+    if (same_arrival && policy == POLICY_SJF) {
+        if (!countingSortPacked(jobs, PACKED_PAGE_SHIFT, PACKED_PAGE_BITS, order)) {
+            return 0;
+        }
+    } else if (same_arrival && (policy == POLICY_PRIORITY || policy == POLICY_AGING)) {
+        // Equal arrivals age equally, leaving plain priority order
+        if (!countingSortPacked(jobs, PACKED_PRIORITY_SHIFT, PACKED_PRIORITY_BITS, order)) {
+            return 0;
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        fixed_order = (policy == POLICY_FCFS);
+    }
+    if (fixed_order) {
+        return completion == NULL || assignPackedPrinters(jobs, order, completion, stats);
+    }
 
-    for (int i = 0; i < count; i++) {
-        PrintJob job = queue[i];
+    Shard all = { .ready = { NULL, 0, arenaAlloc(runArena(), (size_t)count * sizeof(uint64_t)) } };
+    if (all.ready.keys == NULL || !initPrinterPool(&all.idle, stats->printers)) {
+        return 0;
+    }
+    LoopJobs loop = { NULL, jobs, order, count };
+    return runEventLoop(policy, 1, &loop, &all, 1, 0, completion, stats);
+}
+
+#define SPECIALIZE_PACKED_SCHEDULER(fn, policy)                             \
+    static int fn(const PackedJobs* jobs, int order[], long long completion[], \
+                  SimStats* stats) {                                        \
+        return schedulePacked(jobs, policy, order, completion, stats);      \
+    }
 
-        // Wait Time: Time from submission (assumed 0) until printing starts.
-        // This is simply the time all previous jobs took to complete.
-        int wait_time = current_time;
+SPECIALIZE_PACKED_SCHEDULER(schedulePackedFCFS, POLICY_FCFS)
+SPECIALIZE_PACKED_SCHEDULER(schedulePackedSJF, POLICY_SJF)
+SPECIALIZE_PACKED_SCHEDULER(schedulePackedPriority, POLICY_PRIORITY)
+SPECIALIZE_PACKED_SCHEDULER(schedulePackedAging, POLICY_AGING)
 
-        // Turnaround Time: Time from submission (0) until job completion.
-        // (Wait Time + Burst Time)
-        int turnaround_time = wait_time + job.page_count;
+/**
+ * @brief runPolicy() for packed jobs; `policy` must pass
+ * packedPolicyFits().
+ * @param order Output array with room for `packed->count` indexes.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int runPackedPolicy(const PackedJobs* packed, SchedPolicy policy, int order[],
+                    long long** completion, SimStats* stats) {
+    *completion = NULL;
+    if (stats->printers > 1 || !policy_ops[policy].back_to_back) {
+        *completion = malloc((size_t)packed->count * sizeof(long long) + 1);
+        if (*completion == NULL) {
+            return 0;
+        }
+    }
+    uint64_t started = traceStart();
+    int ok = policy_ops[policy].schedule_packed(packed, order, *completion, stats);
+    arenaReset(runArena());
+    if (!ok) {
+        free(*completion);
+        *completion = NULL;
+    }
+    traceEnd(TRACE_SIMULATE, policy, packed->count, started);
+    return ok;
+}
 
-        // Update totals
+/**
+ * @brief summarizeRun() for a packed run, reading each job's fields
+ * from its word: the same metrics, with the jobs taken in `order`.
+ */
+void summarizePacked(const PackedJobs* packed, const int order[],
+                     const long long completion[], const SimStats* stats,
+                     SimResult* result, LatencyStats* latency) {
+    uint64_t started = nowNanos();
+    int count = packed->count;
+    double total_wait_time = 0;
+    double total_turnaround_time = 0;
+    long long max_wait_time = 0;
+    long long busy = 0;
+    if (latency != NULL) {
+        memset(latency, 0, sizeof(*latency));
+    }
+    long long current_time = 0; // The printer's clock when `completion` is NULL
+    for (int i = 0; i < count; i++) {
+        uint64_t word = packed->words[order[i]];
+        int pages = packedPages(word);
+        int arrival = packedArrival(word);
+        long long turnaround_time;
+        if (completion != NULL) {
+            turnaround_time = completion[i] - arrival;
+        } else {
+            if (current_time < arrival) {
+                current_time = arrival;
+            }
+            current_time += pages;
+            busy += pages;
+            turnaround_time = current_time - arrival;
+        }
+        long long wait_time = turnaround_time - pages;
         total_wait_time += wait_time;
         total_turnaround_time += turnaround_time;
+        if (wait_time > max_wait_time) {
+            max_wait_time = wait_time;
+        }
+        if (latency != NULL) {
+            int cls = packedPriority(word);
+            if (cls < 1 || cls > PRIORITY_CLASSES) {
+                cls = 0;
+            }
+            histogramRecord(&latency->wait[cls], wait_time);
+            histogramRecord(&latency->turnaround[cls], turnaround_time);
+            double slowdown = (double)turnaround_time / pages;
+            latency->slowdown_sum += slowdown;
+            latency->slowdown_squares += slowdown * slowdown;
+        }
+    }
+    if (completion != NULL) {
+        for (int p = 0; p < stats->printers; p++) {
+            busy += stats->busy_time[p];
+        }
+        result->makespan = stats->makespan;
+    } else {
+        result->makespan = current_time;
+    }
+
+    result->avg_wait_time = count > 0 ? total_wait_time / count : 0.0;
+    result->avg_turnaround_time = count > 0 ? total_turnaround_time / count : 0.0;
+    result->max_wait_time = max_wait_time;
+    result->preemptions = stats->preemptions;
+    result->utilization = result->makespan > 0
+        ? 100.0 * busy / ((double)result->makespan * stats->printers) : 0.0;
+
+    uint64_t elapsed = nowNanos() - started;
+    HotCounters* counters = hotCounters();
+    counterAdd(counters, &counters->metrics_ns, (long long)elapsed);
+    if (trace_enabled) {
+        traceWrite(counters, TRACE_METRICS, 0, count, started, elapsed);
+    }
+}
+
+/**
+ * @brief simulatePolicy() for packed jobs. Per-job rows, when the
+ * --output mode prints them, are the one place the jobs are unpacked.
+ */
+void simulatePacked(const PackedJobs* packed, SchedPolicy policy) {
+    int count = packed->count;
+    SimStats stats;
+    initSimStats(&stats, printer_count);
+    LatencyStats* latency = NULL;
+    if (output_mode != OUTPUT_OFF) {
+        latency = malloc(sizeof(LatencyStats));
+    }
+    int* order = malloc((size_t)count * sizeof(int) + 1);
+    long long* completion = NULL;
+    if ((output_mode != OUTPUT_OFF && latency == NULL) || order == NULL ||
+        !runPackedPolicy(packed, policy, order, &completion, &stats)) {
+        printf("Error: Out of memory. Cannot run simulation.\n");
+        free(order);
+        free(latency);
+        return;
+    }
+
+    SimResult result;
+    summarizePacked(packed, order, completion, &stats, &result, latency);
+    PrintJob* rows = NULL;
+    if (output_mode == OUTPUT_TABLE || output_mode == OUTPUT_CSV) {
+        rows = getScratchQueue(count);
+        for (int i = 0; rows != NULL && i < count; i++) {
+            unpackJob(packed, order[i], &rows[i]);
+        }
+    }
+    if (rows == NULL && (output_mode == OUTPUT_TABLE || output_mode == OUTPUT_CSV)) {
+        printf("Error: Out of memory. Cannot print the per-job rows.\n");
+    } else {
+        reportRun(rows, completion, count, policy, &stats, &result, latency);
+    }
+    free(completion);
+    free(order);
+    free(latency);
+}
+
+/**
+ * @brief runSelectedPolicies() on packed jobs (--packed): packs `jobs`
+ * once, runs every selected policy that has a packed simulator on them,
+ * and the rest, or everything if the jobs do not fit the packed ranges,
+ * on the wide jobs.
+ */
+void runPackedPolicies(const PrintJob jobs[], int count, int policy) {
+    if (count == 0) {
+        printf("Cannot run simulation: The trace contains no jobs.\n");
+        return;
+    }
+    PackedJobs packed = { NULL, 0, 0 };
+    if (setup_cost > 0 || coalesce_pages > 0) {
+        printf("The packed simulators do not model setup costs; "
+               "using the wide layout.\n");
+    } else if (shard_count > 1 && printer_count > 1) {
+        printf("The packed simulators do not model shards; using the wide layout.\n");
+    } else if (!jobsPackable(jobs, count)) {
+        printf("Jobs exceed the packed ranges (or are not in arrival order); "
+               "using the wide layout.\n");
+    } else if (!packJobs(jobs, count, &packed)) {
+        printf("Out of memory for the packed jobs; using the wide layout.\n");
+    } else {
+        printf("Packed %d jobs into %.1f MB (the wide layout takes %.1f MB).\n",
+               count, count * sizeof(uint64_t) / 1e6, count * sizeof(PrintJob) / 1e6);
+    }
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (policy != -1 && policy != k) {
+            continue;
+        }
+        if (packed.words != NULL && packedPolicyFits(&packed, (SchedPolicy)k)) {
+            simulatePacked(&packed, (SchedPolicy)k);
+        } else {
+            simulatePolicy(jobs, count, (SchedPolicy)k);
+        }
+    }
+    freePackedJobs(&packed);
+}
+
+// --- Run Reports ---
+
+/**
+ * @brief Reports a finished run in the --output mode. The metrics come
+ * from summarizeRun(); this only chooses what to print of them.
+ *
+ * @param queue The jobs in the order the run produced.
+ * @param completion Completion times matching `queue`, or NULL if the
+ * jobs printed back to back on a single printer.
+ * @param count The number of jobs.
+ * @param policy The policy that produced the run.
+ * @param stats The run's statistics.
+ * @param result The run's summary metrics.
+ * @param latency The run's latency histograms, or NULL.
+ */
+void reportRun(const PrintJob queue[], const long long completion[], int count,
+               SchedPolicy policy, const SimStats* stats, const SimResult* result,
+               const LatencyStats* latency) {
+    if (output_mode == OUTPUT_OFF) {
+        return;
+    }
+
+    printf("\n--- Simulation Results: %s ---\n", policy_ops[policy].name);
+    if (output_mode == OUTPUT_TABLE || output_mode == OUTPUT_CSV) {
+        if (!writeJobRows(queue, completion, count, policy)) {
+            fprintf(stderr, "Error: Failed writing per-job results.\n");
+        }
+    }
+    printf("Average Waiting Time:     %.2f\n", result->avg_wait_time);
+    printf("Average Turnaround Time:  %.2f\n", result->avg_turnaround_time);
+    if (latency != NULL) {
+        printLatencyReport(latency);
+    }
+    if (policy_ops[policy].preemptive) {
+        printf("Preemptions:              %d (%lld time units switching)\n",
+               stats->preemptions, stats->switch_overhead);
+    }
+    if (stats->printers > 1) {
+        printPrinterReport(stats, count);
+    }
+}
+
+// Hands a full buffer to stdio in one call.
+static void flushOutputBuffer(OutputBuffer* out) {
+    if (out->used > 0 && fwrite(out->data, 1, out->used, out->file) != out->used) {
+        out->failed = 1;
+    }
+    out->used = 0;
+}
+
+// Appends the decimal form of `value`; much cheaper than snprintf.
+static inline char* formatLongLong(char* p, long long value) {
+    char digits[20];
+    int n = 0;
+    unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long)value
+                                               : (unsigned long long)value;
+    if (value < 0) {
+        *p++ = '-';
+    }
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+// Appends `value` left-aligned in a field of `width`, like "%-*lld".
+static inline char* formatPadded(char* p, long long value, int width) {
+    char* end = formatLongLong(p, value);
+    while (end - p < width) {
+        *end++ = ' ';
+    }
+    return end;
+}
 
-        // The printer is now busy for the duration of this job
-        current_time += job.page_count;
+/**
+ * @brief Writes one row per job, as the table or as CSV per the
+ * --output mode, to the --output-file (stdout by default).
+ *
+ * Rows are formatted by hand into an OUTPUT_BUFFER_SIZE buffer that is
+ * written with a single fwrite whenever it fills, so a dump of millions
+ * of jobs costs a few large writes rather than one call (or, on a
+ * terminal, one system call) per line. CSV rows carry the policy so that several runs
+ * can share one file; the header is written once per file.
+ *
+ * @return 1 on success, 0 if out of memory or a write failed.
+ */
+int writeJobRows(const PrintJob queue[], const long long completion[], int count,
+                 SchedPolicy policy) {
+    OutputBuffer out = { malloc(OUTPUT_BUFFER_SIZE), 0,
+                         output_file != NULL ? output_file : stdout, 0 };
+    if (out.data == NULL) {
+        return 0;
+    }
+    fflush(stdout); // Keep rows after the header already printed
 
-        // Print the results for this job
-        printf("%-6d | %-5d | %-8d | %-9d | %-15d\n",
-               job.job_id,
-               job.page_count,
-               job.priority,
-               wait_time,
-               turnaround_time);
+    int csv = (output_mode == OUTPUT_CSV);
+    const char* header = csv
+        ? "policy,job_id,page_count,priority,arrival_time,wait_time,turnaround_time\n"
+        : "Job ID | Pages | Priority | Arrival | Wait Time | Turnaround Time\n"
+          "--------------------------------------------------------------------\n";
+    if (!csv || !csv_header_written) {
+        out.used = strlen(header);
+        memcpy(out.data, header, out.used);
+        csv_header_written = csv_header_written || csv;
     }
 
-    // Calculate and print averages
-    double avg_wait_time = total_wait_time / count;
-    double avg_turnaround_time = total_turnaround_time / count;
+    const char* key = policy_ops[policy].key;
+    size_t key_length = strlen(key);
+    long long current_time = 0; // The printer's clock when `completion` is NULL
+    for (int i = 0; i < count; i++) {
+        const PrintJob* job = &queue[i];
+        long long wait_time;
+        long long turnaround_time;
+        if (completion != NULL) {
+            // Everything that was not spent printing this job counts as
+            // waiting, including time it was preempted.
+            turnaround_time = completion[i] - job->arrival_time;
+            wait_time = turnaround_time - job->page_count;
+        } else {
+            // The printer sits idle until the job has actually arrived.
+            if (current_time < job->arrival_time) {
+                current_time = job->arrival_time;
+            }
+            wait_time = current_time - job->arrival_time;
+            turnaround_time = wait_time + job->page_count;
+            current_time += job->page_count;
+        }
+
+        // Longest row: a key, six numbers of at most 20 characters and
+        // the table's padding
+        if (OUTPUT_BUFFER_SIZE - out.used < 256) {
+            flushOutputBuffer(&out);
+        }
+        char* p = out.data + out.used;
+        if (csv) {
+            memcpy(p, key, key_length);
+            p += key_length;
+            *p++ = ',';
+            p = formatLongLong(p, job->job_id);
+            *p++ = ',';
+            p = formatLongLong(p, job->page_count);
+            *p++ = ',';
+            p = formatLongLong(p, job->priority);
+            *p++ = ',';
+            p = formatLongLong(p, job->arrival_time);
+            *p++ = ',';
+            p = formatLongLong(p, wait_time);
+            *p++ = ',';
+            p = formatLongLong(p, turnaround_time);
+            *p++ = '\n';
+        } else {
+            // Same layout as "%-6d | %-5d | %-8d | %-7d | %-9lld | %-15lld"
+            p = formatPadded(p, job->job_id, 6);
+            memcpy(p, " | ", 3);
+            p = formatPadded(p + 3, job->page_count, 5);
+            memcpy(p, " | ", 3);
+            p = formatPadded(p + 3, job->priority, 8);
+            memcpy(p, " | ", 3);
+            p = formatPadded(p + 3, job->arrival_time, 7);
+            memcpy(p, " | ", 3);
+            p = formatPadded(p + 3, wait_time, 9);
+            memcpy(p, " | ", 3);
+            p = formatPadded(p + 3, turnaround_time, 15);
+            *p++ = '\n';
+        }
+        out.used = (size_t)(p - out.data);
+    }
 
-    printf("----------------------------------------------------------\n");
-    printf("Average Waiting Time:     %.2f\n", avg_wait_time);
-    printf("Average Turnaround Time:  %.2f\n", avg_turnaround_time);
+    if (!csv) {
+        const char* rule = "--------------------------------------------------------------------\n";
+        size_t length = strlen(rule);
+        if (OUTPUT_BUFFER_SIZE - out.used < length) {
+            flushOutputBuffer(&out);
+        }
+        memcpy(out.data + out.used, rule, length);
+        out.used += length;
+    }
+    flushOutputBuffer(&out);
+    if (fflush(out.file) != 0) {
+        out.failed = 1;
+    }
+    free(out.data);
+    return !out.failed;
 }
@@ -0,0 +1,478 @@
+#!/usr/bin/env python3
+"""Randomized checks of ./spool against small reference models.
+
+    python3 spool_check.py [--spool PATH] [--seeds N] [sim|menu|daemon ...]
+
+sim     Runs random traces through every whole-job simulator (fcfs, sjf,
+        priority and aging on one and several printers, wide and
+        --packed, sharded with and without stealing) and through mlfq and
+        drr on one printer, and compares each job's completion time with
+        a straightforward model of the same policy.
+menu    Drives the interactive menu with random add, dispatch, cancel and
+        priority-change commands and checks the job each dispatch and
+        cancel reports, and every set of averages, against a model queue.
+daemon  Does the same through --serve over a Unix socket, restarting the
+        daemon from its --journal part way, then pages through the queue
+        with QUEUE N FROM POS while jobs are dispatched and cancelled and
+        checks that no job that stayed queued is skipped or repeated.
+
+With no mode given all three run. Build the binary first:
+
+    gcc -std=c11 -Wall -Wextra -O2 spool.c -o spool -pthread -lm
+"""
+
+import argparse
+import heapq
+import os
+import random
+import re
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+from collections import deque
+
+# --- Traces ---
+
+
+def random_jobs(rng, count):
+    """Jobs (id, pages, priority, arrival) with plenty of ties."""
+    jobs, clock = [], 0
+    for job_id in range(1, count + 1):
+        clock += rng.choice([0, 0, 1, 3, 10, 40])
+        jobs.append((job_id, rng.choice([1, 2, 5, 20, 100, 400]),
+                     rng.randint(1, 4), clock))
+    return jobs
+
+
+def write_trace(path, jobs):
+    with open(path, "w") as trace:
+        trace.writelines(f"{i},{p},{pr},{a}\n" for i, p, pr, a in jobs)
+
+
+def run_trace(spool, path, policy, extra):
+    """Each job's completion time, from the CSV output of one run."""
+    out = subprocess.run([spool, "--trace", path, "--policy", policy,
+                          "--output", "csv"] + extra,
+                         capture_output=True, text=True, check=True).stdout
+    done = {}
+    for line in out.splitlines():
+        field = line.split(",")
+        if len(field) == 7 and field[1].isdigit():
+            done[int(field[1])] = int(field[4]) + int(field[6])
+    return done
+
+
+# --- Simulator models ---
+
+AGING_INTERVAL = 7
+
+
+def ready_key(policy, job):
+    job_id, pages, priority, arrival = job
+    if policy == "fcfs":
+        return (arrival, job_id)
+    if policy == "sjf":
+        return (pages, job_id)
+    if policy == "priority":
+        return (priority, job_id)
+    return (arrival + AGING_INTERVAL * priority, arrival, job_id)
+
+
+def shard_of(job_id, shards):
+    return ((job_id * 2654435761) & 0xFFFFFFFF) * shards >> 32
+
+
+def whole_jobs(jobs, policy, printers, shards=1, steal=True, steal_cost=0):
+    """Completion times when every job prints whole, best waiting first.
+
+    Once every arrival and completion at an instant is in, each shard's
+    idle printers take its own best jobs, then (with `steal`) shards with
+    a printer still idle take the best job of the deepest queue, starting
+    it steal_cost later. One shard is the unsharded simulator.
+    """
+    shards = min(shards, printers)
+    arrivals = deque(sorted(jobs, key=lambda j: (j[3], j[0])))
+    ready = [[] for _ in range(shards)]
+    idle = [len(range(s, printers, shards)) for s in range(shards)]
+    running, done = [], {}
+    while arrivals or running:
+        if arrivals and (not running or arrivals[0][3] <= running[0][0]):
+            clock = arrivals[0][3]
+        else:
+            clock = running[0][0]
+        while arrivals and arrivals[0][3] == clock:
+            job = arrivals.popleft()
+            home = shard_of(job[0], shards) if shards > 1 else 0
+            heapq.heappush(ready[home], (ready_key(policy, job), job))
+        while running and running[0][0] == clock:
+            idle[heapq.heappop(running)[1]] += 1
+        for stealing in ([False, True] if steal else [False]):
+            for s in range(shards):
+                while idle[s] > 0:
+                    source = s
+                    if stealing:
+                        depths = [len(q) for q in ready]
+                        source = depths.index(max(depths))
+                    if not ready[source]:
+                        break
+                    start = clock + (steal_cost if source != s else 0)
+                    job = heapq.heappop(ready[source])[1]
+                    idle[s] -= 1
+                    done[job[0]] = start + job[1]
+                    heapq.heappush(running, (done[job[0]], s))
+    return done
+
+
+def mlfq(jobs, quanta, switch_cost):
+    """Completion times under MLFQ on one printer: a job that uses up the
+    quantum of its level drops a level, and resuming a different job
+    after a preemption costs switch_cost."""
+    jobs = sorted(jobs, key=lambda j: (j[3], j[0]))
+    levels = [deque() for _ in quanta]
+    remaining, done = {}, {}
+    clock, i, preempted = 0, 0, None
+    while len(done) < len(jobs):
+        while i < len(jobs) and jobs[i][3] <= clock:
+            levels[0].append(jobs[i])
+            remaining[jobs[i][0]] = jobs[i][1]
+            i += 1
+        level = next((k for k in range(len(levels)) if levels[k]), None)
+        if level is None:
+            clock = jobs[i][3]
+            continue
+        job = levels[level].popleft()
+        if preempted is not None and preempted != job[0]:
+            clock += switch_cost
+        preempted = None
+        slice_pages = min(remaining[job[0]], quanta[level])
+        clock += slice_pages
+        remaining[job[0]] -= slice_pages
+        # Jobs arriving as the slice ends queue behind the preempted one
+        while i < len(jobs) and jobs[i][3] < clock:
+            levels[0].append(jobs[i])
+            remaining[jobs[i][0]] = jobs[i][1]
+            i += 1
+        if remaining[job[0]] == 0:
+            done[job[0]] = clock
+        else:
+            levels[min(level + 1, len(levels) - 1)].append(job)
+            preempted = job[0]
+    return done
+
+
+def drr(jobs, quantum, weights):
+    """Completion times under deficit round-robin across the priority
+    classes on one printer; weights[0] is the class of priorities
+    outside 1-3."""
+    jobs = sorted(jobs, key=lambda j: (j[3], j[0]))
+    classes = [deque() for _ in weights]
+    deficit = [0] * len(weights)
+    clock, i, turn, credited, done = 0, 0, 0, False, {}
+    while len(done) < len(jobs):
+        while i < len(jobs) and jobs[i][3] <= clock:
+            c = jobs[i][2] if 1 <= jobs[i][2] < len(weights) else 0
+            classes[c].append(jobs[i])
+            i += 1
+        if not any(classes):
+            clock = jobs[i][3]
+            continue
+        while True:
+            c = turn
+            if classes[c]:
+                if not credited:
+                    deficit[c] += quantum * weights[c]
+                    credited = True
+                if classes[c][0][1] <= deficit[c]:
+                    job = classes[c].popleft()
+                    deficit[c] -= job[1]
+                    if not classes[c]:
+                        deficit[c], turn, credited = 0, (c + 1) % len(weights), False
+                    break
+            turn, credited = (c + 1) % len(weights), False
+        clock += job[1]
+        done[job[0]] = clock
+    return done
+
+
+def check_sim(spool, rng, workdir):
+    jobs = random_jobs(rng, 300)
+    path = os.path.join(workdir, "check.csv")
+    write_trace(path, jobs)
+    cases = []
+    for policy in ("fcfs", "sjf", "priority", "aging"):
+        for printers in (1, 3):
+            for packed in ([], ["--packed"]):
+                cases.append((policy, ["--printers", str(printers)] + packed,
+                              whole_jobs(jobs, policy, printers)))
+        for shards, steal, cost in ((2, True, 0), (3, True, 2), (4, False, 0)):
+            extra = ["--printers", "5", "--shards", str(shards),
+                     "--steal-cost", str(cost)] + ([] if steal else ["--no-steal"])
+            cases.append((policy, extra,
+                          whole_jobs(jobs, policy, 5, shards, steal, cost)))
+    cases.append(("mlfq", ["--mlfq-quanta", "4,16,64", "--switch-cost", "3"],
+                  mlfq(jobs, [4, 16, 64], 3)))
+    cases.append(("drr", ["--drr-quantum", "7", "--drr-weights", "3,2,1"],
+                  drr(jobs, 7, [1, 3, 2, 1])))
+
+    failures = 0
+    for policy, extra, expected in cases:
+        if policy == "aging":
+            extra = extra + ["--aging-interval", str(AGING_INTERVAL)]
+        got = run_trace(spool, path, policy, extra)
+        wrong = [j for j in expected if got.get(j) != expected[j]]
+        if wrong:
+            failures += 1
+            print(f"  sim {policy} {' '.join(extra)}: {len(wrong)} jobs differ, "
+                  f"e.g. job {wrong[0]} done at {got.get(wrong[0])}, "
+                  f"expected {expected[wrong[0]]}")
+    return failures
+
+
+# --- Queue model ---
+
+# Menu options: 1-6 are the original menu's, the rest come after Exit
+MENU_ADD, MENU_SHOW, MENU_EXIT = 1, 2, 6
+MENU_DISPATCH, MENU_CANCEL, MENU_REPRIORITIZE = 13, 14, 15
+
+DISPATCH_KEYS = {
+    "fcfs": lambda job: (job[3], job[0]),
+    "sjf": lambda job: (job[1], job[0]),
+    "priority": lambda job: (job[2], job[0]),
+}
+
+
+def averages(queue):
+    """(avg wait, avg turnaround) of the queue under each menu policy."""
+    pages = sum(job[1] for job in queue.values())
+    result = []
+    for key in DISPATCH_KEYS.values():
+        ahead = wait = 0
+        for job in sorted(queue.values(), key=key):
+            wait += ahead
+            ahead += job[1]
+        result.append((wait / len(queue), (wait + pages) / len(queue)))
+    return result
+
+
+def check_menu(spool, rng):
+    queue, next_id = {}, 1
+    commands, dispatched, cancelled, expected = [], [], [], []
+    for step in range(400):
+        r = rng.random()
+        if r < 0.45 or not queue:
+            job = (next_id, rng.randint(1, 50), rng.randint(1, 4),
+                   rng.choice([0, step, rng.randint(0, 50)]))
+            commands.append(f"{MENU_ADD}\n" + "%d\n%d\n%d\n" % job[1:])
+            queue[next_id] = job
+            next_id += 1
+        elif r < 0.6:
+            choice = rng.randint(1, 3)
+            job = min(queue.values(), key=list(DISPATCH_KEYS.values())[choice - 1])
+            commands.append(f"{MENU_DISPATCH}\n{choice}\n")
+            dispatched.append(job[0])
+            del queue[job[0]]
+        elif r < 0.72:
+            job_id = rng.choice(list(queue)) if rng.random() < 0.85 else next_id + 5
+            commands.append(f"{MENU_CANCEL}\n{job_id}\n")
+            if job_id in queue:
+                cancelled.append(job_id)
+                del queue[job_id]
+        elif r < 0.88:
+            job_id, priority = rng.choice(list(queue)), rng.randint(1, 5)
+            commands.append(f"{MENU_REPRIORITIZE}\n{job_id}\n{priority}\n")
+            job = queue[job_id]
+            queue[job_id] = (job[0], job[1], priority, job[3])
+        else:
+            commands.append(f"{MENU_SHOW}\n")
+            expected.extend(averages(queue))
+    commands.append(f"{MENU_EXIT}\n")
+
+    out = subprocess.run([spool], input="".join(commands), capture_output=True,
+                         text=True, timeout=60).stdout
+    failures = 0
+    for verb, wanted in (("Dispatched", dispatched), ("Cancelled", cancelled)):
+        got = [int(x) for x in re.findall(verb + r" Job (\d+)", out)]
+        if got != wanted:
+            failures += 1
+            at = next((i for i, (g, w) in enumerate(zip(got, wanted)) if g != w),
+                      min(len(got), len(wanted)))
+            print(f"  menu: {verb.lower()} {got[at:at + 4]} from number {at + 1}, "
+                  f"expected {wanted[at:at + 4]}")
+    got = [(float(w), float(t)) for w, t in
+           re.findall(r"avg wait ([\d.]+), avg turnaround ([\d.]+)", out)]
+    if len(got) != len(expected) or any(
+            abs(w - round(ew, 2)) > 0.006 or abs(t - round(et, 2)) > 0.006
+            for (w, t), (ew, et) in zip(got, expected)):
+        failures += 1
+        print(f"  menu: {len(got)} sets of averages, expected {len(expected)}, "
+              "or they differ")
+    return failures
+
+
+# --- Daemon ---
+
+
+class Daemon:
+    def __init__(self, spool, workdir):
+        self.path = os.path.join(workdir, "spool.sock")
+        self.journal = os.path.join(workdir, "spool.journal")
+        self.spool = spool
+        self.start()
+
+    def start(self):
+        if os.path.exists(self.path):
+            os.remove(self.path)
+        self.process = subprocess.Popen(
+            [self.spool, "--serve", self.path, "--journal", self.journal],
+            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        for _ in range(200):
+            if os.path.exists(self.path):
+                break
+            time.sleep(0.05)
+        self.socket = socket.socket(socket.AF_UNIX)
+        self.socket.connect(self.path)
+        self.reader = self.socket.makefile("r")
+
+    def request(self, line):
+        """The reply's first line, then any lines of a QUEUE page."""
+        self.socket.sendall((line + "\n").encode())
+        reply = [self.reader.readline().strip()]
+        shown = re.search(r"shown=(\d+)", reply[0])
+        if reply[0].startswith("OK") and shown:
+            reply += [self.reader.readline().strip() for _ in range(int(shown.group(1)))]
+        return reply if shown else reply[0]
+
+    def stop(self):
+        self.request("SHUTDOWN")
+        self.process.wait(timeout=60)
+        self.socket.close()
+        return self.process.stderr.read()
+
+
+def check_daemon(spool, rng, workdir):
+    daemon = Daemon(spool, workdir)
+    queue, failures = {}, 0
+
+    def expect(reply, wanted, what):
+        nonlocal failures
+        if not reply.startswith(wanted):
+            failures += 1
+            if failures <= 5:
+                print(f"  daemon {what}: got '{reply}', expected '{wanted}...'")
+
+    for rnd in range(4):
+        batch = [(rng.randint(1, 100), rng.randint(1, 3), rng.randint(0, 10))
+                 for _ in range(500)]
+        reply = daemon.request("SUBMIT " + " ".join("%d,%d,%d" % j for j in batch))
+        first = int(reply.split()[1])
+        for i, (pages, priority, arrival) in enumerate(batch):
+            queue[first + i] = (first + i, pages, priority, arrival)
+        for _ in range(300):
+            r = rng.random()
+            if r < 0.3:
+                job_id = rng.choice(list(queue))
+                expect(daemon.request(f"CANCEL {job_id}"), f"OK {job_id} ", "CANCEL")
+                del queue[job_id]
+            elif r < 0.55:
+                job_id, priority = rng.choice(list(queue)), rng.randint(1, 5)
+                job = (job_id, queue[job_id][1], priority, queue[job_id][3])
+                expect(daemon.request(f"PRIORITY {job_id} {priority}"),
+                       "OK %d %d %d %d" % job, "PRIORITY")
+                queue[job_id] = job
+            elif r < 0.65:
+                expect(daemon.request("CANCEL 99999999"), "ERR", "CANCEL unknown")
+            else:
+                policy = rng.choice(list(DISPATCH_KEYS))
+                job = min(queue.values(), key=DISPATCH_KEYS[policy])
+                expect(daemon.request("DISPATCH " + policy), f"OK {job[0]} ",
+                       "DISPATCH " + policy)
+                del queue[job[0]]
+        job_id = rng.choice(list(queue))
+        expect(daemon.request(f"JOB {job_id}"), "OK %d %d %d %d" % queue[job_id], "JOB")
+        if rnd == 1:
+            errors = daemon.stop()
+            if "ERROR" in errors:
+                failures += 1
+                print("  daemon: " + errors.strip())
+            daemon.start()
+
+    # Page through the queue while it changes: every job queued from the
+    # first page to the last appears exactly once, in queue order
+    for _ in range(40):
+        before = [int(row.split()[0]) for row in daemon.request("QUEUE 10000")[1:]]
+        removed, seen, cursor = set(), [], 0
+        while True:
+            page = daemon.request(f"QUEUE {rng.randint(1, 40)}" +
+                                  (f" FROM {cursor}" if cursor else ""))
+            seen += [int(row.split()[0]) for row in page[1:]]
+            cursor = int(page[0].split("next=")[1].split()[0])
+            for _ in range(rng.randint(0, 6)):
+                r = rng.random()
+                if r < 0.5 and queue:
+                    reply = daemon.request("DISPATCH " + rng.choice(list(DISPATCH_KEYS)))
+                    removed.add(int(reply.split()[1]))
+                    del queue[int(reply.split()[1])]
+                elif r < 0.8 and queue:
+                    job_id = rng.choice(list(queue))
+                    daemon.request(f"CANCEL {job_id}")
+                    removed.add(job_id)
+                    del queue[job_id]
+                else:
+                    reply = daemon.request("SUBMIT %d,%d" % (rng.randint(1, 9), rng.randint(1, 3)))
+                    job_id = int(reply.split()[1])
+                    queue[job_id] = (job_id, 0, 0, 0)  # Only its id is checked here
+            if cursor == 0:
+                break
+        stayed = [job_id for job_id in before if job_id not in removed]
+        shown = [job_id for job_id in seen if job_id in set(stayed)]
+        if shown != stayed:
+            failures += 1
+            print(f"  daemon QUEUE walk: {len(shown)} of {len(stayed)} queued jobs "
+                  "shown in order")
+            break
+
+    errors = daemon.stop()
+    if "ERROR" in errors:
+        failures += 1
+        print("  daemon: " + errors.strip())
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("modes", nargs="*", metavar="sim|menu|daemon")
+    parser.add_argument("--spool", default=os.path.join(os.path.dirname(
+        os.path.abspath(__file__)), "spool"))
+    parser.add_argument("--seeds", type=int, default=5)
+    args = parser.parse_args()
+    modes = args.modes or ["sim", "menu", "daemon"]
+    for mode in modes:
+        if mode not in ("sim", "menu", "daemon"):
+            parser.error(f"unknown mode '{mode}'")
+
+    failures = 0
+    workdir = tempfile.mkdtemp(prefix="spool_check.")
+    try:
+        for seed in range(1, args.seeds + 1):
+            rng = random.Random(seed)
+            for mode in modes:
+                if mode == "sim":
+                    failed = check_sim(args.spool, rng, workdir)
+                elif mode == "menu":
+                    failed = check_menu(args.spool, rng)
+                else:
+                    failed = check_daemon(args.spool, rng, workdir)
+                    for name in os.listdir(workdir):
+                        os.remove(os.path.join(workdir, name))
+                print(f"seed {seed} {mode}: {'ok' if not failed else 'FAILED'}")
+                failures += failed
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())